@@ -2,6 +2,11 @@
 #include <optional>
 #include <string>
 #include <complex>
+#include <chrono>
+#include <random>
+#include <vector>
+#include "nullable_column.h"
+#include "parse_number.h"
 
 
 std::optional<int> asInt(const std::string& s)
@@ -15,6 +20,12 @@ std::optional<int> asInt(const std::string& s)
     }
 }
 
+// without exceptions (see parse_number.h):
+result<int, ParseError> asIntResult(const std::string& s) noexcept
+{
+    return parseNumber<int>(s);
+}
+
 class Name
 {
 public:
@@ -36,6 +47,137 @@ private:
     std::string last;
 };
 
+template<typename T>
+double diff(const T& t0, const T& t1)
+{
+    return std::chrono::duration<double, std::milli>(t1 - t0).count();
+}
+
+void nullableColumnPerformance()
+{
+    /*
+    std::optional<int> needs 8 bytes (4 for the value, 1 for the flag, 3 for alignment).
+    NullableColumn<int> (see nullable_column.h) stores 4 bytes per value plus one bit,
+    compact_optional<int> uses INT_MAX as "no value" and needs exactly 4 bytes.
+    */
+    const std::size_t numElems{10'000'000};
+    std::mt19937 eng{42};
+
+    std::vector<std::optional<int>> coll1;
+    NullableColumn<int> coll2;
+    std::vector<compact_optional<int>> coll3;
+    coll1.reserve(numElems);
+    coll2.reserve(numElems);
+    coll3.reserve(numElems);
+    for(std::size_t i{0}; i < numElems; ++i)
+    {
+        if(eng() % 5 == 0) {  // 20% nulls
+            coll1.push_back(std::nullopt);
+            coll2.push_back(std::nullopt);
+            coll3.push_back(std::nullopt);
+        }
+        else {
+            int val = static_cast<int>(eng() % 1000);
+            coll1.push_back(val);
+            coll2.push_back(val);
+            coll3.push_back(val);
+        }
+    }
+
+    std::cout << "memory: vector<optional<int>>: " << coll1.capacity() * sizeof(std::optional<int>) / (1024 * 1024) << " MiB, "
+              << "NullableColumn<int>: " << coll2.memoryUsage() / (1024 * 1024) << " MiB, "
+              << "vector<compact_optional<int>>: " << coll3.capacity() * sizeof(compact_optional<int>) / (1024 * 1024) << " MiB\n";
+
+    for(int i{0}; i < 5; ++i)
+    {
+        std::size_t count1{0}, count3{0};
+        long sum1{0}, sum3{0};
+        auto t0 = std::chrono::steady_clock::now();
+        for(const auto& o : coll1)
+        {
+            count1 += o.has_value();
+            sum1 += o.value_or(0);
+        }
+        auto t1 = std::chrono::steady_clock::now();
+        std::size_t count2 = coll2.countValid();
+        long sum2 = coll2.sum<long>();
+        auto t2 = std::chrono::steady_clock::now();
+        for(const auto& o : coll3)
+        {
+            count3 += o.has_value();
+            sum3 += o.value_or(0);
+        }
+        auto t3 = std::chrono::steady_clock::now();
+        std::cout << "count and sum: vector<optional<int>>: " << diff(t0, t1) << "ms, NullableColumn<int>: " << diff(t1, t2)
+                  << "ms, vector<compact_optional<int>>: " << diff(t2, t3) << "ms"
+                  << (count1 != count2 || count1 != count3 || sum1 != sum2 || sum1 != sum3 ? " ERROR: different results" : "") << '\n';
+    }
+}
+
+void parsePerformance()
+{
+    /*
+    asInt() uses std::stoi(), which throws for invalid input. Throwing and catching an
+    exception costs microseconds, so with dirty input the exceptions dominate.
+    asIntResult() returns a result<int, ParseError> based on std::from_chars() instead.
+    */
+    const std::size_t numElems{1'000'000};
+    for(int invalidPercent : {0, 10, 50})
+    {
+        std::mt19937 eng{42};
+        std::vector<std::string> input;
+        input.reserve(numElems);
+        for(std::size_t i{0}; i < numElems; ++i)
+        {
+            if(static_cast<int>(eng() % 100) < invalidPercent) {
+                input.push_back(i % 2 ? "hello" : "99999999999999");  // invalid or out of range
+            }
+            else {
+                input.push_back(std::to_string(static_cast<int>(eng() % 2'000'000) - 1'000'000));
+            }
+        }
+
+        long sum1{0}, sum2{0};
+        std::size_t errors1{0}, errors2{0};
+        auto t0 = std::chrono::steady_clock::now();
+        for(const auto& s : input)
+        {
+            if(auto oi = asInt(s); oi) {
+                sum1 += *oi;
+            }
+            else {
+                ++errors1;
+            }
+        }
+        auto t1 = std::chrono::steady_clock::now();
+        for(const auto& s : input)
+        {
+            if(auto r = asIntResult(s); r) {
+                sum2 += *r;
+            }
+            else {
+                ++errors2;
+            }
+        }
+        auto t2 = std::chrono::steady_clock::now();
+        std::cout << invalidPercent << "% invalid: stoi() + exceptions: " << diff(t0, t1) << "ms, from_chars() + result: " << diff(t1, t2) << "ms"
+                  << (sum1 != sum2 || errors1 != errors2 ? " ERROR: different results" : "") << '\n';
+    }
+
+    // monadic chaining, errors are passed on without branches in the caller:
+    auto percent = asIntResult("42")
+                       .and_then([](int v) -> result<int, ParseError> {
+                           if(v < 0 || v > 100) {
+                               return unexpected{ParseError::outOfRange};
+                           }
+                           return v;
+                       })
+                       .transform([](int v) { return v / 100.0; });
+    std::cout << "42 as fraction: " << percent.value_or(0.0) << '\n';
+    auto bad = asIntResult("hello").transform([](int v) { return v * 2; });
+    std::cout << "hello: " << (bad ? "value" : toString(bad.error())) << '\n';
+}
+
 int main()
 {
     /*
@@ -145,6 +287,9 @@ int main()
 
     if(os.has_value()){std::cout << os.value() << "xccc\n";}
 
+    // nullableColumnPerformance();
+    // parsePerformance();
+
     return 0;
 }
 
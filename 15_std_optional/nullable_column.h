@@ -0,0 +1,344 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/********************************************
+* NullableColumn<T>
+* alternative to std::vector<std::optional<T>>, where alignment usually doubles
+* the size of each element (std::optional<int> has 8 bytes):
+* - the values are stored in a dense std::vector<T>, null slots hold T{}
+* - validity is a separate bitmap with one bit per element
+* - operator[] returns an optional-like proxy
+* - bulk operations work on whole words of the bitmap and on the plain value array,
+*   which compilers vectorize: countValid() is a popcount per 64 elements, and
+*   because null slots hold T{}, sum() ignoring nulls is a plain sum of the values
+********************************************/
+
+template<typename T>
+class NullableColumn
+{
+    static constexpr std::size_t bitsPerWord = 64;
+
+    template<bool IsConst>
+    class Proxy
+    {
+        using Column = std::conditional_t<IsConst, const NullableColumn, NullableColumn>;
+
+    public:
+        Proxy(const Proxy&) = default;
+
+        bool has_value() const noexcept { return m_col->isValid(m_idx); }
+        explicit operator bool() const noexcept { return has_value(); }
+
+        // unchecked, as std::optional<>::operator*():
+        const T& operator*() const noexcept { return m_col->m_values[m_idx]; }
+        const T* operator->() const noexcept { return &m_col->m_values[m_idx]; }
+
+        const T& value() const
+        {
+            if(!has_value())
+            {
+                throw std::bad_optional_access{};
+            }
+            return m_col->m_values[m_idx];
+        }
+
+        template<typename U>
+        T value_or(U&& fallback) const
+        {
+            return has_value() ? m_col->m_values[m_idx] : static_cast<T>(std::forward<U>(fallback));
+        }
+
+        operator std::optional<T>() const
+        {
+            return has_value() ? std::optional<T>{m_col->m_values[m_idx]} : std::nullopt;
+        }
+
+        template<bool C = IsConst, typename = std::enable_if_t<!C>>
+        const Proxy& operator=(const T& val) const
+        {
+            m_col->set(m_idx, val);
+            return *this;
+        }
+
+        template<bool C = IsConst, typename = std::enable_if_t<!C>>
+        const Proxy& operator=(std::nullopt_t) const
+        {
+            m_col->setNull(m_idx);
+            return *this;
+        }
+
+        // col[i] = col[j] copies the value or the null, as assigning optionals does (the
+        // implicit assignment would rebind the temporary proxy and leave the column unchanged):
+        const Proxy& operator=(const Proxy& other) const
+        {
+            static_assert(!IsConst, "NullableColumn: assignment through a const_reference");
+            return assignFrom(other);
+        }
+
+        template<bool OtherConst, bool C = IsConst, typename = std::enable_if_t<!C && OtherConst != C>>
+        const Proxy& operator=(const Proxy<OtherConst>& other) const
+        {
+            return assignFrom(other);
+        }
+
+        friend bool operator==(const Proxy& p, std::nullopt_t) noexcept { return !p.has_value(); }
+        friend bool operator==(const Proxy& p, const T& val) { return p.has_value() && *p == val; }
+
+    private:
+        friend class NullableColumn;
+        Proxy(Column* col, std::size_t idx) noexcept : m_col{col}, m_idx{idx} {}
+
+        template<typename Other>
+        const Proxy& assignFrom(const Other& other) const
+        {
+            if(other.has_value())
+            {
+                m_col->set(m_idx, *other);
+            }
+            else
+            {
+                m_col->setNull(m_idx);
+            }
+            return *this;
+        }
+
+        Column* m_col;
+        std::size_t m_idx;
+    };
+
+public:
+    using reference = Proxy<false>;
+    using const_reference = Proxy<true>;
+
+    NullableColumn() = default;
+
+    // n null elements:
+    explicit NullableColumn(std::size_t n) { resize(n); }
+
+    std::size_t size() const noexcept { return m_values.size(); }
+    bool empty() const noexcept { return m_values.empty(); }
+
+    reference operator[](std::size_t idx) noexcept { return reference{this, idx}; }
+    const_reference operator[](std::size_t idx) const noexcept { return const_reference{this, idx}; }
+
+    bool isValid(std::size_t idx) const noexcept { return (m_valid[idx / bitsPerWord] >> (idx % bitsPerWord)) & 1; }
+
+    void push_back(const T& val)
+    {
+        m_values.push_back(val);
+        appendBit(true);
+    }
+
+    void push_back(std::nullopt_t)
+    {
+        m_values.emplace_back();
+        appendBit(false);
+    }
+
+    void push_back(const std::optional<T>& val)
+    {
+        if(val)
+        {
+            push_back(*val);
+        }
+        else
+        {
+            push_back(std::nullopt);
+        }
+    }
+
+    void set(std::size_t idx, const T& val)
+    {
+        m_values[idx] = val;
+        m_valid[idx / bitsPerWord] |= std::uint64_t{1} << (idx % bitsPerWord);
+    }
+
+    void setNull(std::size_t idx)
+    {
+        m_values[idx] = T{};
+        m_valid[idx / bitsPerWord] &= ~(std::uint64_t{1} << (idx % bitsPerWord));
+    }
+
+    // new elements are null:
+    void resize(std::size_t n)
+    {
+        std::size_t old = size();
+        m_values.resize(n);
+        m_valid.resize((n + bitsPerWord - 1) / bitsPerWord, 0);
+        if(n < old)
+        {
+            clearTailBits();
+        }
+    }
+
+    void reserve(std::size_t n)
+    {
+        m_values.reserve(n);
+        m_valid.reserve((n + bitsPerWord - 1) / bitsPerWord);
+    }
+
+    void clear() noexcept
+    {
+        m_values.clear();
+        m_valid.clear();
+    }
+
+    // all elements get the value val:
+    void fill(const T& val)
+    {
+        std::fill(m_values.begin(), m_values.end(), val);
+        std::fill(m_valid.begin(), m_valid.end(), ~std::uint64_t{0});
+        clearTailBits();
+    }
+
+    // all elements become null:
+    void fillNull()
+    {
+        std::fill(m_values.begin(), m_values.end(), T{});
+        std::fill(m_valid.begin(), m_valid.end(), 0);
+    }
+
+    // number of non-null elements:
+    std::size_t countValid() const noexcept
+    {
+        std::size_t count{0};
+        for(auto word : m_valid)
+        {
+            count += static_cast<std::size_t>(__builtin_popcountll(word));
+        }
+        return count;
+    }
+
+    // sum of all non-null elements (null slots hold T{}, so no masking is needed):
+    template<typename R = T>
+    R sum() const noexcept
+    {
+        R result{};
+        for(const auto& val : m_values)
+        {
+            result += val;
+        }
+        return result;
+    }
+
+    // f(idx, value) for all non-null elements, skipping 64 nulls at a time:
+    template<typename F>
+    void forEachValid(F&& f) const
+    {
+        for(std::size_t w{0}; w < m_valid.size(); ++w)
+        {
+            for(auto word = m_valid[w]; word != 0; word &= word - 1)
+            {
+                std::size_t idx = w * bitsPerWord + static_cast<std::size_t>(__builtin_ctzll(word));
+                f(idx, m_values[idx]);
+            }
+        }
+    }
+
+    // dense values (nulls are T{}) and validity bitmap:
+    const std::vector<T>& values() const noexcept { return m_values; }
+    const std::vector<std::uint64_t>& validityBitmap() const noexcept { return m_valid; }
+
+    std::size_t memoryUsage() const noexcept
+    {
+        return m_values.capacity() * sizeof(T) + m_valid.capacity() * sizeof(std::uint64_t);
+    }
+
+private:
+    // for the element just appended:
+    void appendBit(bool valid)
+    {
+        std::size_t idx = size() - 1;
+        if(idx % bitsPerWord == 0)
+        {
+            m_valid.push_back(0);
+        }
+        if(valid)
+        {
+            m_valid.back() |= std::uint64_t{1} << (idx % bitsPerWord);
+        }
+    }
+
+    // bits beyond size() stay 0, so that countValid() can count whole words:
+    void clearTailBits() noexcept
+    {
+        if(auto rest = size() % bitsPerWord; rest != 0)
+        {
+            m_valid.back() &= (std::uint64_t{1} << rest) - 1;
+        }
+    }
+
+    std::vector<T> m_values;
+    std::vector<std::uint64_t> m_valid;
+};
+
+/********************************************
+* compact_optional<T, Sentinel>
+* optional for scalars without the extra flag: the value Sentinel (by default the
+* maximum of T) represents "no value", so sizeof(compact_optional<int>) == sizeof(int)
+* and a vector of them is a plain array of T.
+* Storing the sentinel itself as a value is not allowed.
+********************************************/
+
+template<typename T, T Sentinel = std::numeric_limits<T>::max()>
+class compact_optional
+{
+    static_assert(std::is_integral_v<T> || std::is_enum_v<T> || std::is_pointer_v<T>, "compact_optional: T has to be a scalar usable as template argument");
+
+public:
+    using value_type = T;
+    static constexpr T sentinel = Sentinel;
+
+    constexpr compact_optional() noexcept = default;
+    constexpr compact_optional(std::nullopt_t) noexcept {}
+    constexpr compact_optional(T val) noexcept : m_val{val} { assert(val != Sentinel); }
+    constexpr compact_optional(const std::optional<T>& val) noexcept : m_val{val ? *val : Sentinel} { assert(!val || *val != Sentinel); }
+
+    constexpr compact_optional& operator=(std::nullopt_t) noexcept
+    {
+        m_val = Sentinel;
+        return *this;
+    }
+
+    constexpr bool has_value() const noexcept { return m_val != Sentinel; }
+    constexpr explicit operator bool() const noexcept { return has_value(); }
+
+    constexpr const T& operator*() const noexcept { return m_val; }
+
+    constexpr const T& value() const
+    {
+        if(!has_value())
+        {
+            throw std::bad_optional_access{};
+        }
+        return m_val;
+    }
+
+    constexpr T value_or(T fallback) const noexcept { return has_value() ? m_val : fallback; }
+
+    constexpr T& emplace(T val) noexcept
+    {
+        assert(val != Sentinel);
+        m_val = val;
+        return m_val;
+    }
+
+    constexpr void reset() noexcept { m_val = Sentinel; }
+
+    constexpr operator std::optional<T>() const { return has_value() ? std::optional<T>{m_val} : std::nullopt; }
+
+    friend constexpr bool operator==(compact_optional lhs, compact_optional rhs) noexcept { return lhs.m_val == rhs.m_val; }
+    friend constexpr bool operator!=(compact_optional lhs, compact_optional rhs) noexcept { return lhs.m_val != rhs.m_val; }
+
+private:
+    T m_val{Sentinel};
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <charconv>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include "result.h"
+
+/********************************************
+* parseNumber<T>(s)
+* exception-free replacement for std::stoi(), std::stol(), std::stod(), ...
+* based on std::from_chars(): no locale, no heap memory, no exceptions.
+* As the std::sto*() functions, leading whitespace and a '+' are skipped and
+* trailing characters are ignored; failures are returned as ParseError.
+********************************************/
+
+enum class ParseError {
+    invalid,       // no number at the beginning (std::invalid_argument for std::stoi())
+    outOfRange,    // doesn't fit into T (std::out_of_range for std::stoi())
+};
+
+constexpr const char* toString(ParseError err) noexcept
+{
+    switch(err)
+    {
+        case ParseError::invalid:
+            return "invalid";
+        case ParseError::outOfRange:
+            return "out of range";
+    }
+    return "unknown";
+}
+
+template<typename T>
+result<T, ParseError> parseNumber(std::string_view s) noexcept
+{
+    static_assert(std::is_arithmetic_v<T> && !std::is_same_v<T, bool>, "parseNumber: T has to be a number type");
+
+    const char* first = s.data();
+    const char* last = s.data() + s.size();
+    while(first != last && (*first == ' ' || (*first >= '\t' && *first <= '\r')))
+    {
+        ++first;
+    }
+    // from_chars() doesn't accept a '+', but a following '-' must still be an error:
+    if(first != last && *first == '+' && (last - first < 2 || first[1] != '-'))
+    {
+        ++first;
+    }
+
+    T val{};
+    auto [ptr, ec] = std::from_chars(first, last, val);
+    if(ec == std::errc{})
+    {
+        return val;
+    }
+    return unexpected{ec == std::errc::result_out_of_range ? ParseError::outOfRange : ParseError::invalid};
+}
@@ -0,0 +1,266 @@
+#pragma once
+
+#include <exception>
+#include <functional>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/********************************************
+* result<T, E>
+* a value of type T or an error of type E, in the style of C++23 std::expected<>:
+* - no heap memory, the value or the error is stored inline (like std::optional<>)
+* - failures are returned instead of thrown, which is cheap even if most inputs fail
+* - monadic chaining: and_then(), transform(), or_else(), transform_error()
+* Only value() throws (bad_result_access) if there is no value; use operator*,
+* value_or() or error() on hot paths.
+********************************************/
+
+template<typename E>
+class unexpected
+{
+public:
+    constexpr explicit unexpected(const E& err) : m_err{err} {}
+    constexpr explicit unexpected(E&& err) : m_err{std::move(err)} {}
+
+    constexpr const E& error() const& noexcept { return m_err; }
+    constexpr E& error() & noexcept { return m_err; }
+    constexpr E&& error() && noexcept { return std::move(m_err); }
+
+private:
+    E m_err;
+};
+
+template<typename E>
+unexpected(E) -> unexpected<E>;
+
+class bad_result_access : public std::exception
+{
+public:
+    const char* what() const noexcept override { return "bad result access"; }
+};
+
+template<typename T, typename E>
+class result
+{
+    static_assert(!std::is_reference_v<T> && !std::is_reference_v<E>, "result: no reference types");
+
+public:
+    using value_type = T;
+    using error_type = E;
+
+    template<typename U>
+    using rebind = result<U, E>;
+
+    // default constructed value:
+    constexpr result() : m_val(), m_hasValue{true} {}
+
+    template<typename U = T, typename = std::enable_if_t<std::is_constructible_v<T, U&&> && !std::is_same_v<std::decay_t<U>, result>>>
+    constexpr result(U&& val) : m_val(std::forward<U>(val)), m_hasValue{true}
+    {
+    }
+
+    template<typename G>
+    constexpr result(const unexpected<G>& err) : m_err(err.error()), m_hasValue{false}
+    {
+    }
+
+    template<typename G>
+    constexpr result(unexpected<G>&& err) : m_err(std::move(err).error()), m_hasValue{false}
+    {
+    }
+
+    result(const result& other) : m_hasValue{other.m_hasValue}
+    {
+        if(m_hasValue) {
+            ::new(&m_val) T(other.m_val);
+        }
+        else {
+            ::new(&m_err) E(other.m_err);
+        }
+    }
+
+    result(result&& other) noexcept(std::is_nothrow_move_constructible_v<T> && std::is_nothrow_move_constructible_v<E>)
+        : m_hasValue{other.m_hasValue}
+    {
+        if(m_hasValue) {
+            ::new(&m_val) T(std::move(other.m_val));
+        }
+        else {
+            ::new(&m_err) E(std::move(other.m_err));
+        }
+    }
+
+    result& operator=(const result& other)
+    {
+        if(this != &other)
+        {
+            result tmp{other};
+            destroy();
+            constructFrom(std::move(tmp));
+        }
+        return *this;
+    }
+
+    result& operator=(result&& other) noexcept(std::is_nothrow_move_constructible_v<T> && std::is_nothrow_move_constructible_v<E>)
+    {
+        if(this != &other)
+        {
+            destroy();
+            constructFrom(std::move(other));
+        }
+        return *this;
+    }
+
+    ~result() { destroy(); }
+
+    constexpr bool has_value() const noexcept { return m_hasValue; }
+    constexpr explicit operator bool() const noexcept { return m_hasValue; }
+
+    // unchecked:
+    constexpr const T& operator*() const& noexcept { return m_val; }
+    constexpr T& operator*() & noexcept { return m_val; }
+    constexpr T&& operator*() && noexcept { return std::move(m_val); }
+    constexpr const T* operator->() const noexcept { return std::addressof(m_val); }
+    constexpr T* operator->() noexcept { return std::addressof(m_val); }
+
+    constexpr const T& value() const&
+    {
+        if(!m_hasValue) {
+            throw bad_result_access{};
+        }
+        return m_val;
+    }
+
+    constexpr T& value() &
+    {
+        if(!m_hasValue) {
+            throw bad_result_access{};
+        }
+        return m_val;
+    }
+
+    constexpr T&& value() &&
+    {
+        if(!m_hasValue) {
+            throw bad_result_access{};
+        }
+        return std::move(m_val);
+    }
+
+    // unchecked, only valid without value:
+    constexpr const E& error() const& noexcept { return m_err; }
+    constexpr E& error() & noexcept { return m_err; }
+    constexpr E&& error() && noexcept { return std::move(m_err); }
+
+    template<typename U>
+    constexpr T value_or(U&& fallback) const&
+    {
+        return m_hasValue ? m_val : static_cast<T>(std::forward<U>(fallback));
+    }
+
+    template<typename U>
+    constexpr T value_or(U&& fallback) &&
+    {
+        return m_hasValue ? std::move(m_val) : static_cast<T>(std::forward<U>(fallback));
+    }
+
+    // f(value) has to return a result<U, E>, errors are passed on:
+    template<typename F>
+    constexpr auto and_then(F&& f) const&
+    {
+        using R = std::remove_cv_t<std::remove_reference_t<std::invoke_result_t<F, const T&>>>;
+        static_assert(std::is_same_v<typename R::error_type, E>, "result::and_then(): f has to return a result with the same error type");
+        if(m_hasValue) {
+            return std::invoke(std::forward<F>(f), m_val);
+        }
+        return R{unexpected<E>{m_err}};
+    }
+
+    template<typename F>
+    constexpr auto and_then(F&& f) &&
+    {
+        using R = std::remove_cv_t<std::remove_reference_t<std::invoke_result_t<F, T&&>>>;
+        static_assert(std::is_same_v<typename R::error_type, E>, "result::and_then(): f has to return a result with the same error type");
+        if(m_hasValue) {
+            return std::invoke(std::forward<F>(f), std::move(m_val));
+        }
+        return R{unexpected<E>{std::move(m_err)}};
+    }
+
+    // result<U, E> with f(value) as value, errors are passed on:
+    template<typename F>
+    constexpr auto transform(F&& f) const&
+    {
+        using U = std::remove_cv_t<std::invoke_result_t<F, const T&>>;
+        if(m_hasValue) {
+            return result<U, E>{std::invoke(std::forward<F>(f), m_val)};
+        }
+        return result<U, E>{unexpected<E>{m_err}};
+    }
+
+    template<typename F>
+    constexpr auto transform(F&& f) &&
+    {
+        using U = std::remove_cv_t<std::invoke_result_t<F, T&&>>;
+        if(m_hasValue) {
+            return result<U, E>{std::invoke(std::forward<F>(f), std::move(m_val))};
+        }
+        return result<U, E>{unexpected<E>{std::move(m_err)}};
+    }
+
+    // f(error) has to return a result<T, G>, e.g. to recover with a fallback value:
+    template<typename F>
+    constexpr auto or_else(F&& f) const&
+    {
+        using R = std::remove_cv_t<std::remove_reference_t<std::invoke_result_t<F, const E&>>>;
+        static_assert(std::is_same_v<typename R::value_type, T>, "result::or_else(): f has to return a result with the same value type");
+        if(m_hasValue) {
+            return R{m_val};
+        }
+        return std::invoke(std::forward<F>(f), m_err);
+    }
+
+    // result<T, G> with f(error) as error:
+    template<typename F>
+    constexpr auto transform_error(F&& f) const&
+    {
+        using G = std::remove_cv_t<std::invoke_result_t<F, const E&>>;
+        if(m_hasValue) {
+            return result<T, G>{m_val};
+        }
+        return result<T, G>{unexpected<G>{std::invoke(std::forward<F>(f), m_err)}};
+    }
+
+    friend constexpr bool operator==(const result& r, const T& val) { return r.has_value() && *r == val; }
+    friend constexpr bool operator!=(const result& r, const T& val) { return !(r == val); }
+
+private:
+    void destroy() noexcept
+    {
+        if(m_hasValue) {
+            m_val.~T();
+        }
+        else {
+            m_err.~E();
+        }
+    }
+
+    void constructFrom(result&& other) noexcept(std::is_nothrow_move_constructible_v<T> && std::is_nothrow_move_constructible_v<E>)
+    {
+        m_hasValue = other.m_hasValue;
+        if(m_hasValue) {
+            ::new(&m_val) T(std::move(other.m_val));
+        }
+        else {
+            ::new(&m_err) E(std::move(other.m_err));
+        }
+    }
+
+    union {
+        T m_val;
+        E m_err;
+    };
+    bool m_hasValue;
+};
@@ -0,0 +1,444 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <variant>  // for std::bad_variant_access, std::in_place_index_t
+
+/********************************************
+* BasicCompactVariant<IndexT, Ts...> / CompactVariant<Ts...>
+* a variant with the same get<>()/get_if<>()/holds_alternative<>()/visit()
+* interface as std::variant<>, but with a more compact discriminator:
+* - if one alternative has a "niche" (bit patterns that never occur in a valid
+*   object, see NicheTraits<>) and all other alternatives fit into the storage
+*   next to these bytes, the index is encoded in the niche and needs no space at all.
+*   For example, with libstdc++ a std::string never holds a pointer below 4096 in its
+*   first word, so CompactVariant<std::monostate, int, std::string> has the size of
+*   a std::string (32 bytes instead of 40 for std::variant).
+* - otherwise the index is stored in a member of type IndexT (uint8_t by default),
+*   which can be widened for more than 255 alternatives.
+* Unlike std::variant it is never valueless: if the construction of a new value throws,
+* the first alternative is default constructed (which therefore must not throw).
+********************************************/
+
+// specialize for types with unused bit patterns:
+// - count:           number of distinct niche values
+// - offset/size:     the bytes of the object representation holding the niche
+// - set(p, k):       write niche value k (k < count) into the storage at p (no object alive)
+// - get(p):          the niche value stored at p, or count if a valid object is alive
+template<typename T, typename = void>
+struct NicheTraits {
+    static constexpr std::size_t count = 0;
+};
+
+template<>
+struct NicheTraits<bool> {
+    static constexpr std::size_t count = 254;  // bool only uses 0 and 1
+    static constexpr std::size_t offset = 0;
+    static constexpr std::size_t size = 1;
+    static void set(void* p, std::size_t k) noexcept
+    {
+        auto v = static_cast<unsigned char>(k + 2);
+        std::memcpy(p, &v, 1);
+    }
+    static std::size_t get(const void* p) noexcept
+    {
+        unsigned char v;
+        std::memcpy(&v, p, 1);
+        return v >= 2 ? v - 2 : count;
+    }
+};
+
+#if defined(__GLIBCXX__)
+// libstdc++: the first word of a std::string is the pointer to its characters
+// (either the internal buffer or heap memory), never a value in the first page
+template<>
+struct NicheTraits<std::string> {
+    static constexpr std::size_t count = 4096;
+    static constexpr std::size_t offset = 0;
+    static constexpr std::size_t size = sizeof(std::uintptr_t);
+    static void set(void* p, std::size_t k) noexcept
+    {
+        auto v = static_cast<std::uintptr_t>(k);
+        std::memcpy(p, &v, size);
+    }
+    static std::size_t get(const void* p) noexcept
+    {
+        std::uintptr_t v;
+        std::memcpy(&v, p, size);
+        return v < count ? static_cast<std::size_t>(v) : count;
+    }
+};
+#endif
+
+namespace compact_variant_detail {
+
+constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+constexpr std::size_t alignUp(std::size_t n, std::size_t a) { return (n + a - 1) / a * a; }
+
+// empty trivial alternatives (like std::monostate) need no bytes at all:
+template<typename T>
+constexpr bool isStateless = std::is_empty_v<T> && std::is_trivially_default_constructible_v<T> && std::is_trivially_destructible_v<T>;
+
+template<typename... Ts>
+struct Layout {
+    static constexpr std::size_t n = sizeof...(Ts);
+    static constexpr std::size_t storageSize = std::max({ sizeof(Ts)... });
+    static constexpr std::size_t storageAlign = std::max({ alignof(Ts)... });
+
+    // offset of alternative U if Dataful holds the niche (npos if U doesn't fit next to the niche):
+    template<typename Dataful, typename U>
+    static constexpr std::size_t offsetNextToNiche()
+    {
+        if constexpr(isStateless<U>) {
+            return 0;
+        }
+        else {
+            using N = NicheTraits<Dataful>;
+            if(sizeof(U) <= N::offset) {
+                return 0;
+            }
+            std::size_t off = alignUp(N::offset + N::size, alignof(U));
+            return off + sizeof(U) <= storageSize ? off : npos;
+        }
+    }
+
+    template<typename Dataful>
+    static constexpr bool canHoldNiche()
+    {
+        if constexpr(NicheTraits<Dataful>::count + 1 < n) {
+            return false;
+        }
+        else {
+            return sizeof(Dataful) == storageSize && ((std::is_same_v<Dataful, Ts> || offsetNextToNiche<Dataful, Ts>() != npos) && ...);
+        }
+    }
+
+    // first alternative that can hold the index in its niche:
+    static constexpr std::size_t findDataful()
+    {
+        std::size_t idx{0};
+        std::size_t found{npos};
+        ((found == npos && canHoldNiche<Ts>() ? found = idx : 0, ++idx), ...);
+        return found;
+    }
+
+    static constexpr std::size_t dataful = findDataful();
+};
+
+template<typename IndexT, bool Present>
+struct IndexField {
+    IndexT m_index{0};
+};
+
+template<typename IndexT>
+struct IndexField<IndexT, false> {
+};
+
+template<std::size_t I, typename... Ts>
+using nth_t = std::tuple_element_t<I, std::tuple<Ts...>>;
+
+template<typename T, typename... Ts>
+constexpr std::size_t indexOf()
+{
+    std::size_t idx{0};
+    std::size_t found{npos};
+    ((found == npos && std::is_same_v<T, Ts> ? found = idx : 0, ++idx), ...);
+    return found;
+}
+
+}  // namespace compact_variant_detail
+
+template<typename IndexT, typename... Ts>
+class BasicCompactVariant : private compact_variant_detail::IndexField<IndexT, compact_variant_detail::Layout<Ts...>::dataful == compact_variant_detail::npos>
+{
+    using Layout = compact_variant_detail::Layout<Ts...>;
+    static constexpr std::size_t n = sizeof...(Ts);
+    static constexpr std::size_t npos = compact_variant_detail::npos;
+
+    static_assert(n > 0, "BasicCompactVariant: at least one alternative");
+    static_assert(std::is_unsigned_v<IndexT> && n - 1 <= std::numeric_limits<IndexT>::max(), "BasicCompactVariant: IndexT too small");
+    static_assert(std::is_nothrow_default_constructible_v<compact_variant_detail::nth_t<0, Ts...>>,
+                  "BasicCompactVariant: the first alternative is the fallback state and must be nothrow default constructible");
+
+public:
+    static constexpr bool usesNiche = Layout::dataful != npos;
+
+    template<std::size_t I>
+    using alternative_t = compact_variant_detail::nth_t<I, Ts...>;
+
+    BasicCompactVariant() noexcept { constructAt<0>(); }
+
+    template<typename T, typename D = std::decay_t<T>, std::size_t I = compact_variant_detail::indexOf<D, Ts...>(), typename = std::enable_if_t<I != npos>>
+    BasicCompactVariant(T&& val)
+    {
+        constructAt<I>(std::forward<T>(val));
+    }
+
+    template<std::size_t I, typename... Args>
+    explicit BasicCompactVariant(std::in_place_index_t<I>, Args&&... args)
+    {
+        constructAt<I>(std::forward<Args>(args)...);
+    }
+
+    BasicCompactVariant(const BasicCompactVariant& other)
+    {
+        other.dispatch([this](auto idx, const auto& val) { constructAt<decltype(idx)::value>(val); });
+    }
+
+    BasicCompactVariant(BasicCompactVariant&& other) noexcept(std::conjunction_v<std::is_nothrow_move_constructible<Ts>...>)
+    {
+        other.dispatch([this](auto idx, auto& val) { constructAt<decltype(idx)::value>(std::move(val)); });
+    }
+
+    BasicCompactVariant& operator=(const BasicCompactVariant& other)
+    {
+        if(this != &other)
+        {
+            other.dispatch([this](auto idx, const auto& val) { assignAt<decltype(idx)::value>(val); });
+        }
+        return *this;
+    }
+
+    BasicCompactVariant& operator=(BasicCompactVariant&& other) noexcept(std::conjunction_v<std::is_nothrow_move_constructible<Ts>...>)
+    {
+        if(this != &other)
+        {
+            other.dispatch([this](auto idx, auto& val) { assignAt<decltype(idx)::value>(std::move(val)); });
+        }
+        return *this;
+    }
+
+    template<typename T, typename D = std::decay_t<T>, std::size_t I = compact_variant_detail::indexOf<D, Ts...>(), typename = std::enable_if_t<I != npos>>
+    BasicCompactVariant& operator=(T&& val)
+    {
+        assignAt<I>(std::forward<T>(val));
+        return *this;
+    }
+
+    ~BasicCompactVariant() { destroy(); }
+
+    std::size_t index() const noexcept
+    {
+        if constexpr(usesNiche) {
+            using Dataful = alternative_t<Layout::dataful>;
+            std::size_t k = NicheTraits<Dataful>::get(m_storage);
+            if(k >= NicheTraits<Dataful>::count) {
+                return Layout::dataful;
+            }
+            return k < Layout::dataful ? k : k + 1;
+        }
+        else {
+            return this->m_index;
+        }
+    }
+
+    // never valueless, provided for compatibility with std::variant:
+    constexpr bool valueless_by_exception() const noexcept { return false; }
+
+    template<std::size_t I, typename... Args>
+    alternative_t<I>& emplace(Args&&... args)
+    {
+        destroy();
+        try {
+            constructAt<I>(std::forward<Args>(args)...);
+        }
+        catch(...) {
+            constructAt<0>();
+            throw;
+        }
+        return *ptr<I>();
+    }
+
+    template<typename T, typename... Args>
+    T& emplace(Args&&... args)
+    {
+        constexpr std::size_t I = compact_variant_detail::indexOf<T, Ts...>();
+        static_assert(I != npos, "BasicCompactVariant: T is not an alternative");
+        return emplace<I>(std::forward<Args>(args)...);
+    }
+
+    // unchecked access to alternative I:
+    template<std::size_t I>
+    alternative_t<I>* ptr() noexcept
+    {
+        using T = alternative_t<I>;
+        if constexpr(usesNiche && compact_variant_detail::isStateless<T> && I != Layout::dataful) {
+            static T instance{};
+            return &instance;
+        }
+        else {
+            return std::launder(reinterpret_cast<T*>(m_storage + offsetOf<I>()));
+        }
+    }
+
+    template<std::size_t I>
+    const alternative_t<I>* ptr() const noexcept
+    {
+        return const_cast<BasicCompactVariant*>(this)->template ptr<I>();
+    }
+
+    // call f(std::integral_constant<size_t, I>, alternative) for the current alternative:
+    template<typename F>
+    decltype(auto) dispatch(F&& f)
+    {
+        return dispatchImpl(*this, std::forward<F>(f), std::index_sequence_for<Ts...>{});
+    }
+
+    template<typename F>
+    decltype(auto) dispatch(F&& f) const
+    {
+        return dispatchImpl(*this, std::forward<F>(f), std::index_sequence_for<Ts...>{});
+    }
+
+private:
+    template<std::size_t I>
+    static constexpr std::size_t offsetOf()
+    {
+        if constexpr(!usesNiche || I == Layout::dataful) {
+            return 0;
+        }
+        else {
+            return Layout::template offsetNextToNiche<alternative_t<Layout::dataful>, alternative_t<I>>();
+        }
+    }
+
+    template<std::size_t I, typename... Args>
+    void constructAt(Args&&... args)
+    {
+        using T = alternative_t<I>;
+        if constexpr(!(usesNiche && compact_variant_detail::isStateless<T> && I != Layout::dataful)) {
+            ::new(static_cast<void*>(m_storage + offsetOf<I>())) T(std::forward<Args>(args)...);
+        }
+        if constexpr(usesNiche) {
+            if constexpr(I != Layout::dataful) {
+                NicheTraits<alternative_t<Layout::dataful>>::set(m_storage, I < Layout::dataful ? I : I - 1);
+            }
+        }
+        else {
+            this->m_index = static_cast<IndexT>(I);
+        }
+    }
+
+    template<std::size_t I, typename Arg>
+    void assignAt(Arg&& arg)
+    {
+        if(index() == I)
+        {
+            *ptr<I>() = std::forward<Arg>(arg);
+        }
+        else
+        {
+            emplace<I>(std::forward<Arg>(arg));
+        }
+    }
+
+    void destroy() noexcept
+    {
+        dispatch([](auto, auto& val) {
+            using T = std::decay_t<decltype(val)>;
+            if constexpr(!std::is_trivially_destructible_v<T>) {
+                val.~T();
+            }
+        });
+    }
+
+    template<typename Self, typename F, std::size_t... Is>
+    static decltype(auto) dispatchImpl(Self& self, F&& f, std::index_sequence<Is...>)
+    {
+        using R = std::invoke_result_t<F, std::integral_constant<std::size_t, 0>, decltype(*self.template ptr<0>())>;
+        using Fn = R (*)(Self&, F&);
+        static constexpr Fn table[] = { [](Self& s, F& fn) -> R { return fn(std::integral_constant<std::size_t, Is>{}, *s.template ptr<Is>()); }... };
+        return table[self.index()](self, f);
+    }
+
+    alignas(Layout::storageAlign) unsigned char m_storage[Layout::storageSize];
+};
+
+template<typename... Ts>
+using CompactVariant = BasicCompactVariant<std::uint8_t, Ts...>;
+
+// std::variant compatible free functions:
+
+template<typename T, typename IndexT, typename... Ts>
+constexpr bool holds_alternative(const BasicCompactVariant<IndexT, Ts...>& v) noexcept
+{
+    return v.index() == compact_variant_detail::indexOf<T, Ts...>();
+}
+
+template<std::size_t I, typename IndexT, typename... Ts>
+auto* get_if(BasicCompactVariant<IndexT, Ts...>* v) noexcept
+{
+    return v && v->index() == I ? v->template ptr<I>() : nullptr;
+}
+
+template<std::size_t I, typename IndexT, typename... Ts>
+auto* get_if(const BasicCompactVariant<IndexT, Ts...>* v) noexcept
+{
+    return v && v->index() == I ? v->template ptr<I>() : nullptr;
+}
+
+template<typename T, typename IndexT, typename... Ts>
+auto* get_if(BasicCompactVariant<IndexT, Ts...>* v) noexcept
+{
+    return get_if<compact_variant_detail::indexOf<T, Ts...>()>(v);
+}
+
+template<typename T, typename IndexT, typename... Ts>
+auto* get_if(const BasicCompactVariant<IndexT, Ts...>* v) noexcept
+{
+    return get_if<compact_variant_detail::indexOf<T, Ts...>()>(v);
+}
+
+template<std::size_t I, typename IndexT, typename... Ts>
+auto& get(BasicCompactVariant<IndexT, Ts...>& v)
+{
+    if(v.index() != I)
+    {
+        throw std::bad_variant_access{};
+    }
+    return *v.template ptr<I>();
+}
+
+template<std::size_t I, typename IndexT, typename... Ts>
+const auto& get(const BasicCompactVariant<IndexT, Ts...>& v)
+{
+    if(v.index() != I)
+    {
+        throw std::bad_variant_access{};
+    }
+    return *v.template ptr<I>();
+}
+
+template<typename T, typename IndexT, typename... Ts>
+T& get(BasicCompactVariant<IndexT, Ts...>& v)
+{
+    return get<compact_variant_detail::indexOf<T, Ts...>()>(v);
+}
+
+template<typename T, typename IndexT, typename... Ts>
+const T& get(const BasicCompactVariant<IndexT, Ts...>& v)
+{
+    return get<compact_variant_detail::indexOf<T, Ts...>()>(v);
+}
+
+template<typename Visitor, typename IndexT, typename... Ts>
+decltype(auto) visit(Visitor&& vis, BasicCompactVariant<IndexT, Ts...>& v)
+{
+    return v.dispatch([&](auto, auto& val) -> decltype(auto) { return std::invoke(std::forward<Visitor>(vis), val); });
+}
+
+template<typename Visitor, typename IndexT, typename... Ts>
+decltype(auto) visit(Visitor&& vis, const BasicCompactVariant<IndexT, Ts...>& v)
+{
+    return v.dispatch([&](auto, const auto& val) -> decltype(auto) { return std::invoke(std::forward<Visitor>(vis), val); });
+}
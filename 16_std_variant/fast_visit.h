@@ -0,0 +1,122 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+/********************************************
+* fastVisit(visitor, variants...)
+* drop-in replacement for std::visit() for hot loops:
+* - up to 32 alternatives the dispatch is a plain switch over index(), which
+*   compilers turn into a jump table and can inline every call of the visitor
+* - with more alternatives a table of function pointers generated at compile time is used
+* - several variants are visited one after the other (nested dispatch): each level is a
+*   switch that the compiler can inline, instead of one flattened table of function
+*   pointers for all combinations; the visitor is still instantiated for each of the
+*   N1 x N2 x ... combinations, as with std::visit()
+* As std::visit(), it throws std::bad_variant_access for a valueless variant.
+********************************************/
+
+namespace fast_visit_detail {
+
+// the alternative I without checking the index again, with the value category of the variant:
+template<std::size_t I, typename Variant>
+constexpr decltype(auto) getUnchecked(Variant&& var) noexcept
+{
+    auto* p = std::get_if<I>(std::addressof(var));
+    if constexpr(std::is_lvalue_reference_v<Variant>) {
+        return *p;
+    }
+    else {
+        return std::move(*p);
+    }
+}
+
+template<typename Visitor, typename Variant, std::size_t I = 0>
+using result_t = std::invoke_result_t<Visitor, decltype(getUnchecked<I>(std::declval<Variant>()))>;
+
+// as std::visit(), the visitor has to return the same type for all alternatives:
+template<typename Visitor, typename Variant, std::size_t... Is>
+constexpr bool sameResultForAll(std::index_sequence<Is...>)
+{
+    return (std::is_same_v<result_t<Visitor, Variant, Is>, result_t<Visitor, Variant>> && ...);
+}
+
+template<std::size_t I, typename R, typename Visitor, typename Variant>
+constexpr R invokeAlternative(Visitor&& vis, Variant&& var)
+{
+    return std::invoke(std::forward<Visitor>(vis), getUnchecked<I>(std::forward<Variant>(var)));
+}
+
+template<typename R, typename Visitor, typename Variant, std::size_t... Is>
+R visitByTable(Visitor&& vis, Variant&& var, std::index_sequence<Is...>)
+{
+    using Fn = R (*)(Visitor&&, Variant&&);
+    static constexpr std::array<Fn, sizeof...(Is)> table{ &invokeAlternative<Is, R, Visitor, Variant>... };
+    return table[var.index()](std::forward<Visitor>(vis), std::forward<Variant>(var));
+}
+
+}  // namespace fast_visit_detail
+
+template<typename Visitor, typename Variant>
+constexpr decltype(auto) fastVisit(Visitor&& vis, Variant&& var)
+{
+    using V = std::remove_cv_t<std::remove_reference_t<Variant>>;
+    using R = fast_visit_detail::result_t<Visitor, Variant>;
+    constexpr std::size_t n = std::variant_size_v<V>;
+    static_assert(fast_visit_detail::sameResultForAll<Visitor, Variant>(std::make_index_sequence<n>{}),
+                  "fastVisit: the visitor has to return the same type for all alternatives");
+
+    if(var.valueless_by_exception())
+    {
+        throw std::bad_variant_access{};
+    }
+
+    if constexpr(n <= 32) {
+// one case per possible alternative, cases beyond the number of alternatives are never taken:
+#define FAST_VISIT_CASE(I)                                                                                                        \
+    case I:                                                                                                                       \
+        if constexpr(I < n) {                                                                                                     \
+            return fast_visit_detail::invokeAlternative<I, R>(std::forward<Visitor>(vis), std::forward<Variant>(var));           \
+        }                                                                                                                         \
+        break;
+
+        switch(var.index())
+        {
+            FAST_VISIT_CASE(0) FAST_VISIT_CASE(1) FAST_VISIT_CASE(2) FAST_VISIT_CASE(3)
+            FAST_VISIT_CASE(4) FAST_VISIT_CASE(5) FAST_VISIT_CASE(6) FAST_VISIT_CASE(7)
+            FAST_VISIT_CASE(8) FAST_VISIT_CASE(9) FAST_VISIT_CASE(10) FAST_VISIT_CASE(11)
+            FAST_VISIT_CASE(12) FAST_VISIT_CASE(13) FAST_VISIT_CASE(14) FAST_VISIT_CASE(15)
+            FAST_VISIT_CASE(16) FAST_VISIT_CASE(17) FAST_VISIT_CASE(18) FAST_VISIT_CASE(19)
+            FAST_VISIT_CASE(20) FAST_VISIT_CASE(21) FAST_VISIT_CASE(22) FAST_VISIT_CASE(23)
+            FAST_VISIT_CASE(24) FAST_VISIT_CASE(25) FAST_VISIT_CASE(26) FAST_VISIT_CASE(27)
+            FAST_VISIT_CASE(28) FAST_VISIT_CASE(29) FAST_VISIT_CASE(30) FAST_VISIT_CASE(31)
+            default:
+                break;
+        }
+#undef FAST_VISIT_CASE
+        __builtin_unreachable();
+    }
+    else {
+        return fast_visit_detail::visitByTable<R>(std::forward<Visitor>(vis), std::forward<Variant>(var), std::make_index_sequence<n>{});
+    }
+}
+
+// several variants: dispatch on the first one, then visit the others with the value bound:
+template<typename Visitor, typename Variant1, typename Variant2, typename... Variants>
+constexpr decltype(auto) fastVisit(Visitor&& vis, Variant1&& var1, Variant2&& var2, Variants&&... vars)
+{
+    return fastVisit(
+        [&](auto&& a) -> decltype(auto) {
+            return fastVisit(
+                [&](auto&&... bs) -> decltype(auto) {
+                    return std::invoke(std::forward<Visitor>(vis), std::forward<decltype(a)>(a), std::forward<decltype(bs)>(bs)...);
+                },
+                std::forward<Variant2>(var2), std::forward<Variants>(vars)...);
+        },
+        std::forward<Variant1>(var1));
+}
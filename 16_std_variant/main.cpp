@@ -4,6 +4,18 @@
 #include <complex>
 #include <vector>
 #include <set>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include "fast_visit.h"
+#include "variant_vector.h"
+#include "compact_variant.h"
+#include "ring_buffer.h"
 
 /*
     With std::variant<> the C++ standard library provides a new union class, which among other
@@ -128,17 +140,500 @@ void comparison()
     std::variant<std::monostate, std::string, int> v4;
 
     // v1 == v4 // COMPILE-TIME ERROR
-    v1 == v2 // yields false
-    v1 < v2 // yields true
-    v1 < v3 // yields true
-    v2 < v3 // yields false
+    std::cout << std::boolalpha;
+    std::cout << (v1 == v2) << '\n'; // yields false
+    std::cout << (v1 < v2) << '\n'; // yields true
+    std::cout << (v1 < v3) << '\n'; // yields true
+    std::cout << (v2 < v3) << '\n'; // yields false
     v1 = "hello";
-    v1 == v2 // yields true
+    std::cout << (v1 == v2) << '\n'; // yields true
     v2 = 41;
-    v2 < v3 // yields true
+    std::cout << (v2 < v3) << '\n'; // yields true
 
 }
 
+template <typename T>
+double diff(const T& t0, const T& t1)
+{
+    return std::chrono::duration<double,std::milli>(t1 - t0).count();
+}
+
+// alternatives for a variant with many types:
+template<std::size_t I>
+struct Shape {
+    double value = I;
+};
+
+template<typename Seq> struct ShapeVariantImpl;
+template<std::size_t... Is> struct ShapeVariantImpl<std::index_sequence<Is...>> {
+    using type = std::variant<Shape<Is>...>;
+};
+template<std::size_t N>
+using ShapeVariant = typename ShapeVariantImpl<std::make_index_sequence<N>>::type;
+
+// create a ShapeVariant holding the alternative with the passed index:
+template<std::size_t N, std::size_t... Is>
+ShapeVariant<N> makeShape(std::size_t idx, std::index_sequence<Is...>)
+{
+    using Factory = ShapeVariant<N> (*)();
+    static constexpr Factory factories[] = { [] { return ShapeVariant<N>{std::in_place_index<Is>}; }... };
+    return factories[idx]();
+}
+
+void visitPerformance()
+{
+    /*
+    std::visit() is the generic way to deal with the current alternative. For hot loops over
+    large inhomogeneous collections the dispatch matters. fastVisit() (see fast_visit.h)
+    dispatches with a switch over index() for up to 32 alternatives, so that the compiler can
+    inline the visitor, and nests the dispatch when visiting several variants.
+    */
+    const std::size_t numElems{10'000'000};
+    std::mt19937 eng{42};
+
+    using Var = std::variant<int, long, float, double, std::string>;
+    std::vector<Var> coll;
+    coll.reserve(numElems);
+    for(std::size_t i{0}; i < numElems; ++i)
+    {
+        switch(eng() % 5)
+        {
+            case 0: coll.emplace_back(static_cast<int>(i)); break;
+            case 1: coll.emplace_back(static_cast<long>(i)); break;
+            case 2: coll.emplace_back(static_cast<float>(i)); break;
+            case 3: coll.emplace_back(static_cast<double>(i)); break;
+            default: coll.emplace_back(std::string(i % 16, 'x')); break;
+        }
+    }
+
+    auto weight = [](const auto& val) -> double {
+        if constexpr(std::is_same_v<std::decay_t<decltype(val)>, std::string>) {
+            return static_cast<double>(val.size());
+        }
+        else {
+            return static_cast<double>(val);
+        }
+    };
+
+    const std::size_t numShapes{32};
+    std::vector<ShapeVariant<numShapes>> shapes;
+    shapes.reserve(numElems);
+    for(std::size_t i{0}; i < numElems; ++i)
+    {
+        shapes.push_back(makeShape<numShapes>(eng() % numShapes, std::make_index_sequence<numShapes>{}));
+    }
+
+    for(int i{0}; i < 5; ++i)
+    {
+        double sum1{0}, sum2{0}, sum3{0}, sum4{0}, sum5{0};
+        auto t0 = std::chrono::steady_clock::now();
+        for(const auto& v : coll)
+        {
+            sum1 += std::visit(weight, v);
+        }
+        auto t1 = std::chrono::steady_clock::now();
+        for(const auto& v : coll)
+        {
+            switch(v.index())
+            {
+                case 0: sum2 += weight(*std::get_if<0>(&v)); break;
+                case 1: sum2 += weight(*std::get_if<1>(&v)); break;
+                case 2: sum2 += weight(*std::get_if<2>(&v)); break;
+                case 3: sum2 += weight(*std::get_if<3>(&v)); break;
+                case 4: sum2 += weight(*std::get_if<4>(&v)); break;
+            }
+        }
+        auto t2 = std::chrono::steady_clock::now();
+        for(const auto& v : coll)
+        {
+            sum3 += fastVisit(weight, v);
+        }
+        auto t3 = std::chrono::steady_clock::now();
+        for(const auto& s : shapes)
+        {
+            sum4 += std::visit([](const auto& x) { return x.value; }, s);
+        }
+        auto t4 = std::chrono::steady_clock::now();
+        for(const auto& s : shapes)
+        {
+            sum5 += fastVisit([](const auto& x) { return x.value; }, s);
+        }
+        auto t5 = std::chrono::steady_clock::now();
+
+        std::cout << "5 alternatives:  std::visit(): " << diff(t0, t1) << "ms, index() switch: " << diff(t1, t2)
+                  << "ms, fastVisit(): " << diff(t2, t3) << "ms\n";
+        std::cout << "32 alternatives: std::visit(): " << diff(t3, t4) << "ms, fastVisit(): " << diff(t4, t5) << "ms\n";
+        if(sum1 != sum2 || sum1 != sum3 || sum4 != sum5) {
+            std::cout << "ERROR: different results\n";
+        }
+    }
+
+    // visiting two variants at once:
+    auto t0 = std::chrono::steady_clock::now();
+    double sum1{0}, sum2{0};
+    for(std::size_t i{1}; i < numElems; ++i)
+    {
+        sum1 += std::visit([&](const auto& a, const auto& b) { return weight(a) * weight(b); }, coll[i - 1], coll[i]);
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    for(std::size_t i{1}; i < numElems; ++i)
+    {
+        sum2 += fastVisit([&](const auto& a, const auto& b) { return weight(a) * weight(b); }, coll[i - 1], coll[i]);
+    }
+    auto t2 = std::chrono::steady_clock::now();
+    std::cout << "2 variants:      std::visit(): " << diff(t0, t1) << "ms, fastVisit(): " << diff(t1, t2) << "ms"
+              << (sum1 != sum2 ? " ERROR: different results" : "") << '\n';
+}
+
+void variantVectorPerformance()
+{
+    /*
+    In a std::vector<std::variant<...>> every element is as large as the largest alternative
+    (plus the index) and every pass over the elements has to check the index of each element.
+    VariantVector (see variant_vector.h) stores one vector per alternative plus an order index,
+    so int-only work runs over a plain vector<int>.
+    */
+    const std::size_t numElems{10'000'000};
+    std::mt19937 eng{42};
+
+    using Var = std::variant<int, double, std::string>;
+    std::vector<Var> coll;
+    VariantVector<int, double, std::string> vv;
+    coll.reserve(numElems);
+    vv.reserve(numElems);
+    for(std::size_t i{0}; i < numElems; ++i)
+    {
+        auto r = eng() % 10;
+        if(r < 7) {
+            coll.emplace_back(static_cast<int>(i));
+            vv.push_back(static_cast<int>(i));
+        }
+        else if(r < 9) {
+            coll.emplace_back(static_cast<double>(i));
+            vv.push_back(static_cast<double>(i));
+        }
+        else {
+            coll.emplace_back(std::string(i % 16, 'x'));
+            vv.push_back(std::string(i % 16, 'x'));
+        }
+    }
+
+    std::cout << "memory vector<variant>: " << coll.capacity() * sizeof(Var) / (1024 * 1024) << " MiB, "
+              << "VariantVector: " << vv.memoryUsage() / (1024 * 1024) << " MiB\n";
+
+    for(int i{0}; i < 5; ++i)
+    {
+        long sum1{0}, sum2{0};
+        double all1{0}, all2{0};
+        auto t0 = std::chrono::steady_clock::now();
+        for(const auto& v : coll)
+        {
+            if(auto p = std::get_if<int>(&v); p) {
+                sum1 += *p;
+            }
+        }
+        auto t1 = std::chrono::steady_clock::now();
+        vv.for_each_of<int>([&](int val) { sum2 += val; });
+        auto t2 = std::chrono::steady_clock::now();
+
+        auto weight = [](const auto& val) -> double {
+            if constexpr(std::is_same_v<std::decay_t<decltype(val)>, std::string>) {
+                return static_cast<double>(val.size());
+            }
+            else {
+                return static_cast<double>(val);
+            }
+        };
+        for(const auto& v : coll)
+        {
+            all1 += fastVisit(weight, v);
+        }
+        auto t3 = std::chrono::steady_clock::now();
+        vv.for_each([&](const auto& val) { all2 += weight(val); });
+        auto t4 = std::chrono::steady_clock::now();
+
+        std::cout << "sum of ints:     vector<variant>: " << diff(t0, t1) << "ms, for_each_of<int>(): " << diff(t1, t2) << "ms\n";
+        std::cout << "insertion order: vector<variant>: " << diff(t2, t3) << "ms, for_each(): " << diff(t3, t4) << "ms\n";
+        if(sum1 != sum2 || all1 != all2) {
+            std::cout << "ERROR: different results\n";
+        }
+    }
+}
+
+void compactVariantReport()
+{
+    /*
+    A std::variant<> is as large as the largest alternative plus the index, rounded up to the
+    alignment. CompactVariant (see compact_variant.h) encodes the index in a niche of one
+    alternative (values its object representation never has) if possible, and otherwise
+    stores it in an index type of configurable width.
+    */
+    using Var = std::variant<std::monostate, int, std::string>;
+    using CVar = CompactVariant<std::monostate, int, std::string>;
+    std::cout << "sizeof variant<monostate, int, string>:                  " << sizeof(Var) << '\n';
+    std::cout << "sizeof CompactVariant<monostate, int, string>:           " << sizeof(CVar)
+              << (CVar::usesNiche ? " (index in niche)" : "") << '\n';
+    std::cout << "sizeof variant<bool, monostate>:                         " << sizeof(std::variant<bool, std::monostate>) << '\n';
+    std::cout << "sizeof CompactVariant<bool, monostate>:                  " << sizeof(CompactVariant<bool, std::monostate>) << '\n';
+    std::cout << "sizeof variant<char, short, char>:                       " << sizeof(std::variant<char, short, char>) << '\n';
+    std::cout << "sizeof BasicCompactVariant<uint16_t, char, short, char>: " << sizeof(BasicCompactVariant<std::uint16_t, char, short, char>) << '\n';
+
+    const std::size_t numElems{10'000'000};
+    std::mt19937 eng{42};
+    std::vector<Var> coll1;
+    std::vector<CVar> coll2;
+    coll1.reserve(numElems);
+    coll2.reserve(numElems);
+    for(std::size_t i{0}; i < numElems; ++i)
+    {
+        auto r = eng() % 10;
+        if(r < 2) {
+            coll1.emplace_back();
+            coll2.emplace_back();
+        }
+        else if(r < 8) {
+            coll1.emplace_back(static_cast<int>(i));
+            coll2.emplace_back(static_cast<int>(i));
+        }
+        else {
+            coll1.emplace_back(std::string(i % 16, 'x'));
+            coll2.emplace_back(std::string(i % 16, 'x'));
+        }
+    }
+    std::cout << "cache footprint of " << numElems << " elements: vector<variant>: " << coll1.capacity() * sizeof(Var) / (1024 * 1024)
+              << " MiB, vector<CompactVariant>: " << coll2.capacity() * sizeof(CVar) / (1024 * 1024) << " MiB\n";
+
+    auto weight = [](const auto& val) -> long {
+        using T = std::decay_t<decltype(val)>;
+        if constexpr(std::is_same_v<T, std::string>) {
+            return static_cast<long>(val.size());
+        }
+        else if constexpr(std::is_same_v<T, int>) {
+            return val;
+        }
+        else {
+            return 1;
+        }
+    };
+    for(int i{0}; i < 5; ++i)
+    {
+        long sum1{0}, sum2{0};
+        auto t0 = std::chrono::steady_clock::now();
+        for(const auto& v : coll1)
+        {
+            sum1 += fastVisit(weight, v);
+        }
+        auto t1 = std::chrono::steady_clock::now();
+        for(const auto& v : coll2)
+        {
+            sum2 += visit(weight, v);
+        }
+        auto t2 = std::chrono::steady_clock::now();
+        std::cout << "visit all: vector<variant>: " << diff(t0, t1) << "ms, vector<CompactVariant>: " << diff(t1, t2) << "ms"
+                  << (sum1 != sum2 ? " ERROR: different results" : "") << '\n';
+    }
+}
+
+// events passed between threads, std::monostate tells a consumer to stop:
+struct Tick {
+    long stamp;
+    double price;
+};
+struct Order {
+    long stamp;
+    int id;
+    int qty;
+    double price;
+};
+struct Cancel {
+    long stamp;
+    int id;
+};
+using Event = std::variant<std::monostate, Tick, Order, Cancel>;
+
+// the usual mutex-guarded queue as baseline:
+template<typename T>
+class LockedQueue
+{
+public:
+    void push(T val)
+    {
+        {
+            std::lock_guard lock{m_mutex};
+            m_queue.push_back(std::move(val));
+        }
+        m_cv.notify_one();
+    }
+
+    T pop()
+    {
+        std::unique_lock lock{m_mutex};
+        m_cv.wait(lock, [&] { return !m_queue.empty(); });
+        T val = std::move(m_queue.front());
+        m_queue.pop_front();
+        return val;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<T> m_queue;
+};
+
+long nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// numMsgs events from numProducers to numConsumers threads, prints throughput and latency percentiles:
+template<typename Queue>
+void runEventQueue(const char* name, Queue& queue, int numProducers, int numConsumers, std::size_t numMsgs)
+{
+    std::vector<std::vector<long>> latencies(numConsumers);
+    std::vector<double> sums(numConsumers);
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<std::thread> consumers;
+    for(int c{0}; c < numConsumers; ++c)
+    {
+        consumers.emplace_back([&, c] {
+            std::size_t count{0};
+            for(;;)
+            {
+                Event ev = queue.pop();
+                if(std::holds_alternative<std::monostate>(ev)) {
+                    break;
+                }
+                long stamp = fastVisit([](const auto& e) -> long {
+                    if constexpr(std::is_same_v<std::decay_t<decltype(e)>, std::monostate>) {
+                        return 0;
+                    }
+                    else {
+                        return e.stamp;
+                    }
+                }, ev);
+                if(++count % 16 == 0) {
+                    latencies[c].push_back(nowNs() - stamp);
+                }
+                if(auto p = std::get_if<Order>(&ev); p) {
+                    sums[c] += p->price * p->qty;
+                }
+            }
+        });
+    }
+    std::vector<std::thread> producers;
+    for(int p{0}; p < numProducers; ++p)
+    {
+        producers.emplace_back([&, p] {
+            for(std::size_t i = p; i < numMsgs; i += numProducers)
+            {
+                switch(i % 3)
+                {
+                    case 0: queue.push(Tick{ nowNs(), 1.5 }); break;
+                    case 1: queue.push(Order{ nowNs(), static_cast<int>(i), 2, 3.5 }); break;
+                    default: queue.push(Cancel{ nowNs(), static_cast<int>(i) }); break;
+                }
+            }
+        });
+    }
+    for(auto& t : producers)
+    {
+        t.join();
+    }
+    for(int c{0}; c < numConsumers; ++c)
+    {
+        queue.push(std::monostate{});
+    }
+    for(auto& t : consumers)
+    {
+        t.join();
+    }
+    auto t1 = std::chrono::steady_clock::now();
+
+    std::vector<long> all;
+    for(const auto& l : latencies)
+    {
+        all.insert(all.end(), l.begin(), l.end());
+    }
+    std::sort(all.begin(), all.end());
+    std::cout << name << ' ' << numProducers << "P/" << numConsumers << "C: "
+              << numMsgs / diff(t0, t1) / 1000.0 << " M msgs/s, latency p50: " << (all.empty() ? 0 : all[all.size() / 2])
+              << "ns, p99: " << (all.empty() ? 0 : all[all.size() * 99 / 100]) << "ns\n";
+}
+
+void eventQueuePerformance()
+{
+    /*
+    Passing std::variant<> events by value between threads: a mutex-guarded std::deque
+    locks on every operation and allocates deque blocks, SpscRing and MpmcRing
+    (see ring_buffer.h) construct the events in place in a preallocated ring.
+    */
+    const std::size_t numMsgs{2'000'000};
+    const std::size_t capacity{4096};
+    std::cout << "hardware threads: " << std::thread::hardware_concurrency() << '\n';
+
+    {
+        LockedQueue<Event> queue;
+        runEventQueue("LockedQueue", queue, 1, 1, numMsgs);
+    }
+    {
+        SpscRing<Event> ring{capacity};
+        runEventQueue("SpscRing   ", ring, 1, 1, numMsgs);
+    }
+    {
+        // batches: the producer publishes and the consumer releases 64 events with one store
+        SpscRing<Event> ring{capacity};
+        auto t0 = std::chrono::steady_clock::now();
+        double sum{0};
+        std::thread consumer{[&] {
+            std::vector<Event> batch(64);
+            for(bool done{false}; !done;)
+            {
+                auto n = ring.pop_batch(batch.begin(), batch.size());
+                for(std::size_t i{0}; i < n; ++i)
+                {
+                    if(std::holds_alternative<std::monostate>(batch[i])) {
+                        done = true;
+                    }
+                    else if(auto p = std::get_if<Order>(&batch[i]); p) {
+                        sum += p->price * p->qty;
+                    }
+                }
+            }
+        }};
+        std::vector<Event> batch;
+        for(std::size_t i{0}; i < numMsgs; i += 64)
+        {
+            batch.clear();
+            for(std::size_t j{i}; j < std::min(i + 64, numMsgs); ++j)
+            {
+                batch.push_back(Order{ 0, static_cast<int>(j), 2, 3.5 });
+            }
+            for(std::size_t done{0}; done < batch.size();)
+            {
+                done += ring.try_push_batch(batch.begin() + done, batch.size() - done);
+                if(done < batch.size()) {
+                    std::this_thread::yield();
+                }
+            }
+        }
+        ring.push(std::monostate{});
+        consumer.join();
+        auto t1 = std::chrono::steady_clock::now();
+        std::cout << "SpscRing batches of 64: " << numMsgs / diff(t0, t1) / 1000.0 << " M msgs/s\n";
+    }
+    for(int n : {1, 2, 4})
+    {
+        {
+            LockedQueue<Event> queue;
+            runEventQueue("LockedQueue", queue, n, n, numMsgs);
+        }
+        {
+            MpmcRing<Event> ring{capacity};
+            runEventQueue("MpmcRing   ", ring, n, n, numMsgs);
+        }
+    }
+}
+
 int main()
 {
     
@@ -221,6 +716,11 @@ int main()
     std::cout << "--------\n";
     changeTheValue();
 
+    // visitPerformance();
+    // variantVectorPerformance();
+    // compactVariantReport();
+    // eventQueuePerformance();
+
     return 0;
 }
 
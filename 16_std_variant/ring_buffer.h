@@ -0,0 +1,488 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+/********************************************
+* SpscRing<T> / MpmcRing<T>
+* bounded lock-free queues to pass values (e.g. std::variant<> events) between threads:
+* - the elements are constructed in place in a preallocated ring, so there is
+*   no allocation per message
+* - head and tail are in separate cache lines, so producers and consumers don't
+*   invalidate each other's cache line on every operation
+* - SpscRing: one producer and one consumer thread; each side caches the other
+*   side's index and only rereads it when the ring seems full/empty, batch operations
+*   publish all elements with one store
+* - MpmcRing: any number of producers and consumers (Dmitry Vyukov's bounded queue:
+*   every slot has a sequence number telling whether it can be written or read)
+* - try_push()/try_pop() never block; push()/pop() spin briefly and then sleep until
+*   the other side signals (the mutex is only used if a thread actually sleeps)
+* The capacity is rounded up to a power of two.
+********************************************/
+
+namespace ring_detail {
+
+inline constexpr std::size_t cacheLineSize = 64;
+
+inline std::size_t roundUpPow2(std::size_t n)
+{
+    if(n < 2)
+    {
+        return 2;
+    }
+    std::size_t p{1};
+    while(p < n)
+    {
+        p <<= 1;
+    }
+    return p;
+}
+
+inline void cpuRelax() noexcept
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+// blocking wait without a mutex on the fast path:
+// waiters register in m_waiters before sleeping, notify() only locks if someone sleeps
+class Waiter
+{
+public:
+    template<typename Pred>
+    void wait(Pred ready)
+    {
+        for(int i{0}; i < 64; ++i)
+        {
+            if(ready())
+            {
+                return;
+            }
+            cpuRelax();
+        }
+        for(int i{0}; i < 4; ++i)
+        {
+            if(ready())
+            {
+                return;
+            }
+            std::this_thread::yield();
+        }
+        std::unique_lock lock{m_mutex};
+        m_waiters.fetch_add(1, std::memory_order_seq_cst);
+        m_cv.wait(lock, ready);
+        m_waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // call after the state change that makes ready() true:
+    void notify()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(m_waiters.load(std::memory_order_relaxed) > 0)
+        {
+            std::lock_guard lock{m_mutex};
+            m_cv.notify_all();
+        }
+    }
+
+private:
+    std::atomic<int> m_waiters{0};
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+};
+
+template<typename T>
+struct alignas(alignof(T)) Storage {
+    unsigned char bytes[sizeof(T)];
+
+    T* ptr() noexcept { return std::launder(reinterpret_cast<T*>(bytes)); }
+};
+
+}  // namespace ring_detail
+
+template<typename T>
+class SpscRing
+{
+    static constexpr std::size_t cacheLine = ring_detail::cacheLineSize;
+
+public:
+    explicit SpscRing(std::size_t capacity)
+        : m_mask{ring_detail::roundUpPow2(capacity) - 1}
+        , m_slots{std::make_unique<ring_detail::Storage<T>[]>(m_mask + 1)}
+    {
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    ~SpscRing()
+    {
+        for(auto pos = m_head.load(std::memory_order_relaxed); pos != m_tail.load(std::memory_order_relaxed); ++pos)
+        {
+            m_slots[pos & m_mask].ptr()->~T();
+        }
+    }
+
+    std::size_t capacity() const noexcept { return m_mask + 1; }
+
+    // producer side:
+
+    template<typename... Args>
+    bool try_emplace(Args&&... args)
+    {
+        auto tail = m_tail.load(std::memory_order_relaxed);
+        if(tail - m_cachedHead > m_mask)
+        {
+            m_cachedHead = m_head.load(std::memory_order_acquire);
+            if(tail - m_cachedHead > m_mask)
+            {
+                return false;
+            }
+        }
+        ::new(m_slots[tail & m_mask].bytes) T(std::forward<Args>(args)...);
+        m_tail.store(tail + 1, std::memory_order_release);
+        m_notEmpty.notify();
+        return true;
+    }
+
+    bool try_push(const T& val) { return try_emplace(val); }
+    bool try_push(T&& val) { return try_emplace(std::move(val)); }
+
+    // pushes up to n elements of [first, first+n), returns the number of elements pushed:
+    template<typename It>
+    std::size_t try_push_batch(It first, std::size_t n)
+    {
+        auto tail = m_tail.load(std::memory_order_relaxed);
+        if(capacity() - (tail - m_cachedHead) < n)
+        {
+            m_cachedHead = m_head.load(std::memory_order_acquire);
+        }
+        std::size_t count = std::min(n, capacity() - (tail - m_cachedHead));
+        for(std::size_t i{0}; i < count; ++i, ++first)
+        {
+            ::new(m_slots[(tail + i) & m_mask].bytes) T(*first);
+        }
+        if(count > 0)
+        {
+            m_tail.store(tail + count, std::memory_order_release);
+            m_notEmpty.notify();
+        }
+        return count;
+    }
+
+    // blocks while the ring is full:
+    void push(T val)
+    {
+        while(!try_push(std::move(val)))
+        {
+            m_notFull.wait([&] { return m_tail.load(std::memory_order_relaxed) - m_head.load(std::memory_order_acquire) <= m_mask; });
+        }
+    }
+
+    // consumer side:
+
+    bool try_pop(T& out)
+    {
+        auto head = m_head.load(std::memory_order_relaxed);
+        if(head == m_cachedTail)
+        {
+            m_cachedTail = m_tail.load(std::memory_order_acquire);
+            if(head == m_cachedTail)
+            {
+                return false;
+            }
+        }
+        T* p = m_slots[head & m_mask].ptr();
+        out = std::move(*p);
+        p->~T();
+        m_head.store(head + 1, std::memory_order_release);
+        m_notFull.notify();
+        return true;
+    }
+
+    std::optional<T> try_pop()
+    {
+        std::optional<T> result;
+        auto head = m_head.load(std::memory_order_relaxed);
+        if(head == m_cachedTail)
+        {
+            m_cachedTail = m_tail.load(std::memory_order_acquire);
+            if(head == m_cachedTail)
+            {
+                return result;
+            }
+        }
+        T* p = m_slots[head & m_mask].ptr();
+        result.emplace(std::move(*p));
+        p->~T();
+        m_head.store(head + 1, std::memory_order_release);
+        m_notFull.notify();
+        return result;
+    }
+
+    // moves up to maxCount elements to out, returns the number of elements popped:
+    template<typename OutIt>
+    std::size_t try_pop_batch(OutIt out, std::size_t maxCount)
+    {
+        auto head = m_head.load(std::memory_order_relaxed);
+        if(m_cachedTail - head < maxCount)
+        {
+            m_cachedTail = m_tail.load(std::memory_order_acquire);
+        }
+        std::size_t count = std::min(maxCount, m_cachedTail - head);
+        for(std::size_t i{0}; i < count; ++i, ++out)
+        {
+            T* p = m_slots[(head + i) & m_mask].ptr();
+            *out = std::move(*p);
+            p->~T();
+        }
+        if(count > 0)
+        {
+            m_head.store(head + count, std::memory_order_release);
+            m_notFull.notify();
+        }
+        return count;
+    }
+
+    // blocks while the ring is empty:
+    T pop()
+    {
+        for(;;)
+        {
+            if(auto val = try_pop(); val)
+            {
+                return std::move(*val);
+            }
+            m_notEmpty.wait([&] { return m_tail.load(std::memory_order_acquire) != m_head.load(std::memory_order_relaxed); });
+        }
+    }
+
+    // blocks until at least one element is available:
+    template<typename OutIt>
+    std::size_t pop_batch(OutIt out, std::size_t maxCount)
+    {
+        for(;;)
+        {
+            if(auto count = try_pop_batch(out, maxCount); count > 0)
+            {
+                return count;
+            }
+            m_notEmpty.wait([&] { return m_tail.load(std::memory_order_acquire) != m_head.load(std::memory_order_relaxed); });
+        }
+    }
+
+private:
+    // written by the producer:
+    alignas(cacheLine) std::atomic<std::size_t> m_tail{0};
+    std::size_t m_cachedHead{0};
+    // written by the consumer:
+    alignas(cacheLine) std::atomic<std::size_t> m_head{0};
+    std::size_t m_cachedTail{0};
+    // read-only after construction:
+    alignas(cacheLine) const std::size_t m_mask;
+    std::unique_ptr<ring_detail::Storage<T>[]> m_slots;
+    ring_detail::Waiter m_notEmpty;
+    ring_detail::Waiter m_notFull;
+};
+
+template<typename T>
+class MpmcRing
+{
+    static constexpr std::size_t cacheLine = ring_detail::cacheLineSize;
+
+    // seq == pos: free for the producer of pos, seq == pos + 1: filled for the consumer of pos
+    struct Slot {
+        std::atomic<std::size_t> seq;
+        ring_detail::Storage<T> storage;
+    };
+
+public:
+    explicit MpmcRing(std::size_t capacity)
+        : m_mask{ring_detail::roundUpPow2(capacity) - 1}
+        , m_slots{std::make_unique<Slot[]>(m_mask + 1)}
+    {
+        for(std::size_t i{0}; i <= m_mask; ++i)
+        {
+            m_slots[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpmcRing(const MpmcRing&) = delete;
+    MpmcRing& operator=(const MpmcRing&) = delete;
+
+    ~MpmcRing()
+    {
+        for(auto pos = m_dequeuePos.load(std::memory_order_relaxed); pos != m_enqueuePos.load(std::memory_order_relaxed); ++pos)
+        {
+            m_slots[pos & m_mask].storage.ptr()->~T();
+        }
+    }
+
+    std::size_t capacity() const noexcept { return m_mask + 1; }
+
+    template<typename... Args>
+    bool try_emplace(Args&&... args)
+    {
+        auto pos = m_enqueuePos.load(std::memory_order_relaxed);
+        for(;;)
+        {
+            Slot& slot = m_slots[pos & m_mask];
+            auto seq = slot.seq.load(std::memory_order_acquire);
+            auto dif = static_cast<std::ptrdiff_t>(seq - pos);
+            if(dif == 0)
+            {
+                if(m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    ::new(slot.storage.bytes) T(std::forward<Args>(args)...);
+                    slot.seq.store(pos + 1, std::memory_order_release);
+                    m_notEmpty.notify();
+                    return true;
+                }
+            }
+            else if(dif < 0)
+            {
+                return false;  // full
+            }
+            else
+            {
+                pos = m_enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool try_push(const T& val) { return try_emplace(val); }
+    bool try_push(T&& val) { return try_emplace(std::move(val)); }
+
+    bool try_pop(T& out)
+    {
+        return consume([&](T&& val) { out = std::move(val); });
+    }
+
+    std::optional<T> try_pop()
+    {
+        std::optional<T> result;
+        consume([&](T&& val) { result.emplace(std::move(val)); });
+        return result;
+    }
+
+    // batches are sequences of single operations here: consumers may finish slots
+    // out of order, so a range of slots can't be claimed with one index update
+    template<typename It>
+    std::size_t try_push_batch(It first, std::size_t n)
+    {
+        std::size_t count{0};
+        for(; count < n && try_push(*first); ++count, ++first)
+        {
+        }
+        return count;
+    }
+
+    template<typename OutIt>
+    std::size_t try_pop_batch(OutIt out, std::size_t maxCount)
+    {
+        std::size_t count{0};
+        while(count < maxCount && consume([&](T&& val) { *out = std::move(val); ++out; }))
+        {
+            ++count;
+        }
+        return count;
+    }
+
+    // blocks while the ring is full:
+    void push(T val)
+    {
+        while(!try_push(std::move(val)))
+        {
+            m_notFull.wait([&] { return !full(); });
+        }
+    }
+
+    // blocks while the ring is empty:
+    T pop()
+    {
+        for(;;)
+        {
+            if(auto val = try_pop(); val)
+            {
+                return std::move(*val);
+            }
+            m_notEmpty.wait([&] { return !empty(); });
+        }
+    }
+
+    template<typename OutIt>
+    std::size_t pop_batch(OutIt out, std::size_t maxCount)
+    {
+        for(;;)
+        {
+            if(auto count = try_pop_batch(out, maxCount); count > 0)
+            {
+                return count;
+            }
+            m_notEmpty.wait([&] { return !empty(); });
+        }
+    }
+
+private:
+    // claims the next filled slot and passes its element to f:
+    template<typename F>
+    bool consume(F&& f)
+    {
+        auto pos = m_dequeuePos.load(std::memory_order_relaxed);
+        for(;;)
+        {
+            Slot& slot = m_slots[pos & m_mask];
+            auto seq = slot.seq.load(std::memory_order_acquire);
+            auto dif = static_cast<std::ptrdiff_t>(seq - (pos + 1));
+            if(dif == 0)
+            {
+                if(m_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    T* p = slot.storage.ptr();
+                    f(std::move(*p));
+                    p->~T();
+                    slot.seq.store(pos + m_mask + 1, std::memory_order_release);
+                    m_notFull.notify();
+                    return true;
+                }
+            }
+            else if(dif < 0)
+            {
+                return false;  // empty
+            }
+            else
+            {
+                pos = m_dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool empty() const noexcept
+    {
+        auto pos = m_dequeuePos.load(std::memory_order_relaxed);
+        return m_slots[pos & m_mask].seq.load(std::memory_order_acquire) != pos + 1;
+    }
+
+    bool full() const noexcept
+    {
+        auto pos = m_enqueuePos.load(std::memory_order_relaxed);
+        return m_slots[pos & m_mask].seq.load(std::memory_order_acquire) != pos;
+    }
+
+    alignas(cacheLine) std::atomic<std::size_t> m_enqueuePos{0};
+    alignas(cacheLine) std::atomic<std::size_t> m_dequeuePos{0};
+    alignas(cacheLine) const std::size_t m_mask;
+    std::unique_ptr<Slot[]> m_slots;
+    ring_detail::Waiter m_notEmpty;
+    ring_detail::Waiter m_notFull;
+};
@@ -0,0 +1,275 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/********************************************
+* VariantVector<Ts...>
+* inhomogeneous collection as an alternative to std::vector<std::variant<Ts...>>:
+* - one contiguous std::vector per alternative, so elements don't pay for the
+*   size of the largest alternative and for_each_of<T>() is a plain loop over
+*   a vector<T>, which the compiler can vectorize
+* - an order index, so that for_each() still visits in insertion order
+* - stable handles: erase() moves the last element of a column into the gap,
+*   handles are updated through an indirection table and carry a generation,
+*   so stale handles are detected
+********************************************/
+
+template<typename... Ts>
+class VariantVector
+{
+    static_assert(sizeof...(Ts) > 0 && sizeof...(Ts) < 256, "VariantVector: 1..255 alternatives");
+
+    template<typename T, std::size_t I, typename... Us>
+    struct IndexOfImpl : std::integral_constant<std::size_t, I> {};
+    template<typename T, std::size_t I, typename U, typename... Us>
+    struct IndexOfImpl<T, I, U, Us...> : std::conditional_t<std::is_same_v<T, U>, std::integral_constant<std::size_t, I>, IndexOfImpl<T, I + 1, Us...>> {};
+
+public:
+    // index of alternative T:
+    template<typename T>
+    static constexpr std::size_t indexOf = IndexOfImpl<T, 0, Ts...>::value;
+
+    struct Handle {
+        std::uint32_t id{~0u};
+        std::uint32_t generation{0};
+        friend bool operator==(Handle lhs, Handle rhs) noexcept { return lhs.id == rhs.id && lhs.generation == rhs.generation; }
+        friend bool operator!=(Handle lhs, Handle rhs) noexcept { return !(lhs == rhs); }
+    };
+
+    template<typename T, typename... Args>
+    Handle emplace_back(Args&&... args)
+    {
+        constexpr std::size_t type = indexOf<T>;
+        static_assert(type < sizeof...(Ts), "VariantVector: T is not an alternative");
+        auto& col = std::get<type>(m_columns);
+        col.emplace_back(std::forward<Args>(args)...);
+
+        std::uint32_t id;
+        if(!m_freeIds.empty())
+        {
+            id = m_freeIds.back();
+            m_freeIds.pop_back();
+        }
+        else
+        {
+            id = static_cast<std::uint32_t>(m_entries.size());
+            m_entries.push_back(Entry{ 0, m_generationFloor });
+        }
+        auto& e = m_entries[id];
+        e.type = static_cast<std::uint8_t>(type);
+        e.alive = true;
+        e.slot = static_cast<std::uint32_t>(col.size() - 1);
+        m_owners[type].push_back(id);
+        m_order.push_back(id);
+        ++m_size;
+        return Handle{ id, e.generation };
+    }
+
+    template<typename T>
+    Handle push_back(T&& val)
+    {
+        return emplace_back<std::decay_t<T>>(std::forward<T>(val));
+    }
+
+    bool contains(Handle h) const noexcept
+    {
+        return h.id < m_entries.size() && m_entries[h.id].alive && m_entries[h.id].generation == h.generation;
+    }
+
+    template<typename T>
+    T* get_if(Handle h) noexcept
+    {
+        if(!contains(h) || m_entries[h.id].type != indexOf<T>)
+        {
+            return nullptr;
+        }
+        return &std::get<indexOf<T>>(m_columns)[m_entries[h.id].slot];
+    }
+
+    template<typename T>
+    T& get(Handle h)
+    {
+        if(auto p = get_if<T>(h); p)
+        {
+            return *p;
+        }
+        throw std::out_of_range{"VariantVector: invalid handle or wrong alternative"};
+    }
+
+    // index of the alternative the handle refers to:
+    std::size_t index(Handle h) const
+    {
+        if(!contains(h))
+        {
+            throw std::out_of_range{"VariantVector: invalid handle"};
+        }
+        return m_entries[h.id].type;
+    }
+
+    bool erase(Handle h)
+    {
+        if(!contains(h))
+        {
+            return false;
+        }
+        auto& e = m_entries[h.id];
+        eraseFromColumn(e.type, e.slot, std::index_sequence_for<Ts...>{});
+        e.alive = false;
+        ++e.generation;
+        --m_size;
+        // ids are reused only after they were removed from the order index:
+        if(++m_deadInOrder > m_order.size() / 2)
+        {
+            compactOrder();
+        }
+        return true;
+    }
+
+    std::size_t size() const noexcept { return m_size; }
+    bool empty() const noexcept { return m_size == 0; }
+
+    template<typename T>
+    std::size_t size_of() const noexcept { return std::get<indexOf<T>>(m_columns).size(); }
+
+    // all elements of alternative T, contiguous:
+    template<typename T>
+    std::vector<T>& column() noexcept { return std::get<indexOf<T>>(m_columns); }
+    template<typename T>
+    const std::vector<T>& column() const noexcept { return std::get<indexOf<T>>(m_columns); }
+
+    // batch pass over all elements of alternative T (column order, not insertion order):
+    template<typename T, typename F>
+    void for_each_of(F&& f)
+    {
+        for(auto& elem : column<T>())
+        {
+            f(elem);
+        }
+    }
+
+    // visit all elements in insertion order, f has to accept every alternative:
+    template<typename F>
+    void for_each(F&& f)
+    {
+        for(auto id : m_order)
+        {
+            const auto& e = m_entries[id];
+            if(e.alive)
+            {
+                visitAt(f, e.type, e.slot, std::index_sequence_for<Ts...>{});
+            }
+        }
+    }
+
+    void reserve(std::size_t n)
+    {
+        m_order.reserve(n);
+        m_entries.reserve(n);
+    }
+
+    void clear() noexcept
+    {
+        std::apply([](auto&... cols) { (cols.clear(), ...); }, m_columns);
+        for(auto& owners : m_owners)
+        {
+            owners.clear();
+        }
+        // new entries start above every generation handed out so far, so that handles
+        // taken before clear() stay invalid when their ids are reused:
+        for(const auto& e : m_entries)
+        {
+            if(e.generation >= m_generationFloor)
+            {
+                m_generationFloor = e.generation + 1;
+            }
+        }
+        m_entries.clear();
+        m_freeIds.clear();
+        m_order.clear();
+        m_deadInOrder = 0;
+        m_size = 0;
+    }
+
+    // bytes allocated by the container (not counting heap memory owned by the elements):
+    std::size_t memoryUsage() const noexcept
+    {
+        std::size_t bytes{0};
+        std::apply([&](const auto&... cols) { ((bytes += cols.capacity() * sizeof(typename std::decay_t<decltype(cols)>::value_type)), ...); }, m_columns);
+        for(const auto& owners : m_owners)
+        {
+            bytes += owners.capacity() * sizeof(std::uint32_t);
+        }
+        bytes += m_entries.capacity() * sizeof(Entry) + m_freeIds.capacity() * sizeof(std::uint32_t) + m_order.capacity() * sizeof(std::uint32_t);
+        return bytes;
+    }
+
+private:
+    struct Entry {
+        std::uint32_t slot{0};
+        std::uint32_t generation{0};
+        std::uint8_t type{0};
+        bool alive{false};
+    };
+
+    template<typename F, std::size_t... Is>
+    void visitAt(F& f, std::size_t type, std::uint32_t slot, std::index_sequence<Is...>)
+    {
+        ((type == Is ? (f(std::get<Is>(m_columns)[slot]), true) : false) || ...);
+    }
+
+    template<std::size_t... Is>
+    void eraseFromColumn(std::size_t type, std::uint32_t slot, std::index_sequence<Is...>)
+    {
+        ((type == Is ? (eraseFromColumn<Is>(slot), true) : false) || ...);
+    }
+
+    template<std::size_t I>
+    void eraseFromColumn(std::uint32_t slot)
+    {
+        auto& col = std::get<I>(m_columns);
+        auto& owners = m_owners[I];
+        auto last = static_cast<std::uint32_t>(col.size() - 1);
+        if(slot != last)
+        {
+            col[slot] = std::move(col[last]);
+            owners[slot] = owners[last];
+            m_entries[owners[slot]].slot = slot;
+        }
+        col.pop_back();
+        owners.pop_back();
+    }
+
+    void compactOrder()
+    {
+        std::size_t out{0};
+        for(auto id : m_order)
+        {
+            if(m_entries[id].alive)
+            {
+                m_order[out++] = id;
+            }
+            else
+            {
+                m_freeIds.push_back(id);
+            }
+        }
+        m_order.resize(out);
+        m_deadInOrder = 0;
+    }
+
+    std::tuple<std::vector<Ts>...> m_columns;
+    std::array<std::vector<std::uint32_t>, sizeof...(Ts)> m_owners;  // slot -> handle id, per column
+    std::vector<Entry> m_entries;                                      // handle id -> column and slot
+    std::vector<std::uint32_t> m_freeIds;
+    std::vector<std::uint32_t> m_order;                                // handle ids in insertion order
+    std::size_t m_deadInOrder{0};
+    std::size_t m_size{0};
+    std::uint32_t m_generationFloor{0};                                // generation of new entries, only grows
+};
@@ -5,6 +5,12 @@
 #include <complex>
 #include <set>
 #include <utility>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include "small_any.h"
+#include "poly_vector.h"
 
 /*
     std::any is a value type that is able to change its type, while still having type safety. That is,
@@ -69,6 +75,244 @@ void accessValue()
 
 }
 
+// count all heap allocations of the program for the benchmarks:
+static std::atomic<std::size_t> numAllocations{0};
+
+void* operator new(std::size_t size)
+{
+    numAllocations.fetch_add(1, std::memory_order_relaxed);
+    if(void* p = std::malloc(size == 0 ? 1 : size); p) {
+        return p;
+    }
+    throw std::bad_alloc{};
+}
+
+void* operator new(std::size_t size, std::align_val_t align)
+{
+    numAllocations.fetch_add(1, std::memory_order_relaxed);
+    auto a = static_cast<std::size_t>(align);
+    if(void* p = std::aligned_alloc(a, (size + a - 1) / a * a); p) {
+        return p;
+    }
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+template<typename T>
+double diff(const T& t0, const T& t1)
+{
+    return std::chrono::duration<double, std::milli>(t1 - t0).count();
+}
+
+struct Point3 {
+    double x, y, z;
+};
+
+// fixed IDs, so that dispatching on SmallAny::typeId() can be a switch:
+SMALL_ANY_TYPE_ID(int, 1)
+SMALL_ANY_TYPE_ID(double, 2)
+SMALL_ANY_TYPE_ID(std::string, 3)
+SMALL_ANY_TYPE_ID(Point3, 4)
+
+void smallAnyPerformance()
+{
+    /*
+    libstdc++ stores only values up to the size of a pointer inside a std::any, so a
+    std::string or a struct of three doubles is allocated on the heap, and dispatching
+    on the type compares std::type_info objects. SmallAny<32> (see small_any.h) stores
+    all of them inline and has integer type IDs, so dispatch is a switch.
+    The price is the element size (48 instead of 16 bytes), so building and copying
+    touch three times the memory in exchange for not allocating.
+    */
+    const std::size_t numElems{10'000'000};
+    using Any = SmallAny<32>;
+
+    auto weight = [](std::size_t i) { return static_cast<int>(i % 4); };
+
+    auto a0 = numAllocations.load();
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<std::any> coll1;
+    coll1.reserve(numElems);
+    for(std::size_t i{0}; i < numElems; ++i)
+    {
+        switch(weight(i))
+        {
+            case 0: coll1.emplace_back(static_cast<int>(i)); break;
+            case 1: coll1.emplace_back(static_cast<double>(i)); break;
+            case 2: coll1.emplace_back(std::string(i % 15, 'x')); break;
+            default: coll1.emplace_back(Point3{ 1.0, 2.0, static_cast<double>(i) }); break;
+        }
+    }
+    auto a1 = numAllocations.load();
+    auto t1 = std::chrono::steady_clock::now();
+    std::vector<Any> coll2;
+    coll2.reserve(numElems);
+    for(std::size_t i{0}; i < numElems; ++i)
+    {
+        switch(weight(i))
+        {
+            case 0: coll2.emplace_back(static_cast<int>(i)); break;
+            case 1: coll2.emplace_back(static_cast<double>(i)); break;
+            case 2: coll2.emplace_back(std::string(i % 15, 'x')); break;
+            default: coll2.emplace_back(Point3{ 1.0, 2.0, static_cast<double>(i) }); break;
+        }
+    }
+    auto a2 = numAllocations.load();
+    auto t2 = std::chrono::steady_clock::now();
+    std::cout << "build:    vector<any>: " << diff(t0, t1) << "ms, " << a1 - a0 << " allocations; "
+              << "vector<SmallAny>: " << diff(t1, t2) << "ms, " << a2 - a1 << " allocations\n";
+
+    for(int i{0}; i < 5; ++i)
+    {
+        double sum1{0}, sum2{0};
+        auto t0 = std::chrono::steady_clock::now();
+        for(const auto& e : coll1)
+        {
+            if(e.type() == typeid(int)) {
+                sum1 += std::any_cast<int>(e);
+            }
+            else if(e.type() == typeid(double)) {
+                sum1 += std::any_cast<double>(e);
+            }
+            else if(e.type() == typeid(std::string)) {
+                sum1 += std::any_cast<const std::string&>(e).size();
+            }
+            else if(e.type() == typeid(Point3)) {
+                sum1 += std::any_cast<const Point3&>(e).z;
+            }
+        }
+        auto t1 = std::chrono::steady_clock::now();
+        for(const auto& e : coll2)
+        {
+            switch(e.typeId())
+            {
+                case AnyTypeId<int>::value: sum2 += *e.ptr<int>(); break;
+                case AnyTypeId<double>::value: sum2 += *e.ptr<double>(); break;
+                case AnyTypeId<std::string>::value: sum2 += e.ptr<std::string>()->size(); break;
+                case AnyTypeId<Point3>::value: sum2 += e.ptr<Point3>()->z; break;
+            }
+        }
+        auto t2 = std::chrono::steady_clock::now();
+        std::cout << "dispatch: vector<any>: " << diff(t0, t1) << "ms, vector<SmallAny>: " << diff(t1, t2) << "ms"
+                  << (sum1 != sum2 ? " ERROR: different results" : "") << '\n';
+    }
+
+    auto a3 = numAllocations.load();
+    auto t3 = std::chrono::steady_clock::now();
+    auto copy1 = coll1;
+    auto a4 = numAllocations.load();
+    auto t4 = std::chrono::steady_clock::now();
+    auto copy2 = coll2;
+    auto a5 = numAllocations.load();
+    auto t5 = std::chrono::steady_clock::now();
+    std::cout << "copy:     vector<any>: " << diff(t3, t4) << "ms, " << a4 - a3 << " allocations; "
+              << "vector<SmallAny>: " << diff(t4, t5) << "ms, " << a5 - a4 << " allocations\n";
+}
+
+struct Test {
+    int a = 123;
+};
+
+void polyVectorPerformance()
+{
+    /*
+    Each element of a std::vector<std::any> that doesn't fit into the any itself
+    (here the strings and a struct of three doubles) is a separate heap allocation.
+    PolyVector (see poly_vector.h) places all objects back to back in one arena.
+    */
+    const std::size_t numElems{10'000'000};
+
+    for(int i{0}; i < 3; ++i)
+    {
+        long sum1{0}, sum2{0};
+        auto a0 = numAllocations.load();
+        auto t0 = std::chrono::steady_clock::now();
+        std::vector<std::any> vec1;
+        vec1.reserve(numElems);
+        for(std::size_t i{0}; i < numElems; ++i)
+        {
+            switch(i % 4)
+            {
+                case 0: vec1.push_back(static_cast<int>(i)); break;
+                case 1: vec1.push_back(std::string(i % 15, 'x')); break;
+                case 2: vec1.push_back(Test{}); break;
+                default: vec1.push_back(Point3{ 1.0, 2.0, 3.0 }); break;
+            }
+        }
+        auto a1 = numAllocations.load();
+        auto t1 = std::chrono::steady_clock::now();
+        for(const auto& e : vec1)
+        {
+            if(e.type() == typeid(int)) {
+                sum1 += std::any_cast<int>(e);
+            }
+            else if(e.type() == typeid(std::string)) {
+                sum1 += std::any_cast<const std::string&>(e).size();
+            }
+            else if(e.type() == typeid(Test)) {
+                sum1 += std::any_cast<const Test&>(e).a;
+            }
+            else if(e.type() == typeid(Point3)) {
+                sum1 += static_cast<long>(std::any_cast<const Point3&>(e).z);
+            }
+        }
+        auto t2 = std::chrono::steady_clock::now();
+        PolyVector vec2;
+        vec2.reserve(numElems * 32);
+        for(std::size_t i{0}; i < numElems; ++i)
+        {
+            switch(i % 4)
+            {
+                case 0: vec2.push_back(static_cast<int>(i)); break;
+                case 1: vec2.push_back(std::string(i % 15, 'x')); break;
+                case 2: vec2.push_back(Test{}); break;
+                default: vec2.push_back(Point3{ 1.0, 2.0, 3.0 }); break;
+            }
+        }
+        auto a3 = numAllocations.load();
+        auto t3 = std::chrono::steady_clock::now();
+        vec2.visit<int, std::string, Test, Point3>([&](const auto& e) {
+            using T = std::decay_t<decltype(e)>;
+            if constexpr(std::is_same_v<T, int>) {
+                sum2 += e;
+            }
+            else if constexpr(std::is_same_v<T, std::string>) {
+                sum2 += e.size();
+            }
+            else if constexpr(std::is_same_v<T, Test>) {
+                sum2 += e.a;
+            }
+            else {
+                sum2 += static_cast<long>(e.z);
+            }
+        });
+        auto t4 = std::chrono::steady_clock::now();
+        std::cout << "build:   vector<any>: " << diff(t0, t1) << "ms, " << a1 - a0 << " allocations; "
+                  << "PolyVector: " << diff(t2, t3) << "ms, " << a3 - a1 << " allocations\n";
+        std::cout << "iterate: vector<any>: " << diff(t1, t2) << "ms, PolyVector: " << diff(t3, t4) << "ms"
+                  << (sum1 != sum2 ? " ERROR: different results" : "") << '\n';
+    }
+}
+
 int main()
 {
     // Using std::any
@@ -172,6 +416,8 @@ int main()
 
     accessValue();
 
+    // smallAnyPerformance();
+    // polyVectorPerformance();
 
     return 0;
 }  
@@ -0,0 +1,337 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/********************************************
+* PolyVector
+* inhomogeneous container as an alternative to std::vector<std::any>:
+* - objects of arbitrary types are placed back to back in one aligned arena,
+*   each preceded by an 8-byte header pointing to a type descriptor (size, alignment,
+*   destroy and relocate functions), so there is no heap allocation per element and
+*   iteration runs linearly through memory
+* - typed iteration (for_each<T>()) and visitation of a list of types (visit<Ts...>())
+*   compare descriptor addresses, no RTTI is needed
+* - move-only types are supported; elements must be nothrow move constructible,
+*   because they are relocated when the arena grows or gets compacted
+* - erase_if() only destroys the elements, compact() closes the gaps
+* - the whole arena is released with one deallocation
+********************************************/
+
+namespace poly_vector_detail {
+
+struct alignas(8) TypeInfo {
+    std::size_t size;
+    std::size_t align;
+    void (*destroy)(void*) noexcept;                  // nullptr for trivially destructible types
+    void (*relocate)(void* dst, void* src) noexcept;  // move construct into dst and destroy src
+};
+
+template<typename T>
+void destroy(void* p) noexcept
+{
+    std::launder(static_cast<T*>(p))->~T();
+}
+
+template<typename T>
+void relocate(void* dst, void* src) noexcept
+{
+    if constexpr(std::is_trivially_copyable_v<T>) {
+        std::memcpy(dst, src, sizeof(T));
+    }
+    else {
+        T* s = std::launder(static_cast<T*>(src));
+        ::new(dst) T(std::move(*s));
+        s->~T();
+    }
+}
+
+// one descriptor per type, its address identifies the type:
+template<typename T>
+inline constexpr TypeInfo typeInfo{ sizeof(T), alignof(T), std::is_trivially_destructible_v<T> ? nullptr : &destroy<T>, &relocate<T> };
+
+}  // namespace poly_vector_detail
+
+class PolyVector
+{
+    using TypeInfo = poly_vector_detail::TypeInfo;
+
+    // descriptor address, the lowest bit marks erased elements:
+    struct Header {
+        std::uintptr_t bits;
+
+        const TypeInfo* type() const noexcept { return reinterpret_cast<const TypeInfo*>(bits & ~std::uintptr_t{1}); }
+        bool alive() const noexcept { return (bits & 1) == 0; }
+    };
+
+public:
+    static constexpr std::size_t arenaAlign = 64;
+
+    // view of one element, as passed by for_each() and erase_if():
+    class Ref
+    {
+    public:
+        template<typename T>
+        bool holds() const noexcept { return m_type == &poly_vector_detail::typeInfo<T>; }
+
+        // nullptr if the element is not a T:
+        template<typename T>
+        T* get_if() const noexcept { return holds<T>() ? std::launder(static_cast<T*>(m_obj)) : nullptr; }
+
+        void* data() const noexcept { return m_obj; }
+
+    private:
+        friend class PolyVector;
+        Ref(const TypeInfo* type, void* obj) noexcept : m_type{type}, m_obj{obj} {}
+        const TypeInfo* m_type;
+        void* m_obj;
+    };
+
+    PolyVector() noexcept = default;
+
+    PolyVector(const PolyVector&) = delete;
+    PolyVector& operator=(const PolyVector&) = delete;
+
+    PolyVector(PolyVector&& other) noexcept
+        : m_arena{std::exchange(other.m_arena, nullptr)}
+        , m_capacity{std::exchange(other.m_capacity, 0)}
+        , m_used{std::exchange(other.m_used, 0)}
+        , m_size{std::exchange(other.m_size, 0)}
+        , m_dead{std::exchange(other.m_dead, 0)}
+    {
+    }
+
+    PolyVector& operator=(PolyVector&& other) noexcept
+    {
+        if(this != &other)
+        {
+            release();
+            m_arena = std::exchange(other.m_arena, nullptr);
+            m_capacity = std::exchange(other.m_capacity, 0);
+            m_used = std::exchange(other.m_used, 0);
+            m_size = std::exchange(other.m_size, 0);
+            m_dead = std::exchange(other.m_dead, 0);
+        }
+        return *this;
+    }
+
+    ~PolyVector() { release(); }
+
+    template<typename T, typename... Args>
+    T& emplace_back(Args&&... args)
+    {
+        static_assert(std::is_nothrow_move_constructible_v<T>, "PolyVector: elements have to be nothrow move constructible");
+        static_assert(alignof(T) <= arenaAlign, "PolyVector: alignment too large");
+
+        constexpr const TypeInfo& type = poly_vector_detail::typeInfo<T>;
+        if(m_used + entrySize(m_used, type) > m_capacity)
+        {
+            grow(m_used + entrySize(m_used, type));
+        }
+        // growing drops erased elements, so the position is determined afterwards:
+        T* obj = ::new(m_arena + objectPos(m_used, alignof(T))) T(std::forward<Args>(args)...);
+        ::new(m_arena + m_used) Header{ reinterpret_cast<std::uintptr_t>(&type) };
+        m_used += entrySize(m_used, type);
+        ++m_size;
+        return *obj;
+    }
+
+    template<typename T>
+    T& push_back(T&& val)
+    {
+        return emplace_back<std::decay_t<T>>(std::forward<T>(val));
+    }
+
+    std::size_t size() const noexcept { return m_size; }
+    bool empty() const noexcept { return m_size == 0; }
+
+    // all live elements in insertion order:
+    template<typename F>
+    void for_each(F&& f)
+    {
+        forEachEntry([&](std::size_t pos, Header& h) {
+            if(h.alive())
+            {
+                f(Ref{ h.type(), m_arena + objectPos(pos, h.type()->align) });
+            }
+        });
+    }
+
+    // all elements of type T in insertion order:
+    template<typename T, typename F>
+    void for_each(F&& f)
+    {
+        forEachEntry([&](std::size_t pos, Header& h) {
+            if(h.bits == reinterpret_cast<std::uintptr_t>(&poly_vector_detail::typeInfo<T>))
+            {
+                f(*std::launder(reinterpret_cast<T*>(m_arena + objectPos(pos, alignof(T)))));
+            }
+        });
+    }
+
+    // f is called with each element of one of the types Ts, other elements are skipped:
+    template<typename... Ts, typename F>
+    void visit(F&& f)
+    {
+        forEachEntry([&](std::size_t pos, Header& h) {
+            ((h.bits == reinterpret_cast<std::uintptr_t>(&poly_vector_detail::typeInfo<Ts>)
+                  ? (f(*std::launder(reinterpret_cast<Ts*>(m_arena + objectPos(pos, alignof(Ts))))), true)
+                  : false)
+             || ...);
+        });
+    }
+
+    // erase all elements for which pred(Ref) yields true, the memory is reused by compact():
+    template<typename Pred>
+    std::size_t erase_if(Pred&& pred)
+    {
+        std::size_t count{0};
+        forEachEntry([&](std::size_t pos, Header& h) {
+            if(h.alive())
+            {
+                auto* type = h.type();
+                void* obj = m_arena + objectPos(pos, type->align);
+                if(pred(Ref{ type, obj }))
+                {
+                    if(type->destroy)
+                    {
+                        type->destroy(obj);
+                    }
+                    h.bits |= 1;
+                    ++count;
+                }
+            }
+        });
+        m_size -= count;
+        m_dead += count;
+        return count;
+    }
+
+    // move the live elements into a new arena without the gaps of erased elements:
+    void compact()
+    {
+        if(m_dead == 0)
+        {
+            return;
+        }
+        std::size_t bytes{0};
+        forEachEntry([&](std::size_t, Header& h) {
+            if(h.alive())
+            {
+                bytes += entrySize(bytes, *h.type());
+            }
+        });
+        reallocate(bytes == 0 ? arenaAlign : bytes);
+    }
+
+    void reserve(std::size_t bytes)
+    {
+        if(bytes > m_capacity)
+        {
+            reallocate(bytes);
+        }
+    }
+
+    // destroys all elements, keeps the arena:
+    void clear() noexcept
+    {
+        destroyAll();
+        m_used = 0;
+        m_size = 0;
+        m_dead = 0;
+    }
+
+    std::size_t capacity() const noexcept { return m_capacity; }
+    std::size_t bytesUsed() const noexcept { return m_used; }
+
+private:
+    static constexpr std::size_t alignUp(std::size_t n, std::size_t a) noexcept { return (n + a - 1) & ~(a - 1); }
+
+    // the arena is aligned to arenaAlign, so the position of an object only depends on
+    // the position of its header and its alignment:
+    static constexpr std::size_t objectPos(std::size_t pos, std::size_t align) noexcept
+    {
+        return alignUp(pos + sizeof(Header), align);
+    }
+
+    // bytes of header, padding and object at position pos:
+    static constexpr std::size_t entrySize(std::size_t pos, const TypeInfo& type) noexcept
+    {
+        return alignUp(objectPos(pos, type.align) + type.size, alignof(Header)) - pos;
+    }
+
+    template<typename F>
+    void forEachEntry(F&& f)
+    {
+        for(std::size_t pos{0}; pos < m_used;)
+        {
+            auto* h = std::launder(reinterpret_cast<Header*>(m_arena + pos));
+            auto* type = h->type();
+            f(pos, *h);
+            pos += entrySize(pos, *type);
+        }
+    }
+
+    void grow(std::size_t minBytes)
+    {
+        std::size_t bytes = m_capacity == 0 ? 4096 : m_capacity * 2;
+        reallocate(bytes < minBytes ? minBytes : bytes);
+    }
+
+    // new arena, live elements are relocated without gaps:
+    void reallocate(std::size_t bytes)
+    {
+        bytes = alignUp(bytes, arenaAlign);
+        auto* arena = static_cast<std::byte*>(::operator new(bytes, std::align_val_t{arenaAlign}));
+        std::size_t out{0};
+        forEachEntry([&](std::size_t pos, Header& h) {
+            if(h.alive())
+            {
+                auto* type = h.type();
+                type->relocate(arena + objectPos(out, type->align), m_arena + objectPos(pos, type->align));
+                ::new(arena + out) Header{ h.bits };
+                out += entrySize(out, *type);
+            }
+        });
+        if(m_arena)
+        {
+            ::operator delete(m_arena, std::align_val_t{arenaAlign});
+        }
+        m_arena = arena;
+        m_capacity = bytes;
+        m_used = out;
+        m_dead = 0;
+    }
+
+    void destroyAll() noexcept
+    {
+        forEachEntry([&](std::size_t pos, Header& h) {
+            auto* type = h.type();
+            if(h.alive() && type->destroy)
+            {
+                type->destroy(m_arena + objectPos(pos, type->align));
+            }
+        });
+    }
+
+    void release() noexcept
+    {
+        if(m_arena)
+        {
+            destroyAll();
+            ::operator delete(m_arena, std::align_val_t{arenaAlign});
+            m_arena = nullptr;
+        }
+        m_capacity = m_used = m_size = m_dead = 0;
+    }
+
+    std::byte* m_arena{nullptr};
+    std::size_t m_capacity{0};
+    std::size_t m_used{0};  // bytes used by headers and objects, including erased ones
+    std::size_t m_size{0};
+    std::size_t m_dead{0};  // erased elements not yet compacted
+};
@@ -0,0 +1,296 @@
+#pragma once
+
+#include <any>  // for std::bad_any_cast
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/********************************************
+* SmallAny<Capacity>
+* a std::any alternative for hot paths:
+* - values up to Capacity bytes (and nothrow movable) are stored inline, larger ones on the heap;
+*   std::any of libstdc++ only stores values up to the size of a pointer inline
+* - moving is always noexcept (inline values are required to be nothrow movable,
+*   heap values are moved by moving the pointer)
+* - no RTTI: every type has an integer ID. IDs assigned with SMALL_ANY_TYPE_ID() are
+*   compile-time constants which can be used in a switch, all other types get an ID the
+*   first time it is asked for (also during static initialization), which can be used
+*   for table lookups.
+*   any_cast<>() compares these integers instead of std::type_info objects.
+********************************************/
+
+namespace small_any_detail {
+
+// IDs of SMALL_ANY_TYPE_ID() have to be below this value:
+inline constexpr std::uint32_t firstDynamicId = 1u << 16;
+
+inline std::uint32_t nextTypeId() noexcept
+{
+    static std::atomic<std::uint32_t> next{firstDynamicId};
+    return next.fetch_add(1, std::memory_order_relaxed);
+}
+
+}  // namespace small_any_detail
+
+// ID 0 means "no value"; a function-local static rather than a static data member, whose
+// dynamic initialization could run after a global SmallAny in another TU already read 0:
+template<typename T, typename = void>
+struct AnyTypeId {
+    static std::uint32_t id() noexcept
+    {
+        static const std::uint32_t v = small_any_detail::nextTypeId();
+        return v;
+    }
+};
+
+// assigns a fixed ID (1..65535) to a type, AnyTypeId<Type>::value is a constant expression;
+// has to be used at global scope:
+#define SMALL_ANY_TYPE_ID(Type, Id)                                                            \
+    template<>                                                                                 \
+    struct AnyTypeId<Type> : std::integral_constant<std::uint32_t, Id> {                      \
+        static_assert(Id > 0 && Id < small_any_detail::firstDynamicId, "invalid SmallAny id"); \
+        static constexpr std::uint32_t id() noexcept { return Id; }                            \
+    };
+
+template<std::size_t Capacity = 3 * sizeof(void*)>
+class SmallAny
+{
+    static_assert(Capacity >= sizeof(void*), "SmallAny: the buffer has to hold at least a pointer");
+
+    template<typename T>
+    static constexpr bool storedInline = sizeof(T) <= Capacity && alignof(T) <= alignof(std::max_align_t)
+                                         && std::is_nothrow_move_constructible_v<T>;
+
+    template<typename T>
+    struct IsInPlaceType : std::false_type {};
+    template<typename T>
+    struct IsInPlaceType<std::in_place_type_t<T>> : std::true_type {};
+
+    template<typename T>
+    static constexpr bool isValueType = !std::is_same_v<std::decay_t<T>, SmallAny> && !IsInPlaceType<std::decay_t<T>>::value;
+
+public:
+    SmallAny() noexcept = default;
+
+    template<typename T, typename = std::enable_if_t<isValueType<T>>>
+    SmallAny(T&& val)
+    {
+        construct<std::decay_t<T>>(std::forward<T>(val));
+    }
+
+    template<typename T, typename... Args>
+    explicit SmallAny(std::in_place_type_t<T>, Args&&... args)
+    {
+        construct<std::decay_t<T>>(std::forward<Args>(args)...);
+    }
+
+    SmallAny(const SmallAny& other)
+    {
+        if(other.m_manage)
+        {
+            other.m_manage(Op::copy, &other, this);
+            m_manage = other.m_manage;
+            m_typeId = other.m_typeId;
+        }
+    }
+
+    SmallAny(SmallAny&& other) noexcept
+    {
+        if(other.m_manage)
+        {
+            other.m_manage(Op::move, &other, this);
+            m_manage = std::exchange(other.m_manage, nullptr);
+            m_typeId = std::exchange(other.m_typeId, 0);
+        }
+    }
+
+    SmallAny& operator=(const SmallAny& other)
+    {
+        // copy first, so that *this is unchanged if copying throws:
+        *this = SmallAny(other);
+        return *this;
+    }
+
+    SmallAny& operator=(SmallAny&& other) noexcept
+    {
+        if(this != &other)
+        {
+            reset();
+            if(other.m_manage)
+            {
+                other.m_manage(Op::move, &other, this);
+                m_manage = std::exchange(other.m_manage, nullptr);
+                m_typeId = std::exchange(other.m_typeId, 0);
+            }
+        }
+        return *this;
+    }
+
+    template<typename T, typename = std::enable_if_t<isValueType<T>>>
+    SmallAny& operator=(T&& val)
+    {
+        emplace<std::decay_t<T>>(std::forward<T>(val));
+        return *this;
+    }
+
+    ~SmallAny() { reset(); }
+
+    template<typename T, typename... Args>
+    std::decay_t<T>& emplace(Args&&... args)
+    {
+        reset();
+        construct<std::decay_t<T>>(std::forward<Args>(args)...);
+        return *ptr<std::decay_t<T>>();
+    }
+
+    void reset() noexcept
+    {
+        if(m_manage)
+        {
+            m_manage(Op::destroy, this, nullptr);
+            m_manage = nullptr;
+            m_typeId = 0;
+        }
+    }
+
+    bool has_value() const noexcept { return m_manage != nullptr; }
+
+    // 0 if empty, AnyTypeId<T>::id() otherwise:
+    std::uint32_t typeId() const noexcept { return m_typeId; }
+
+    template<typename T>
+    bool holds() const noexcept { return m_typeId == AnyTypeId<T>::id(); }
+
+    // true if the value needs no heap memory:
+    bool isInline() const noexcept { return m_manage && m_manage(Op::isInline, this, nullptr); }
+
+    // unchecked access, T has to be the type of the current value:
+    template<typename T>
+    T* ptr() noexcept
+    {
+        if constexpr(storedInline<T>) {
+            return std::launder(reinterpret_cast<T*>(m_buf));
+        }
+        else {
+            return *std::launder(reinterpret_cast<T**>(m_buf));
+        }
+    }
+
+    template<typename T>
+    const T* ptr() const noexcept
+    {
+        return const_cast<SmallAny*>(this)->template ptr<T>();
+    }
+
+private:
+    enum class Op { copy, move, destroy, isInline };
+    using Manager = bool (*)(Op, const SmallAny*, SmallAny*);
+
+    template<typename T, typename... Args>
+    void construct(Args&&... args)
+    {
+        static_assert(std::is_copy_constructible_v<T>, "SmallAny: the value type has to be copyable");
+        if constexpr(storedInline<T>) {
+            ::new(static_cast<void*>(m_buf)) T(std::forward<Args>(args)...);
+        }
+        else {
+            T* p = new T(std::forward<Args>(args)...);
+            ::new(static_cast<void*>(m_buf)) T*(p);
+        }
+        m_manage = &manage<T>;
+        m_typeId = AnyTypeId<T>::id();
+    }
+
+    // one function per type for the rarely used operations:
+    template<typename T>
+    static bool manage(Op op, const SmallAny* self, SmallAny* other)
+    {
+        auto* src = const_cast<SmallAny*>(self);
+        switch(op)
+        {
+            case Op::copy:
+                if constexpr(storedInline<T>) {
+                    ::new(static_cast<void*>(other->m_buf)) T(*src->template ptr<T>());
+                }
+                else {
+                    ::new(static_cast<void*>(other->m_buf)) T*(new T(*src->template ptr<T>()));
+                }
+                return true;
+            case Op::move:
+                if constexpr(storedInline<T>) {
+                    T* p = src->template ptr<T>();
+                    ::new(static_cast<void*>(other->m_buf)) T(std::move(*p));
+                    p->~T();
+                }
+                else {
+                    ::new(static_cast<void*>(other->m_buf)) T*(src->template ptr<T>());
+                }
+                return true;
+            case Op::destroy:
+                if constexpr(storedInline<T>) {
+                    src->template ptr<T>()->~T();
+                }
+                else {
+                    delete src->template ptr<T>();
+                }
+                return true;
+            case Op::isInline:
+                return storedInline<T>;
+        }
+        return false;
+    }
+
+    alignas(std::max_align_t) unsigned char m_buf[Capacity];
+    Manager m_manage{nullptr};
+    std::uint32_t m_typeId{0};
+};
+
+// any_cast<T>(&a) yields nullptr, any_cast<T>(a) throws std::bad_any_cast if a doesn't hold a T:
+
+template<typename T, std::size_t Capacity>
+T* any_cast(SmallAny<Capacity>* a) noexcept
+{
+    return a && a->template holds<T>() ? a->template ptr<T>() : nullptr;
+}
+
+template<typename T, std::size_t Capacity>
+const T* any_cast(const SmallAny<Capacity>* a) noexcept
+{
+    return a && a->template holds<T>() ? a->template ptr<T>() : nullptr;
+}
+
+template<typename T, std::size_t Capacity>
+T any_cast(SmallAny<Capacity>& a)
+{
+    using U = std::remove_cv_t<std::remove_reference_t<T>>;
+    if(auto p = any_cast<U>(&a); p)
+    {
+        return static_cast<T>(*p);
+    }
+    throw std::bad_any_cast{};
+}
+
+template<typename T, std::size_t Capacity>
+T any_cast(const SmallAny<Capacity>& a)
+{
+    using U = std::remove_cv_t<std::remove_reference_t<T>>;
+    if(auto p = any_cast<U>(&a); p)
+    {
+        return static_cast<T>(*p);
+    }
+    throw std::bad_any_cast{};
+}
+
+template<typename T, std::size_t Capacity>
+T any_cast(SmallAny<Capacity>&& a)
+{
+    using U = std::remove_cv_t<std::remove_reference_t<T>>;
+    if(auto p = any_cast<U>(&a); p)
+    {
+        return static_cast<T>(std::move(*p));
+    }
+    throw std::bad_any_cast{};
+}
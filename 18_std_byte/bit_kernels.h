@@ -0,0 +1,713 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BIT_KERNELS_HAVE_X86 1
+#endif
+
+/********************************************
+* bit kernels over std::byte arrays
+* bitwise operations over large bitmaps (masks, fingerprints) given as pointer
+* and size in bytes. Bit i is bit i % 8 of byte i / 8 (as for std::bitset<> and
+* little endian words).
+* - andBytes(), orBytes(), xorBytes(), andNotBytes(): dst = a op b, dst may be a or b
+* - popcount(): number of set bits
+* - shiftLeftBits(), shiftRightBits(): shift across byte boundaries with std::bitset<>
+*   semantics (left moves bit i to i + shift), zeros are shifted in, works in place
+* - findFirstSet(): first set bit at or after a position
+* - rankBits() / selectBit(): set bits before a position / position of the k-th set bit,
+*   BitRankIndex answers both in (almost) constant time after one pass over the data
+* Each kernel has a scalar version working on 64 bit words, an AVX2 and an AVX-512
+* version. The best one the CPU supports is chosen at run time.
+********************************************/
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "bit kernels: 64 bit words are assumed to be little endian");
+
+namespace bit_kernels_detail {
+
+enum class Op { And, Or, Xor, AndNot };
+
+inline std::uint64_t load64(const std::byte* p) noexcept
+{
+    std::uint64_t w;
+    std::memcpy(&w, p, sizeof(w));
+    return w;
+}
+
+inline void store64(std::byte* p, std::uint64_t w) noexcept
+{
+    std::memcpy(p, &w, sizeof(w));
+}
+
+// first n < 8 bytes, the rest is 0:
+inline std::uint64_t loadPartial64(const std::byte* p, std::size_t n) noexcept
+{
+    std::uint64_t w{0};
+    std::memcpy(&w, p, n);
+    return w;
+}
+
+inline unsigned popcount8(std::byte b) noexcept
+{
+    return static_cast<unsigned>(__builtin_popcount(std::to_integer<unsigned>(b)));
+}
+
+// works for std::byte and std::uint64_t:
+template<Op op, typename T>
+constexpr T apply(T a, T b) noexcept
+{
+    if constexpr(op == Op::And) {
+        return a & b;
+    }
+    else if constexpr(op == Op::Or) {
+        return a | b;
+    }
+    else if constexpr(op == Op::Xor) {
+        return a ^ b;
+    }
+    else {
+        return a & ~b;
+    }
+}
+
+/******************** scalar ********************/
+
+template<Op op>
+void binaryScalar(std::byte* dst, const std::byte* a, const std::byte* b, std::size_t n) noexcept
+{
+    std::size_t i{0};
+    for(; i + 8 <= n; i += 8)
+    {
+        store64(dst + i, apply<op>(load64(a + i), load64(b + i)));
+    }
+    for(; i < n; ++i)
+    {
+        dst[i] = apply<op>(a[i], b[i]);
+    }
+}
+
+inline std::size_t popcountScalar(const std::byte* p, std::size_t n) noexcept
+{
+    std::size_t count{0};
+    std::size_t i{0};
+    for(; i + 8 <= n; i += 8)
+    {
+        count += static_cast<std::size_t>(__builtin_popcountll(load64(p + i)));
+    }
+    for(; i < n; ++i)
+    {
+        count += popcount8(p[i]);
+    }
+    return count;
+}
+
+// index of the first non-zero byte at or after start, n if there is none:
+inline std::size_t findNonZeroScalar(const std::byte* p, std::size_t n, std::size_t start) noexcept
+{
+    std::size_t i{start};
+    for(; i + 8 <= n; i += 8)
+    {
+        if(auto w = load64(p + i); w != 0)
+        {
+            return i + static_cast<std::size_t>(__builtin_ctzll(w)) / 8;
+        }
+    }
+    for(; i < n; ++i)
+    {
+        if(p[i] != std::byte{0})
+        {
+            return i;
+        }
+    }
+    return n;
+}
+
+// Shifting by q bytes and r < 8 bits: output byte i combines source byte i - q (shifted
+// by r) with the top r bits of byte i - q - 1, and a 64 bit word at i with the top r bits
+// of the word at i - q - 8. Left shifts run from the end to the start and right shifts
+// from the start to the end, so that dst == src only overwrites bytes already read.
+
+// output bytes [0, end) of a left shift:
+inline void shiftLeftScalar(std::byte* dst, const std::byte* src, std::size_t end, std::size_t q, unsigned r) noexcept
+{
+    std::size_t i{end};
+    while(i >= q + 16)
+    {
+        i -= 8;
+        std::uint64_t lo = r != 0 ? load64(src + i - q - 8) >> (64 - r) : 0;
+        store64(dst + i, (load64(src + i - q) << r) | lo);
+    }
+    while(i > q)
+    {
+        --i;
+        std::byte lo = (r != 0 && i > q) ? src[i - q - 1] >> (8 - r) : std::byte{0};
+        dst[i] = (src[i - q] << r) | lo;
+    }
+    // i <= q now, everything below comes from outside of src:
+    std::memset(dst, 0, i);
+}
+
+// output bytes [start, n) of a right shift:
+inline void shiftRightScalar(std::byte* dst, const std::byte* src, std::size_t n, std::size_t q, unsigned r, std::size_t start) noexcept
+{
+    std::size_t i{start};
+    for(; i + q + 16 <= n; i += 8)
+    {
+        std::uint64_t hi = r != 0 ? load64(src + i + q + 8) << (64 - r) : 0;
+        store64(dst + i, (load64(src + i + q) >> r) | hi);
+    }
+    for(; i + q < n; ++i)
+    {
+        std::byte hi = (r != 0 && i + q + 1 < n) ? src[i + q + 1] << (8 - r) : std::byte{0};
+        dst[i] = (src[i + q] >> r) | hi;
+    }
+    std::memset(dst + i, 0, n - i);
+}
+
+inline unsigned selectInWordScalar(std::uint64_t w, unsigned k) noexcept
+{
+    for(; k != 0; --k)
+    {
+        w &= w - 1;
+    }
+    return static_cast<unsigned>(__builtin_ctzll(w));
+}
+
+#ifdef BIT_KERNELS_HAVE_X86
+
+/******************** AVX2 ********************/
+
+template<Op op>
+__attribute__((target("avx2"))) inline __m256i applyAvx2(__m256i a, __m256i b) noexcept
+{
+    if constexpr(op == Op::And) {
+        return _mm256_and_si256(a, b);
+    }
+    else if constexpr(op == Op::Or) {
+        return _mm256_or_si256(a, b);
+    }
+    else if constexpr(op == Op::Xor) {
+        return _mm256_xor_si256(a, b);
+    }
+    else {
+        return _mm256_andnot_si256(b, a);
+    }
+}
+
+template<Op op>
+__attribute__((target("avx2"))) void binaryAvx2(std::byte* dst, const std::byte* a, const std::byte* b, std::size_t n) noexcept
+{
+    std::size_t i{0};
+    for(; i + 64 <= n; i += 64)
+    {
+        __m256i x0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i x1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i + 32));
+        __m256i y0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        __m256i y1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i + 32));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), applyAvx2<op>(x0, y0));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 32), applyAvx2<op>(x1, y1));
+    }
+    binaryScalar<op>(dst + i, a + i, b + i, n - i);
+}
+
+// bits per byte with a 16 entry lookup table for each nibble (Mula, Kurz, Lemire,
+// "Faster Population Counts Using AVX2 Instructions"):
+__attribute__((target("avx2"))) inline __m256i popcountPerByteAvx2(__m256i v) noexcept
+{
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i lowNibble = _mm256_set1_epi8(0x0f);
+    __m256i lo = _mm256_and_si256(v, lowNibble);
+    __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), lowNibble);
+    return _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo), _mm256_shuffle_epi8(lookup, hi));
+}
+
+__attribute__((target("avx2"))) inline std::size_t popcountAvx2(const std::byte* p, std::size_t n) noexcept
+{
+    __m256i total = _mm256_setzero_si256();
+    std::size_t i{0};
+    while(i + 32 <= n)
+    {
+        // a byte counter grows by at most 8 per vector, 31 vectors fit before summing up:
+        __m256i acc = _mm256_setzero_si256();
+        for(int k{0}; k < 31 && i + 32 <= n; ++k, i += 32)
+        {
+            acc = _mm256_add_epi8(acc, popcountPerByteAvx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i))));
+        }
+        total = _mm256_add_epi64(total, _mm256_sad_epu8(acc, _mm256_setzero_si256()));
+    }
+    auto count = static_cast<std::size_t>(_mm256_extract_epi64(total, 0) + _mm256_extract_epi64(total, 1) +
+                                          _mm256_extract_epi64(total, 2) + _mm256_extract_epi64(total, 3));
+    return count + popcountScalar(p + i, n - i);
+}
+
+__attribute__((target("avx2"))) inline std::size_t findNonZeroAvx2(const std::byte* p, std::size_t n, std::size_t start) noexcept
+{
+    std::size_t i{start};
+    for(; i + 64 <= n; i += 64)
+    {
+        __m256i v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        __m256i v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i + 32));
+        __m256i any = _mm256_or_si256(v0, v1);
+        if(!_mm256_testz_si256(any, any))
+        {
+            auto zero0 = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v0, _mm256_setzero_si256())));
+            auto zero1 = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v1, _mm256_setzero_si256())));
+            std::uint64_t nonZero = ~((std::uint64_t{zero1} << 32) | zero0);
+            return i + static_cast<std::size_t>(__builtin_ctzll(nonZero));
+        }
+    }
+    return findNonZeroScalar(p, n, i);
+}
+
+// count is r for the low part and 64 - r for the high part; shifts by 64 give 0 for r == 0
+__attribute__((target("avx2"))) inline void shiftLeftAvx2(std::byte* dst, const std::byte* src, std::size_t n, std::size_t q, unsigned r) noexcept
+{
+    const __m128i count = _mm_cvtsi32_si128(static_cast<int>(r));
+    const __m128i carryCount = _mm_cvtsi32_si128(static_cast<int>(64 - r));
+    std::size_t i{n};
+    while(i >= q + 40)
+    {
+        i -= 32;
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i - q));
+        __m256i carry = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i - q - 8));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_or_si256(_mm256_sll_epi64(v, count), _mm256_srl_epi64(carry, carryCount)));
+    }
+    shiftLeftScalar(dst, src, i, q, r);
+}
+
+__attribute__((target("avx2"))) inline void shiftRightAvx2(std::byte* dst, const std::byte* src, std::size_t n, std::size_t q, unsigned r) noexcept
+{
+    const __m128i count = _mm_cvtsi32_si128(static_cast<int>(r));
+    const __m128i carryCount = _mm_cvtsi32_si128(static_cast<int>(64 - r));
+    std::size_t i{0};
+    for(; i + q + 40 <= n; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + q));
+        __m256i carry = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + q + 8));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_or_si256(_mm256_srl_epi64(v, count), _mm256_sll_epi64(carry, carryCount)));
+    }
+    shiftRightScalar(dst, src, n, q, r, i);
+}
+
+/******************** AVX-512 ********************/
+
+// lowest n bytes of a 64 byte vector, n < 64:
+inline __mmask64 tailMask(std::size_t n) noexcept
+{
+    return n == 0 ? 0 : ~std::uint64_t{0} >> (64 - n);
+}
+
+template<Op op>
+__attribute__((target("avx512f"))) inline __m512i applyAvx512(__m512i a, __m512i b) noexcept
+{
+    if constexpr(op == Op::And) {
+        return _mm512_and_si512(a, b);
+    }
+    else if constexpr(op == Op::Or) {
+        return _mm512_or_si512(a, b);
+    }
+    else if constexpr(op == Op::Xor) {
+        return _mm512_xor_si512(a, b);
+    }
+    else {
+        // zero-masked with a full mask: GCC 12 warns about the unmasked _mm512_andnot_si512()
+        return _mm512_maskz_andnot_epi64(0xff, b, a);
+    }
+}
+
+// the tail is done with masked loads and stores, which don't touch bytes outside of the mask
+template<Op op>
+__attribute__((target("avx512f,avx512bw"))) void binaryAvx512(std::byte* dst, const std::byte* a, const std::byte* b, std::size_t n) noexcept
+{
+    std::size_t i{0};
+    for(; i + 128 <= n; i += 128)
+    {
+        __m512i x0 = _mm512_loadu_si512(a + i);
+        __m512i x1 = _mm512_loadu_si512(a + i + 64);
+        __m512i y0 = _mm512_loadu_si512(b + i);
+        __m512i y1 = _mm512_loadu_si512(b + i + 64);
+        _mm512_storeu_si512(dst + i, applyAvx512<op>(x0, y0));
+        _mm512_storeu_si512(dst + i + 64, applyAvx512<op>(x1, y1));
+    }
+    if(i + 64 <= n)
+    {
+        _mm512_storeu_si512(dst + i, applyAvx512<op>(_mm512_loadu_si512(a + i), _mm512_loadu_si512(b + i)));
+        i += 64;
+    }
+    if(i < n)
+    {
+        __mmask64 m = tailMask(n - i);
+        __m512i x = _mm512_maskz_loadu_epi8(m, a + i);
+        __m512i y = _mm512_maskz_loadu_epi8(m, b + i);
+        _mm512_mask_storeu_epi8(dst + i, m, applyAvx512<op>(x, y));
+    }
+}
+
+__attribute__((target("avx512f,avx512bw,avx512vpopcntdq"))) inline std::size_t popcountAvx512(const std::byte* p, std::size_t n) noexcept
+{
+    __m512i total0 = _mm512_setzero_si512();
+    __m512i total1 = _mm512_setzero_si512();
+    std::size_t i{0};
+    for(; i + 128 <= n; i += 128)
+    {
+        total0 = _mm512_add_epi64(total0, _mm512_popcnt_epi64(_mm512_loadu_si512(p + i)));
+        total1 = _mm512_add_epi64(total1, _mm512_popcnt_epi64(_mm512_loadu_si512(p + i + 64)));
+    }
+    for(; i < n; i += 64)
+    {
+        __mmask64 m = n - i >= 64 ? ~__mmask64{0} : tailMask(n - i);
+        total0 = _mm512_add_epi64(total0, _mm512_popcnt_epi64(_mm512_maskz_loadu_epi8(m, p + i)));
+    }
+    // reduced via the two 256 bit halves; the zero-masked extract with a full mask is the plain
+    // vextracti64x4, whereas GCC 12 warns about the unmasked one and _mm512_reduce_add_epi64():
+    __m512i total = _mm512_add_epi64(total0, total1);
+    __m256i sum = _mm256_add_epi64(_mm512_maskz_extracti64x4_epi64(0xff, total, 0), _mm512_maskz_extracti64x4_epi64(0xff, total, 1));
+    return static_cast<std::size_t>(_mm256_extract_epi64(sum, 0) + _mm256_extract_epi64(sum, 1) +
+                                    _mm256_extract_epi64(sum, 2) + _mm256_extract_epi64(sum, 3));
+}
+
+__attribute__((target("avx512f,avx512bw"))) inline std::size_t findNonZeroAvx512(const std::byte* p, std::size_t n, std::size_t start) noexcept
+{
+    std::size_t i{start};
+    for(; i + 128 <= n; i += 128)
+    {
+        __m512i v0 = _mm512_loadu_si512(p + i);
+        __m512i v1 = _mm512_loadu_si512(p + i + 64);
+        if(_mm512_test_epi64_mask(_mm512_or_si512(v0, v1), _mm512_or_si512(v0, v1)) != 0)
+        {
+            break;
+        }
+    }
+    for(; i < n; i += 64)
+    {
+        __mmask64 m = n - i >= 64 ? ~__mmask64{0} : tailMask(n - i);
+        __m512i v = _mm512_maskz_loadu_epi8(m, p + i);
+        if(__mmask64 nonZero = _mm512_test_epi8_mask(v, v); nonZero != 0)
+        {
+            return i + static_cast<std::size_t>(__builtin_ctzll(nonZero));
+        }
+    }
+    return n;
+}
+
+__attribute__((target("avx512f"))) inline void shiftLeftAvx512(std::byte* dst, const std::byte* src, std::size_t n, std::size_t q, unsigned r) noexcept
+{
+    // broadcast counts with the zero-masked variable shifts (full mask), for the same reason as above:
+    const __m512i count = _mm512_set1_epi64(r);
+    const __m512i carryCount = _mm512_set1_epi64(64 - r);
+    std::size_t i{n};
+    while(i >= q + 72)
+    {
+        i -= 64;
+        __m512i v = _mm512_loadu_si512(src + i - q);
+        __m512i carry = _mm512_loadu_si512(src + i - q - 8);
+        _mm512_storeu_si512(dst + i, _mm512_or_si512(_mm512_maskz_sllv_epi64(0xff, v, count), _mm512_maskz_srlv_epi64(0xff, carry, carryCount)));
+    }
+    shiftLeftScalar(dst, src, i, q, r);
+}
+
+__attribute__((target("avx512f"))) inline void shiftRightAvx512(std::byte* dst, const std::byte* src, std::size_t n, std::size_t q, unsigned r) noexcept
+{
+    const __m512i count = _mm512_set1_epi64(r);
+    const __m512i carryCount = _mm512_set1_epi64(64 - r);
+    std::size_t i{0};
+    for(; i + q + 72 <= n; i += 64)
+    {
+        __m512i v = _mm512_loadu_si512(src + i + q);
+        __m512i carry = _mm512_loadu_si512(src + i + q + 8);
+        _mm512_storeu_si512(dst + i, _mm512_or_si512(_mm512_maskz_srlv_epi64(0xff, v, count), _mm512_maskz_sllv_epi64(0xff, carry, carryCount)));
+    }
+    shiftRightScalar(dst, src, n, q, r, i);
+}
+
+// the k-th set bit is the bit pdep() deposits bit k of a mask to:
+__attribute__((target("bmi2"))) inline unsigned selectInWordBmi2(std::uint64_t w, unsigned k) noexcept
+{
+    return static_cast<unsigned>(__builtin_ctzll(_pdep_u64(std::uint64_t{1} << k, w)));
+}
+
+inline bool haveAvx2() noexcept
+{
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+}
+
+// AVX512F + BW cover all kernels but the popcount, which needs VPOPCNTDQ on top
+// (Skylake-X and Cascade Lake have the first two only):
+inline bool haveAvx512() noexcept
+{
+    static const bool avx512 = __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+    return avx512;
+}
+
+inline bool haveAvx512Popcount() noexcept
+{
+    static const bool vpopcnt = haveAvx512() && __builtin_cpu_supports("avx512vpopcntdq");
+    return vpopcnt;
+}
+
+inline bool haveBmi2() noexcept
+{
+    static const bool bmi2 = __builtin_cpu_supports("bmi2");
+    return bmi2;
+}
+
+#endif
+
+/******************** dispatch ********************/
+
+template<Op op>
+void binary(std::byte* dst, const std::byte* a, const std::byte* b, std::size_t n) noexcept
+{
+#ifdef BIT_KERNELS_HAVE_X86
+    if(haveAvx512()) {
+        return binaryAvx512<op>(dst, a, b, n);
+    }
+    if(haveAvx2()) {
+        return binaryAvx2<op>(dst, a, b, n);
+    }
+#endif
+    binaryScalar<op>(dst, a, b, n);
+}
+
+inline std::size_t findNonZero(const std::byte* p, std::size_t n, std::size_t start) noexcept
+{
+#ifdef BIT_KERNELS_HAVE_X86
+    if(haveAvx512()) {
+        return findNonZeroAvx512(p, n, start);
+    }
+    if(haveAvx2()) {
+        return findNonZeroAvx2(p, n, start);
+    }
+#endif
+    return findNonZeroScalar(p, n, start);
+}
+
+inline unsigned selectInWord(std::uint64_t w, unsigned k) noexcept
+{
+#ifdef BIT_KERNELS_HAVE_X86
+    if(haveBmi2()) {
+        return selectInWordBmi2(w, k);
+    }
+#endif
+    return selectInWordScalar(w, k);
+}
+
+// position of the k-th set bit within n bytes, word by word; there have to be more than k set bits:
+inline std::size_t selectInWords(const std::byte* p, std::size_t n, std::size_t k) noexcept
+{
+    for(std::size_t i{0};; i += 8)
+    {
+        std::uint64_t w = i + 8 <= n ? load64(p + i) : loadPartial64(p + i, n - i);
+        auto count = static_cast<std::size_t>(__builtin_popcountll(w));
+        if(k < count)
+        {
+            return i * 8 + selectInWord(w, static_cast<unsigned>(k));
+        }
+        k -= count;
+    }
+}
+
+}  // namespace bit_kernels_detail
+
+// dst = a & b (n bytes):
+inline void andBytes(std::byte* dst, const std::byte* a, const std::byte* b, std::size_t n) noexcept
+{
+    bit_kernels_detail::binary<bit_kernels_detail::Op::And>(dst, a, b, n);
+}
+
+// dst = a | b:
+inline void orBytes(std::byte* dst, const std::byte* a, const std::byte* b, std::size_t n) noexcept
+{
+    bit_kernels_detail::binary<bit_kernels_detail::Op::Or>(dst, a, b, n);
+}
+
+// dst = a ^ b:
+inline void xorBytes(std::byte* dst, const std::byte* a, const std::byte* b, std::size_t n) noexcept
+{
+    bit_kernels_detail::binary<bit_kernels_detail::Op::Xor>(dst, a, b, n);
+}
+
+// dst = a & ~b:
+inline void andNotBytes(std::byte* dst, const std::byte* a, const std::byte* b, std::size_t n) noexcept
+{
+    bit_kernels_detail::binary<bit_kernels_detail::Op::AndNot>(dst, a, b, n);
+}
+
+// number of set bits in n bytes:
+inline std::size_t popcount(const std::byte* p, std::size_t n) noexcept
+{
+#ifdef BIT_KERNELS_HAVE_X86
+    if(bit_kernels_detail::haveAvx512Popcount()) {
+        return bit_kernels_detail::popcountAvx512(p, n);
+    }
+    if(bit_kernels_detail::haveAvx2()) {
+        return bit_kernels_detail::popcountAvx2(p, n);
+    }
+#endif
+    return bit_kernels_detail::popcountScalar(p, n);
+}
+
+// bit i of dst becomes bit i - shift of src (as std::bitset<>::operator<<), dst may be src:
+inline void shiftLeftBits(std::byte* dst, const std::byte* src, std::size_t n, std::size_t shift) noexcept
+{
+    if(shift / 8 >= n)
+    {
+        std::fill_n(dst, n, std::byte{0});
+        return;
+    }
+    std::size_t q = shift / 8;
+    auto r = static_cast<unsigned>(shift % 8);
+#ifdef BIT_KERNELS_HAVE_X86
+    if(bit_kernels_detail::haveAvx512()) {
+        return bit_kernels_detail::shiftLeftAvx512(dst, src, n, q, r);
+    }
+    if(bit_kernels_detail::haveAvx2()) {
+        return bit_kernels_detail::shiftLeftAvx2(dst, src, n, q, r);
+    }
+#endif
+    bit_kernels_detail::shiftLeftScalar(dst, src, n, q, r);
+}
+
+// bit i of dst becomes bit i + shift of src (as std::bitset<>::operator>>), dst may be src:
+inline void shiftRightBits(std::byte* dst, const std::byte* src, std::size_t n, std::size_t shift) noexcept
+{
+    if(shift / 8 >= n)
+    {
+        std::fill_n(dst, n, std::byte{0});
+        return;
+    }
+    std::size_t q = shift / 8;
+    auto r = static_cast<unsigned>(shift % 8);
+#ifdef BIT_KERNELS_HAVE_X86
+    if(bit_kernels_detail::haveAvx512()) {
+        return bit_kernels_detail::shiftRightAvx512(dst, src, n, q, r);
+    }
+    if(bit_kernels_detail::haveAvx2()) {
+        return bit_kernels_detail::shiftRightAvx2(dst, src, n, q, r);
+    }
+#endif
+    bit_kernels_detail::shiftRightScalar(dst, src, n, q, r, 0);
+}
+
+// position of the first set bit >= from, std::nullopt if there is none:
+inline std::optional<std::size_t> findFirstSet(const std::byte* p, std::size_t n, std::size_t from = 0) noexcept
+{
+    if(from / 8 >= n)
+    {
+        return std::nullopt;
+    }
+    std::size_t i = from / 8;
+    // bits below from in the first byte don't count:
+    if(unsigned first = std::to_integer<unsigned>(p[i]) & (0xffu << (from % 8)); first != 0)
+    {
+        return i * 8 + static_cast<std::size_t>(__builtin_ctz(first));
+    }
+    std::size_t j = bit_kernels_detail::findNonZero(p, n, i + 1);
+    if(j == n)
+    {
+        return std::nullopt;
+    }
+    return j * 8 + static_cast<std::size_t>(__builtin_ctz(std::to_integer<unsigned>(p[j])));
+}
+
+// number of set bits at positions < pos (pos <= 8 * size of the array):
+inline std::size_t rankBits(const std::byte* p, std::size_t pos) noexcept
+{
+    std::size_t count = popcount(p, pos / 8);
+    if(pos % 8 != 0)
+    {
+        count += bit_kernels_detail::popcount8(p[pos / 8] & std::byte(0xffu >> (8 - pos % 8)));
+    }
+    return count;
+}
+
+// position of the k-th set bit (counting from 0), std::nullopt if there are not more than k;
+// for many queries on the same data BitRankIndex is faster:
+inline std::optional<std::size_t> selectBit(const std::byte* p, std::size_t n, std::size_t k) noexcept
+{
+    // skip chunks with the vectorized popcount, then search the chunk word by word:
+    const std::size_t chunkSize{4096};
+    for(std::size_t i{0}; i < n; i += chunkSize)
+    {
+        std::size_t len = std::min(chunkSize, n - i);
+        std::size_t count = popcount(p + i, len);
+        if(k < count)
+        {
+            return i * 8 + bit_kernels_detail::selectInWords(p + i, len, k);
+        }
+        k -= count;
+    }
+    return std::nullopt;
+}
+
+/********************************************
+* BitRankIndex
+* rank and select over a bitmap that doesn't change: one pass stores the number of
+* set bits before each 64 byte block (8 bytes per 64 bytes, 12.5% of the bitmap).
+* rank() is a table lookup plus a popcount of at most one block, select() a binary
+* search over the blocks plus a search within one block.
+* The index refers to the bitmap, which has to outlive it.
+********************************************/
+
+class BitRankIndex
+{
+public:
+    static constexpr std::size_t blockBytes{64};
+
+    BitRankIndex(const std::byte* p, std::size_t n) : m_data{p}, m_size{n}
+    {
+        m_blocks.reserve(n / blockBytes + 2);
+        std::size_t count{0};
+        for(std::size_t i{0}; i < n; i += blockBytes)
+        {
+            m_blocks.push_back(count);
+            count += popcount(p + i, std::min(blockBytes, n - i));
+        }
+        m_blocks.push_back(count);
+    }
+
+    // number of bits:
+    std::size_t size() const noexcept { return m_size * 8; }
+
+    // number of set bits:
+    std::size_t count() const noexcept { return static_cast<std::size_t>(m_blocks.back()); }
+
+    // number of set bits at positions < pos (pos <= size()):
+    std::size_t rank(std::size_t pos) const noexcept
+    {
+        std::size_t block = pos / (blockBytes * 8);
+        if(block == m_blocks.size() - 1)
+        {
+            return count();
+        }
+        return static_cast<std::size_t>(m_blocks[block]) + rankBits(m_data + block * blockBytes, pos % (blockBytes * 8));
+    }
+
+    // position of the k-th set bit (counting from 0), std::nullopt if k >= count():
+    std::optional<std::size_t> select(std::size_t k) const noexcept
+    {
+        if(k >= count())
+        {
+            return std::nullopt;
+        }
+        // last block with fewer than k + 1 set bits before it:
+        auto it = std::upper_bound(m_blocks.begin(), m_blocks.end(), k) - 1;
+        auto block = static_cast<std::size_t>(it - m_blocks.begin());
+        std::size_t offset = block * blockBytes;
+        return offset * 8 + bit_kernels_detail::selectInWords(m_data + offset, std::min(blockBytes, m_size - offset), k - *it);
+    }
+
+private:
+    const std::byte* m_data;
+    std::size_t m_size;
+    std::vector<std::uint64_t> m_blocks;  // set bits before each block, the total at the end
+};
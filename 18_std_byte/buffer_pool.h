@@ -0,0 +1,485 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+/********************************************
+* BufferPool / ByteSlice
+* pool of std::byte buffers for I/O, instead of a new std::vector<char> per read:
+* - size classes from 64 bytes to 1 MiB (powers of two), each carved out of large slabs;
+*   blocks of 4 KiB and more are page aligned, smaller blocks are cache-line aligned
+* - every thread has a small cache per size class, so most acquire()/release pairs
+*   need no lock; the central free lists are refilled and drained in batches
+* - releasing never allocates, also from threads that only consume slices
+* - the caches of exited threads are reused, so their number is bounded by the number
+*   of threads using the pool at the same time
+* - acquire() returns a reference-counted ByteSlice; slice() shares the same block
+*   without copying, the block goes back to the pool when the last slice is gone
+* - stats(): hit rates of the thread caches and the central lists, bytes in use
+* Larger requests are allocated directly (page aligned) and freed when released.
+* A pool must outlive all slices acquired from it.
+********************************************/
+
+class BufferPool;
+
+namespace buffer_pool_detail {
+
+inline constexpr std::size_t cacheLineSize = 64;
+inline constexpr std::size_t pageSize = 4096;
+
+// shared by all slices of one block; itself allocated from the smallest size class:
+struct ControlBlock {
+    std::atomic<std::uint32_t> refs;
+    std::uint32_t sizeClass;  // numSizeClasses for direct allocations
+    std::size_t capacity;
+    std::byte* data;
+    BufferPool* pool;
+};
+
+}  // namespace buffer_pool_detail
+
+class ByteSlice
+{
+public:
+    ByteSlice() noexcept = default;
+
+    ByteSlice(const ByteSlice& other) noexcept
+        : m_ctrl{other.m_ctrl}
+        , m_data{other.m_data}
+        , m_size{other.m_size}
+    {
+        if(m_ctrl)
+        {
+            m_ctrl->refs.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    ByteSlice(ByteSlice&& other) noexcept
+        : m_ctrl{std::exchange(other.m_ctrl, nullptr)}
+        , m_data{std::exchange(other.m_data, nullptr)}
+        , m_size{std::exchange(other.m_size, 0)}
+    {
+    }
+
+    ByteSlice& operator=(ByteSlice other) noexcept
+    {
+        std::swap(m_ctrl, other.m_ctrl);
+        std::swap(m_data, other.m_data);
+        std::swap(m_size, other.m_size);
+        return *this;
+    }
+
+    ~ByteSlice() { reset(); }
+
+    void reset() noexcept;
+
+    std::byte* data() const noexcept { return m_data; }
+    std::size_t size() const noexcept { return m_size; }
+    bool empty() const noexcept { return m_size == 0; }
+    std::byte* begin() const noexcept { return m_data; }
+    std::byte* end() const noexcept { return m_data + m_size; }
+    std::byte& operator[](std::size_t idx) const noexcept { return m_data[idx]; }
+
+    // bytes available behind data() in the underlying block:
+    std::size_t capacity() const noexcept { return m_ctrl ? m_ctrl->capacity - static_cast<std::size_t>(m_data - m_ctrl->data) : 0; }
+
+    // shrink or grow within the block, e.g. to the number of bytes actually read:
+    void resize(std::size_t n) noexcept
+    {
+        assert(n <= capacity());
+        m_size = n;
+    }
+
+    // a view of [offset, offset+len) sharing the block, no bytes are copied:
+    ByteSlice slice(std::size_t offset, std::size_t len) const noexcept
+    {
+        assert(offset + len <= m_size);
+        ByteSlice s{*this};
+        s.m_data += offset;
+        s.m_size = len;
+        return s;
+    }
+
+    std::uint32_t use_count() const noexcept { return m_ctrl ? m_ctrl->refs.load(std::memory_order_relaxed) : 0; }
+
+private:
+    friend class BufferPool;
+    ByteSlice(buffer_pool_detail::ControlBlock* ctrl, std::size_t size) noexcept
+        : m_ctrl{ctrl}
+        , m_data{ctrl->data}
+        , m_size{size}
+    {
+    }
+
+    buffer_pool_detail::ControlBlock* m_ctrl{nullptr};
+    std::byte* m_data{nullptr};
+    std::size_t m_size{0};
+};
+
+class BufferPool
+{
+    using ControlBlock = buffer_pool_detail::ControlBlock;
+
+public:
+    static constexpr std::size_t minBlockSize = buffer_pool_detail::cacheLineSize;
+    static constexpr std::size_t maxBlockSize = std::size_t{1} << 20;
+    static constexpr std::size_t numSizeClasses = 15;  // 64 B .. 1 MiB
+    static_assert(minBlockSize << (numSizeClasses - 1) == maxBlockSize);
+
+    struct Stats {
+        std::uint64_t acquires{0};
+        std::uint64_t threadCacheHits{0};   // served by the thread cache
+        std::uint64_t centralHits{0};       // served by refilling from the central free list
+        std::uint64_t slabAllocations{0};   // new slabs, i.e. memory from the system
+        std::uint64_t directAllocations{0}; // requests larger than maxBlockSize
+        std::size_t bytesInUse{0};          // in blocks handed out (block sizes, not requested sizes)
+        std::size_t bytesReserved{0};       // in slabs
+
+        double hitRate() const noexcept { return acquires ? static_cast<double>(threadCacheHits) / acquires : 0.0; }
+    };
+
+    BufferPool()
+        : m_id{nextPoolId()}
+    {
+        std::lock_guard lock{registry().mutex};
+        registry().live.push_back(m_id);
+    }
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    ~BufferPool()
+    {
+        {
+            auto& reg = registry();
+            std::lock_guard lock{reg.mutex};
+            reg.live.erase(std::remove(reg.live.begin(), reg.live.end(), m_id), reg.live.end());
+        }
+        for(auto& cls : m_classes)
+        {
+            for(auto& slab : cls.slabs)
+            {
+                ::operator delete(slab.first, std::align_val_t{slab.second});
+            }
+        }
+    }
+
+    // a slice of size bytes in a block of at least size bytes:
+    ByteSlice acquire(std::size_t size)
+    {
+        m_acquires.fetch_add(1, std::memory_order_relaxed);
+        auto* ctrl = static_cast<ControlBlock*>(static_cast<void*>(allocateBlock(0, false)));
+        std::size_t cls = sizeClass(size);
+        std::byte* data;
+        std::size_t capacity;
+        try {
+            if(cls < numSizeClasses)
+            {
+                data = allocateBlock(cls, true);
+                capacity = blockSize(cls);
+            }
+            else
+            {
+                m_directAllocations.fetch_add(1, std::memory_order_relaxed);
+                capacity = (size + buffer_pool_detail::pageSize - 1) & ~(buffer_pool_detail::pageSize - 1);
+                data = static_cast<std::byte*>(::operator new(capacity, std::align_val_t{buffer_pool_detail::pageSize}));
+            }
+        }
+        catch(...) {
+            freeBlock(0, reinterpret_cast<std::byte*>(ctrl));
+            throw;
+        }
+        m_bytesInUse.fetch_add(capacity, std::memory_order_relaxed);
+        ::new(ctrl) ControlBlock{ {1}, static_cast<std::uint32_t>(cls), capacity, data, this };
+        return ByteSlice{ ctrl, size };
+    }
+
+    Stats stats() const noexcept
+    {
+        Stats s;
+        s.acquires = m_acquires.load(std::memory_order_relaxed);
+        s.threadCacheHits = m_threadCacheHits.load(std::memory_order_relaxed);
+        s.centralHits = m_centralHits.load(std::memory_order_relaxed);
+        s.slabAllocations = m_slabAllocations.load(std::memory_order_relaxed);
+        s.directAllocations = m_directAllocations.load(std::memory_order_relaxed);
+        s.bytesInUse = m_bytesInUse.load(std::memory_order_relaxed);
+        s.bytesReserved = m_bytesReserved.load(std::memory_order_relaxed);
+        return s;
+    }
+
+    static constexpr std::size_t blockSize(std::size_t cls) noexcept { return minBlockSize << cls; }
+
+    // numSizeClasses if size is larger than maxBlockSize:
+    static std::size_t sizeClass(std::size_t size) noexcept
+    {
+        if(size <= minBlockSize)
+        {
+            return 0;
+        }
+        if(size > maxBlockSize)
+        {
+            return numSizeClasses;
+        }
+        // ceil(log2(size)) - log2(minBlockSize):
+        return static_cast<std::size_t>(64 - __builtin_clzll(size - 1)) - 6;
+    }
+
+private:
+    friend class ByteSlice;
+
+    struct ThreadCache {
+        std::array<std::vector<std::byte*>, numSizeClasses> blocks;
+    };
+
+    struct SizeClass {
+        std::mutex mutex;
+        std::vector<std::byte*> freeList;  // reserved for all numBlocks, so returning blocks never allocates
+        std::size_t numBlocks{0};          // in all slabs
+        std::vector<std::pair<std::byte*, std::size_t>> slabs;  // address and alignment
+    };
+
+    // pools alive, so that exiting threads only return their cached blocks to live pools:
+    struct Registry {
+        std::mutex mutex;
+        std::vector<std::uint64_t> live;
+    };
+
+    static Registry& registry()
+    {
+        static Registry reg;
+        return reg;
+    }
+
+    static std::uint64_t nextPoolId() noexcept
+    {
+        static std::atomic<std::uint64_t> next{1};
+        return next.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // the caches of one thread for all pools it used:
+    struct ThreadCaches {
+        struct Entry {
+            std::uint64_t poolId;
+            BufferPool* pool;
+            ThreadCache* cache;
+        };
+        std::vector<Entry> entries;
+
+        ~ThreadCaches()
+        {
+            auto& reg = registry();
+            std::lock_guard lock{reg.mutex};
+            for(auto& e : entries)
+            {
+                if(std::find(reg.live.begin(), reg.live.end(), e.poolId) != reg.live.end())
+                {
+                    e.pool->retireCache(*e.cache);
+                }
+            }
+        }
+    };
+
+    static constexpr std::size_t cacheLimit(std::size_t cls) noexcept
+    {
+        // at most 256 KiB per size class and thread, but at least 4 blocks:
+        return std::max<std::size_t>(4, std::min<std::size_t>(64, (std::size_t{256} << 10) / blockSize(cls)));
+    }
+
+    static ThreadCaches& threadCaches() noexcept
+    {
+        thread_local ThreadCaches caches;
+        return caches;
+    }
+
+    // nullptr if this thread hasn't acquired from the pool yet:
+    ThreadCache* findThreadCache() noexcept
+    {
+        for(auto& e : threadCaches().entries)
+        {
+            if(e.poolId == m_id)
+            {
+                return e.cache;
+            }
+        }
+        return nullptr;
+    }
+
+    ThreadCache& threadCache()
+    {
+        if(auto* cache = findThreadCache())
+        {
+            return *cache;
+        }
+        auto& entries = threadCaches().entries;
+        entries.reserve(entries.size() + 1);
+        std::lock_guard lock{m_cachesMutex};
+        ThreadCache* cache;
+        if(!m_freeCaches.empty())
+        {
+            // of an exited thread, drained and still with its reserved capacity:
+            cache = m_freeCaches.back();
+            m_freeCaches.pop_back();
+        }
+        else
+        {
+            auto& owned = m_caches.emplace_back(std::make_unique<ThreadCache>());
+            // freeBlock() never reallocates, so releasing a slice doesn't allocate:
+            for(std::size_t cls{0}; cls < numSizeClasses; ++cls)
+            {
+                owned->blocks[cls].reserve(cacheLimit(cls) + 1);
+            }
+            // retireCache() doesn't allocate either:
+            m_freeCaches.reserve(m_caches.size());
+            cache = owned.get();
+        }
+        entries.push_back({ m_id, this, cache });
+        return *cache;
+    }
+
+    // countHit is false for control blocks, so that the stats only count data blocks:
+    std::byte* allocateBlock(std::size_t cls, bool countHit)
+    {
+        auto& cached = threadCache().blocks[cls];
+        if(!cached.empty())
+        {
+            if(countHit)
+            {
+                m_threadCacheHits.fetch_add(1, std::memory_order_relaxed);
+            }
+            std::byte* p = cached.back();
+            cached.pop_back();
+            return p;
+        }
+        // refill half of the cache from the central list, adding a slab if necessary:
+        auto& sc = m_classes[cls];
+        std::lock_guard lock{sc.mutex};
+        if(sc.freeList.empty())
+        {
+            addSlab(cls);
+        }
+        else if(countHit)
+        {
+            m_centralHits.fetch_add(1, std::memory_order_relaxed);
+        }
+        std::size_t n = std::min(sc.freeList.size(), cacheLimit(cls) / 2 + 1);
+        cached.insert(cached.end(), sc.freeList.end() - n, sc.freeList.end());
+        sc.freeList.resize(sc.freeList.size() - n);
+        std::byte* p = cached.back();
+        cached.pop_back();
+        return p;
+    }
+
+    // doesn't allocate, so that ByteSlice::reset() can be noexcept: the thread cache has room for
+    // one block more than its limit, the central list for all blocks of the class, and a thread
+    // without a cache for this pool (e.g. a consumer that never acquires) doesn't get one here:
+    void freeBlock(std::size_t cls, std::byte* p) noexcept
+    {
+        auto& sc = m_classes[cls];
+        ThreadCache* cache = findThreadCache();
+        if(!cache)
+        {
+            std::lock_guard lock{sc.mutex};
+            sc.freeList.push_back(p);
+            return;
+        }
+        auto& cached = cache->blocks[cls];
+        if(cached.size() >= cacheLimit(cls))
+        {
+            // return half of the cache in one batch:
+            std::size_t n = cached.size() / 2;
+            std::lock_guard lock{sc.mutex};
+            sc.freeList.insert(sc.freeList.end(), cached.end() - n, cached.end());
+            cached.resize(cached.size() - n);
+        }
+        cached.push_back(p);
+    }
+
+    // called with the size class locked:
+    void addSlab(std::size_t cls)
+    {
+        std::size_t bs = blockSize(cls);
+        std::size_t slabBytes = std::max<std::size_t>(std::size_t{64} << 10, 4 * bs);
+        std::size_t align = std::min(bs, buffer_pool_detail::pageSize);
+        auto& sc = m_classes[cls];
+        // reserved before the slab is allocated, so that nothing leaks if this throws:
+        sc.freeList.reserve(sc.numBlocks + slabBytes / bs);
+        sc.slabs.reserve(sc.slabs.size() + 1);
+        auto* slab = static_cast<std::byte*>(::operator new(slabBytes, std::align_val_t{align}));
+        sc.slabs.emplace_back(slab, align);
+        sc.numBlocks += slabBytes / bs;
+        for(std::size_t off = slabBytes; off >= bs; off -= bs)
+        {
+            sc.freeList.push_back(slab + off - bs);  // lowest address is handed out first
+        }
+        m_slabAllocations.fetch_add(1, std::memory_order_relaxed);
+        m_bytesReserved.fetch_add(slabBytes, std::memory_order_relaxed);
+    }
+
+    void drainCache(ThreadCache& cache)
+    {
+        for(std::size_t cls{0}; cls < numSizeClasses; ++cls)
+        {
+            auto& sc = m_classes[cls];
+            std::lock_guard lock{sc.mutex};
+            sc.freeList.insert(sc.freeList.end(), cache.blocks[cls].begin(), cache.blocks[cls].end());
+            cache.blocks[cls].clear();
+        }
+    }
+
+    // called when the thread owning the cache exits:
+    void retireCache(ThreadCache& cache)
+    {
+        drainCache(cache);
+        std::lock_guard lock{m_cachesMutex};
+        m_freeCaches.push_back(&cache);
+    }
+
+    void release(ControlBlock* ctrl) noexcept
+    {
+        m_bytesInUse.fetch_sub(ctrl->capacity, std::memory_order_relaxed);
+        if(ctrl->sizeClass < numSizeClasses)
+        {
+            freeBlock(ctrl->sizeClass, ctrl->data);
+        }
+        else
+        {
+            ::operator delete(ctrl->data, std::align_val_t{buffer_pool_detail::pageSize});
+        }
+        ctrl->~ControlBlock();
+        freeBlock(0, reinterpret_cast<std::byte*>(ctrl));
+    }
+
+    const std::uint64_t m_id;
+    std::array<SizeClass, numSizeClasses> m_classes;
+    std::mutex m_cachesMutex;
+    std::vector<std::unique_ptr<ThreadCache>> m_caches;
+    std::vector<ThreadCache*> m_freeCaches;  // of exited threads, to be reused
+
+    std::atomic<std::uint64_t> m_acquires{0};
+    std::atomic<std::uint64_t> m_threadCacheHits{0};
+    std::atomic<std::uint64_t> m_centralHits{0};
+    std::atomic<std::uint64_t> m_slabAllocations{0};
+    std::atomic<std::uint64_t> m_directAllocations{0};
+    std::atomic<std::size_t> m_bytesInUse{0};
+    std::atomic<std::size_t> m_bytesReserved{0};
+};
+
+inline void ByteSlice::reset() noexcept
+{
+    if(m_ctrl && m_ctrl->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        m_ctrl->pool->release(m_ctrl);
+    }
+    m_ctrl = nullptr;
+    m_data = nullptr;
+    m_size = 0;
+}
@@ -5,6 +5,14 @@
 #include <complex>
 #include <set>
 #include <cstddef>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <bitset>
+#include <algorithm>
+#include <thread>
+#include "buffer_pool.h"
+#include "bit_kernels.h"
 
 /*
 std::byte
@@ -15,6 +23,180 @@ std::byte
     The only “computing” operations supported are bit-wise operators.
 */
 
+template<typename T>
+double diff(const T& t0, const T& t1)
+{
+    return std::chrono::duration<double, std::milli>(t1 - t0).count();
+}
+
+void bufferPoolPerformance()
+{
+    /*
+    A read loop that allocates a fresh std::vector<char> per read pays for the allocation
+    and for zero-initializing the buffer. BufferPool (see buffer_pool.h) hands out aligned
+    std::byte blocks from per-thread caches, and slices share a block without copying.
+    */
+    const std::size_t numReads{1'000'000};
+    const int numThreads{4};
+
+    auto readLoop = [&](auto getBuffer) {
+        std::vector<std::thread> threads;
+        std::atomic<std::size_t> checksum{0};
+        for(int t{0}; t < numThreads; ++t)
+        {
+            threads.emplace_back([&, t] {
+                std::mt19937 eng(t);
+                std::size_t sum{0};
+                for(std::size_t i{0}; i < numReads / numThreads; ++i)
+                {
+                    std::size_t size = std::size_t{512} << (eng() % 8);  // 512 bytes .. 64 KiB
+                    sum += getBuffer(size);
+                }
+                checksum += sum;
+            });
+        }
+        for(auto& t : threads)
+        {
+            t.join();
+        }
+        return checksum.load();
+    };
+
+    BufferPool pool;
+    for(int i{0}; i < 3; ++i)
+    {
+        auto t0 = std::chrono::steady_clock::now();
+        auto sum1 = readLoop([](std::size_t size) {
+            std::vector<char> buf(size);
+            std::memset(buf.data(), 1, 256);  // the "read"
+            return static_cast<std::size_t>(buf[size / 2 % 256]) + buf.size();
+        });
+        auto t1 = std::chrono::steady_clock::now();
+        auto sum2 = readLoop([&](std::size_t size) {
+            ByteSlice buf = pool.acquire(size);
+            std::memset(buf.data(), 1, 256);
+            return std::to_integer<std::size_t>(buf[size / 2 % 256]) + buf.size();
+        });
+        auto t2 = std::chrono::steady_clock::now();
+        std::cout << "vector<char> per read: " << diff(t0, t1) << "ms, BufferPool: " << diff(t1, t2) << "ms"
+                  << (sum1 != sum2 ? " ERROR: different results" : "") << '\n';
+    }
+
+    // zero-copy sharing: a message and its header/payload views share one block
+    ByteSlice msg = pool.acquire(10'000);
+    ByteSlice header = msg.slice(0, 16);
+    ByteSlice payload = msg.slice(16, msg.size() - 16);
+    msg.reset();
+    std::cout << "payload shares the block with " << payload.use_count() - 1 << " other slice, 4 KiB aligned: "
+              << (reinterpret_cast<std::uintptr_t>(header.data()) % 4096 == 0) << '\n';
+
+    auto st = pool.stats();
+    std::cout << "acquires: " << st.acquires << ", thread cache hit rate: " << st.hitRate() * 100 << "%, central hits: " << st.centralHits
+              << ", slabs: " << st.slabAllocations << ", bytes in use: " << st.bytesInUse << ", reserved: " << st.bytesReserved / 1024 << " KiB\n";
+}
+
+void bitKernelsPerformance()
+{
+    /*
+    The std::byte operators work on one byte at a time. For masks and fingerprints of many
+    kilobytes or megabytes the kernels in bit_kernels.h process 8 (scalar), 32 (AVX2) or
+    64 (AVX-512) bytes per instruction. GB/s is the size of one operand per second;
+    a 64 KiB bitmap stays in the cache, a 16 MiB one is limited by memory bandwidth.
+    */
+    namespace bk = bit_kernels_detail;
+    std::mt19937_64 eng(42);
+
+    for(std::size_t size : {std::size_t{64} << 10, std::size_t{16} << 20})
+    {
+        std::vector<std::byte> a(size), b(size), dst(size);
+        for(std::size_t i{0}; i < size; ++i)
+        {
+            a[i] = std::byte(eng());
+            b[i] = std::byte(eng());
+        }
+        // read through a volatile pointer, so that pure kernels aren't hoisted out of the loop:
+        const std::byte* volatile pa = a.data();
+        const std::size_t reps = std::max<std::size_t>(1, (std::size_t{2} << 30) / size);
+        std::size_t sink{0};
+
+        auto measure = [&](const char* name, auto f) {
+            f();  // warm up
+            auto t0 = std::chrono::steady_clock::now();
+            for(std::size_t r{0}; r < reps; ++r)
+            {
+                f();
+            }
+            auto t1 = std::chrono::steady_clock::now();
+            std::cout << "  " << name << ": " << static_cast<double>(size * reps) / (diff(t0, t1) * 1e6) << " GB/s\n";
+        };
+
+        std::cout << "bitmap of " << size / 1024 << " KiB:\n";
+        measure("xor  byte loop", [&] {
+            for(std::size_t i{0}; i < size; ++i)
+            {
+                dst[i] = a[i] ^ b[i];
+            }
+        });
+        measure("xor  scalar   ", [&] { bk::binaryScalar<bk::Op::Xor>(dst.data(), a.data(), b.data(), size); });
+#ifdef BIT_KERNELS_HAVE_X86
+        if(bk::haveAvx2()) {
+            measure("xor  AVX2     ", [&] { bk::binaryAvx2<bk::Op::Xor>(dst.data(), a.data(), b.data(), size); });
+        }
+        if(bk::haveAvx512()) {
+            measure("xor  AVX-512  ", [&] { bk::binaryAvx512<bk::Op::Xor>(dst.data(), a.data(), b.data(), size); });
+        }
+#endif
+        measure("popcount byte loop", [&] {
+            for(std::size_t i{0}; i < size; ++i)
+            {
+                sink += std::bitset<8>(std::to_integer<unsigned>(a[i])).count();
+            }
+        });
+        measure("popcount scalar   ", [&] { sink += bk::popcountScalar(pa, size); });
+#ifdef BIT_KERNELS_HAVE_X86
+        if(bk::haveAvx2()) {
+            measure("popcount AVX2     ", [&] { sink += bk::popcountAvx2(pa, size); });
+        }
+        if(bk::haveAvx512Popcount()) {
+            measure("popcount AVX-512  ", [&] { sink += bk::popcountAvx512(pa, size); });
+        }
+#endif
+        measure("shift by 3 bits (dispatched)", [&] { shiftLeftBits(dst.data(), a.data(), size, 3); });
+        // a single set bit at the end: the whole bitmap is scanned
+        std::vector<std::byte> sparse(size);
+        sparse[size - 1] = std::byte{0x80};
+        const std::byte* volatile ps = sparse.data();
+        measure("findFirstSet (dispatched)   ", [&] { sink += findFirstSet(ps, size).value_or(0); });
+
+        // random rank/select queries, bitmap size in GB/s doesn't make sense here:
+        BitRankIndex index(a.data(), size);
+        std::vector<std::size_t> queries(1'000'000);
+        for(auto& q : queries)
+        {
+            q = eng() % index.count();
+        }
+        const std::size_t numScans{1000};
+        auto t0 = std::chrono::steady_clock::now();
+        for(std::size_t i{0}; i < numScans; ++i)
+        {
+            sink += *selectBit(a.data(), size, queries[i]);
+        }
+        auto t1 = std::chrono::steady_clock::now();
+        for(auto q : queries)
+        {
+            sink += *index.select(q);
+        }
+        auto t2 = std::chrono::steady_clock::now();
+        for(auto q : queries)
+        {
+            sink += index.rank(q);
+        }
+        auto t3 = std::chrono::steady_clock::now();
+        std::cout << "  select() scanning: " << diff(t0, t1) * 1e6 / numScans << "ns, with BitRankIndex: " << diff(t1, t2) * 1e6 / queries.size()
+                  << "ns, rank() with BitRankIndex: " << diff(t2, t3) * 1e6 / queries.size() << "ns per query (" << sink % 2 << ")\n";
+    }
+}
+
 int main()
 {
     std::byte b1{0x3F};
@@ -47,6 +229,9 @@ int main()
     // As usual (except for atomics), you can force an initialization with all bits set to zero with list initialization:
     std::byte b{}; // same as bf0g
 
+    // bufferPoolPerformance();
+    // bitKernelsPerformance();
+
     //Such a conversion is also necessary to use a std::byte as a Boolean value. For example:
     // if (b2 // ERROR
     if (b2 != std::byte{0})  // OK
@@ -3,6 +3,12 @@
 #include <optional>
 #include <string_view>
 #include <charconv> // for from_chars()
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <vector>
+#include "output_sink.h"
+#include "utf8_validate.h"
 
 /*
     With C++17, a special string class was adopted by the C++ standard library, that allows us to deal
@@ -82,6 +88,131 @@ void printElems(const T& coll, std::string_view prefix = std::string_view{})
     */
 }
 
+// same as above, but written to a buffered sink instead of element by element to std::cout:
+template<typename T>
+void printElems(OutputSink& out, const T& coll, std::string_view prefix = std::string_view{})
+{
+    for(const auto& elem : coll)
+    {
+        if(prefix.data()){ // check against nullptr
+            out << prefix << ' ';
+        }
+        out << elem << '\n';
+    }
+}
+
+void using_output_sink()
+{
+    /*
+    Dumping many elements with operator<< to std::cout costs a virtual call, locale handling and a
+    sync check per item. OutputSink collects the output in one large buffer, formats numbers
+    with std::to_chars() and appends string views without copying them into temporary strings.
+    Run with stdout redirected (e.g. > /dev/null), the results are printed to std::cerr.
+    */
+    const std::size_t numElems{10'000'000};
+    std::vector<long> ints(numElems);
+    std::vector<double> doubles(numElems);
+    for(std::size_t i{0}; i < numElems; ++i)
+    {
+        ints[i] = static_cast<long>(i * 7919);
+        doubles[i] = static_cast<double>(i) * 0.37;
+    }
+
+    auto report = [](std::string_view name, std::size_t bytes, auto t0, auto t1) {
+        std::chrono::duration<double> secs{t1 - t0};
+        std::cerr << name << bytes / secs.count() / (1024 * 1024) << " MiB/s (" << secs.count() * 1000 << "ms)\n";
+    };
+
+    // std::cout:
+    auto t0 = std::chrono::steady_clock::now();
+    for(auto i : ints)
+    {
+        std::cout << "int " << i << '\n';
+    }
+    for(auto d : doubles)
+    {
+        std::cout << "dbl " << d << '\n';
+    }
+    std::cout.flush();
+    auto t1 = std::chrono::steady_clock::now();
+
+    // printf(), counting the bytes it writes; operator<< with the default precision 6 formats
+    // as %ld and %g, so std::cout writes the same number of bytes:
+    std::size_t printfBytes{0};
+    for(auto i : ints)
+    {
+        printfBytes += static_cast<std::size_t>(std::printf("int %ld\n", i));
+    }
+    for(auto d : doubles)
+    {
+        printfBytes += static_cast<std::size_t>(std::printf("dbl %g\n", d));
+    }
+    std::fflush(stdout);
+    auto t2 = std::chrono::steady_clock::now();
+
+    // OutputSink (note: doubles are printed as shortest round trip, not with precision 6):
+    std::size_t sinkBytes{0};
+    {
+        OutputSink out;
+        printElems(out, ints, "int");
+        printElems(out, doubles, "dbl");
+        out.flush();
+        sinkBytes = out.bytesWritten();
+    }
+    auto t3 = std::chrono::steady_clock::now();
+
+    report("std::cout:  ", printfBytes, t0, t1);
+    report("printf():   ", printfBytes, t1, t2);
+    report("OutputSink: ", sinkBytes, t2, t3);
+}
+
+void using_utf8_validation()
+{
+    /*
+    String views over mapped or received data don't say anything about the bytes they refer to.
+    Before parsing such data as text, validate it. validateUtf8() checks 32 bytes per step
+    with AVX2 (if available) and returns the offset of the first invalid sequence.
+    */
+    std::string_view good{"gr\xC3\xBC\xC3\x9F dich \xE2\x82\xAC \xF0\x9F\x98\x80"};
+    std::string_view bad{"gr\xC3\xBC\xC3 dich"};  // truncated 2 byte sequence at offset 4
+    for(auto sv : {good, bad}) {
+        if(auto err = validateUtf8(sv); err) {
+            std::cout << "invalid UTF-8 at offset " << *err << '\n';
+        }
+        else {
+            std::cout << "valid UTF-8: " << sv << '\n';
+        }
+    }
+
+    // a stream can be validated chunk by chunk, sequences may be split across chunks:
+    Utf8Validator v;
+    v.feed(good.substr(0, 3));
+    v.feed(good.substr(3));
+    std::cout << "stream valid: " << std::boolalpha << !v.finish() << '\n';
+
+    // throughput for 256 MiB of mixed text:
+    std::vector<std::string_view> pieces{"plain ascii text ", "\xC3\xA4\xC3\xB6\xC3\xBC ", "\xE2\x82\xAC ", "\xF0\x9F\x98\x80 "};
+    std::string text;
+    text.reserve(256 * 1024 * 1024);
+    for(std::size_t i{0}; text.size() < 256 * 1024 * 1024; ++i)
+    {
+        text += pieces[i % 7 < 4 ? 0 : i % 4];
+    }
+    for(int i{0}; i < 5; ++i)
+    {
+        auto t0 = std::chrono::steady_clock::now();
+        auto r1 = validateUtf8Scalar(text);
+        auto t1 = std::chrono::steady_clock::now();
+        auto r2 = validateUtf8(text);
+        auto t2 = std::chrono::steady_clock::now();
+        std::chrono::duration<double> scalar{t1 - t0};
+        std::chrono::duration<double> simd{t2 - t1};
+        std::cout << "scalar loop: " << text.size() / scalar.count() / 1e9 << " GB/s, "
+                  << "validateUtf8(): " << text.size() / simd.count() / 1e9 << " GB/s"
+                  << (r1 || r2 ? " (unexpected error)" : "") << '\n';
+    }
+}
+
 // convert string to int if possible:
 std::optional<int> asInt(std::string_view sv)
 {
@@ -219,36 +350,40 @@ void initializeStrings()
 }
 
 
-void usingStringViewsInsteadOfString()
+// the classic way:
+std::string toString(const std::string& prefix, const std::chrono::system_clock::time_point& tp)
 {
-    std::string toString(const std::string& prefix, const std::chrono::system_clock::time_point& tp)
-    {
-        auto rawtime = std::chrono::system_clock::to_time_t(tp);
-        std::string ts = std::ctime(&rawtime); // mote mot thread safe
+    auto rawtime = std::chrono::system_clock::to_time_t(tp);
+    std::string ts = std::ctime(&rawtime); // mote mot thread safe
 
-        ts.resize(ts.size()-1);
+    ts.resize(ts.size()-1);
 
-        return prefix + ts;
-    }
+    return prefix + ts;
+}
 
-    // you could implement the following:
-    std::string toString(std::string_view prefix, const std::chrono::system_clock::time_point& tp)
-    {
-        auto rawtime = std::chrono::system_clock::to_time_t(tp);
+// you could implement the following:
+std::string toString(std::string_view prefix, const std::chrono::system_clock::time_point& tp)
+{
+    auto rawtime = std::chrono::system_clock::to_time_t(tp);
 
-        std::string_view ts = std::ctime(&rawtime); // NOTE: not thread safe
-        ts.remove_suffix(1); // skip trailing newline
-        
+    std::string_view ts = std::ctime(&rawtime); // NOTE: not thread safe
+    ts.remove_suffix(1); // skip trailing newline
+    
 
-        return std::string(prefix) + ts; // unfortunately no operator + yet
+    return std::string(prefix).append(ts); // unfortunately no operator + yet
 
-        /*
-        Note that we can remove the trailing newline from the string, but that we can’t concatenate both string views
-        by simply calling operator+. Instead, we have to convert one of the operands to a std::string
-        (which unfortunately unnecessarily might allocate additional memory).
-        */
-    }
+    /*
+    Note that we can remove the trailing newline from the string, but that we can’t concatenate both string views
+    by simply calling operator+. Instead, we have to convert one of the operands to a std::string
+    (which unfortunately unnecessarily might allocate additional memory).
+    */
+}
 
+void usingStringViewsInsteadOfString()
+{
+    auto now = std::chrono::system_clock::now();
+    std::cout << toString(std::string{"std::string: "}, now) << '\n';
+    std::cout << toString(std::string_view{"std::string_view: "}, now) << '\n';
 }
 
 int main()
@@ -274,6 +409,8 @@ int main()
     construction();
     std::cout << "-----------------\n";
     modifyStringView();
+    // using_output_sink();
+    // using_utf8_validation();
 
     return 0;
 }  
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <charconv>
+#include <cerrno>
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <unistd.h>  // for write()
+
+/********************************************
+* OutputSink
+* buffered writer on a file descriptor without the per item costs of
+* std::ostream (virtual calls, locale, sync_with_stdio). Numbers are formatted
+* with std::to_chars() directly into the buffer, string views are appended
+* without intermediate strings.
+********************************************/
+
+enum class FlushPolicy
+{
+    WHEN_FULL,   // only flush when the buffer is full, on flush() and at destruction
+    EVERY_LINE,  // flush after each append that contains a newline
+    EVERY_WRITE  // flush after each append (for interactive output)
+};
+
+class OutputSink
+{
+public:
+    static constexpr std::size_t defaultCapacity = 1 << 20;
+
+    explicit OutputSink(int fd = STDOUT_FILENO, std::size_t capacity = defaultCapacity, FlushPolicy policy = FlushPolicy::WHEN_FULL)
+        : m_fd{fd}, m_capacity{capacity < 64 ? 64 : capacity}, m_buf{new char[m_capacity]}, m_policy{policy}{}
+
+    OutputSink(const OutputSink&) = delete;
+    OutputSink& operator=(const OutputSink&) = delete;
+
+    ~OutputSink()
+    {
+        try {
+            flush();
+        }
+        catch(...) {
+            // nothing sensible to do in a destructor
+        }
+    }
+
+    void setPolicy(FlushPolicy policy) noexcept { m_policy = policy; }
+    std::size_t bytesWritten() const noexcept { return m_written + m_size; }
+
+    OutputSink& append(std::string_view sv)
+    {
+        if(sv.size() > m_capacity - m_size)
+        {
+            flush();
+            if(sv.size() >= m_capacity)
+            {
+                // too large to buffer: write it directly
+                writeAll(sv.data(), sv.size());
+                return *this;
+            }
+        }
+        std::char_traits<char>::copy(m_buf.get() + m_size, sv.data(), sv.size());
+        m_size += sv.size();
+        applyPolicy(sv.find('\n') != std::string_view::npos);
+        return *this;
+    }
+
+    OutputSink& append(char c)
+    {
+        if(m_size == m_capacity)
+        {
+            flush();
+        }
+        m_buf[m_size++] = c;
+        applyPolicy(c == '\n');
+        return *this;
+    }
+
+    template<typename T, typename = std::enable_if_t<std::is_arithmetic_v<T> && !std::is_same_v<T, bool> && !std::is_same_v<T, char>>>
+    OutputSink& append(T val)
+    {
+        // enough for any integer and the shortest round trip representation of any double:
+        constexpr std::size_t maxChars = 64;
+        if(m_capacity - m_size < maxChars)
+        {
+            flush();
+        }
+        auto [ptr, ec] = std::to_chars(m_buf.get() + m_size, m_buf.get() + m_capacity, val);
+        if(ec != std::errc{})
+        {
+            throw std::system_error{std::make_error_code(ec), "OutputSink: to_chars() failed"};
+        }
+        m_size = static_cast<std::size_t>(ptr - m_buf.get());
+        applyPolicy(false);
+        return *this;
+    }
+
+    OutputSink& append(bool b)
+    {
+        return append(b ? std::string_view{"true"} : std::string_view{"false"});
+    }
+
+    template<typename T>
+    OutputSink& operator<<(const T& val)
+    {
+        if constexpr(std::is_arithmetic_v<T>) {
+            return append(val);
+        }
+        else {
+            return append(std::string_view{val});
+        }
+    }
+
+    void flush()
+    {
+        if(m_size > 0)
+        {
+            // reset first, so that a failing write doesn't retry forever from the destructor:
+            auto n = m_size;
+            m_size = 0;
+            writeAll(m_buf.get(), n);
+        }
+    }
+
+private:
+    void applyPolicy(bool hadNewline)
+    {
+        if(m_policy == FlushPolicy::EVERY_WRITE || (m_policy == FlushPolicy::EVERY_LINE && hadNewline))
+        {
+            flush();
+        }
+    }
+
+    void writeAll(const char* p, std::size_t n)
+    {
+        while(n > 0)
+        {
+            auto ret = ::write(m_fd, p, n);
+            if(ret < 0)
+            {
+                if(errno == EINTR)
+                {
+                    continue;
+                }
+                throw std::system_error{errno, std::generic_category(), "OutputSink: write() failed"};
+            }
+            p += ret;
+            n -= static_cast<std::size_t>(ret);
+            m_written += static_cast<std::size_t>(ret);
+        }
+    }
+
+    int m_fd;
+    std::size_t m_capacity;
+    std::unique_ptr<char[]> m_buf;
+    std::size_t m_size{0};
+    std::size_t m_written{0};
+    FlushPolicy m_policy;
+};
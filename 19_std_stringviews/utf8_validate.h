@@ -0,0 +1,373 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string_view>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define UTF8_HAVE_AVX2_KERNEL 1
+#endif
+
+/********************************************
+* UTF-8 validation for string views over external data.
+* validateUtf8() returns the offset of the first byte of the first invalid
+* sequence, or std::nullopt if the whole buffer is valid UTF-8.
+* The fast path classifies 32 bytes at once with three 16 entry lookup tables
+* (high nibble of the previous byte, low nibble of the previous byte, high
+* nibble of the current byte), following the approach of Keiser and Lemire,
+* "Validating UTF-8 In Less Than One Instruction Per Byte". It is used if the
+* CPU supports AVX2 (checked at run time), otherwise a scalar loop is used.
+* Utf8Validator validates a stream chunk by chunk and carries incomplete
+* sequences across chunk boundaries.
+********************************************/
+
+namespace utf8_detail {
+
+// number of bytes of the sequence starting with lead byte c (0 for invalid lead bytes):
+inline std::size_t sequenceLength(unsigned char c) noexcept
+{
+    if(c < 0x80) return 1;
+    if(c < 0xC2) return 0;  // continuation byte or overlong 2 byte lead
+    if(c < 0xE0) return 2;
+    if(c < 0xF0) return 3;
+    if(c < 0xF5) return 4;
+    return 0;
+}
+
+// validate one sequence at p (at most n bytes available), returns its length or 0 if invalid/incomplete:
+inline std::size_t validSequence(const unsigned char* p, std::size_t n) noexcept
+{
+    std::size_t len = sequenceLength(p[0]);
+    if(len == 0 || len > n)
+    {
+        return 0;
+    }
+    // the allowed range of the 2nd byte depends on the lead byte (no overlongs, surrogates or > U+10FFFF):
+    unsigned char lo{0x80};
+    unsigned char hi{0xBF};
+    switch(p[0])
+    {
+        case 0xE0: lo = 0xA0; break;
+        case 0xED: hi = 0x9F; break;
+        case 0xF0: lo = 0x90; break;
+        case 0xF4: hi = 0x8F; break;
+        default: break;
+    }
+    if(len > 1 && (p[1] < lo || p[1] > hi))
+    {
+        return 0;
+    }
+    for(std::size_t i{2}; i < len; ++i)
+    {
+        if((p[i] & 0xC0) != 0x80)
+        {
+            return 0;
+        }
+    }
+    return len;
+}
+
+// byte by byte validation starting at offset pos:
+inline std::optional<std::size_t> validateScalar(const unsigned char* p, std::size_t n, std::size_t pos = 0) noexcept
+{
+    while(pos < n)
+    {
+        // skip ASCII 8 bytes at a time:
+        if(pos + 8 <= n)
+        {
+            std::uint64_t w;
+            std::memcpy(&w, p + pos, 8);
+            if((w & 0x8080808080808080ull) == 0)
+            {
+                pos += 8;
+                continue;
+            }
+        }
+        auto len = validSequence(p + pos, n - pos);
+        if(len == 0)
+        {
+            return pos;
+        }
+        pos += len;
+    }
+    return std::nullopt;
+}
+
+// restart point for the scalar loop: the start of the character containing pos
+inline std::size_t characterStart(const unsigned char* p, std::size_t pos) noexcept
+{
+    for(int i{0}; i < 3 && pos > 0 && (p[pos] & 0xC0) == 0x80; ++i)
+    {
+        --pos;
+    }
+    return pos;
+}
+
+// restart point for the scalar loop after the vectorized blocks before pos were checked:
+// the start of the character containing the last byte before pos
+inline std::size_t restartPoint(const unsigned char* p, std::size_t pos) noexcept
+{
+    return pos == 0 ? 0 : characterStart(p, pos - 1);
+}
+
+#ifdef UTF8_HAVE_AVX2_KERNEL
+
+// error classes, the names describe the pair (previous byte, current byte):
+constexpr std::uint8_t TOO_SHORT = 1 << 0;       // 11______ 0_______ or 11______ 11______
+constexpr std::uint8_t TOO_LONG = 1 << 1;        // 0_______ 10______
+constexpr std::uint8_t OVERLONG_3 = 1 << 2;      // 11100000 100_____
+constexpr std::uint8_t TOO_LARGE = 1 << 3;       // 11110100 1001____, 11110100 101_____, 11110101+ ________
+constexpr std::uint8_t SURROGATE = 1 << 4;       // 11101101 101_____
+constexpr std::uint8_t OVERLONG_2 = 1 << 5;      // 1100000_ 10______
+constexpr std::uint8_t TOO_LARGE_1000 = 1 << 6;  // 11110101+ 1000____
+constexpr std::uint8_t OVERLONG_4 = 1 << 6;      // 11110000 1000____
+constexpr std::uint8_t TWO_CONTS = 1 << 7;       // 10______ 10______
+constexpr std::uint8_t CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS;
+
+__attribute__((target("avx2"))) inline __m256i lookup16(__m256i idx, const std::uint8_t (&table)[16]) noexcept
+{
+    __m128i t = _mm_loadu_si128(reinterpret_cast<const __m128i*>(table));
+    return _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(t), idx);
+}
+
+// the bytes of input shifted by N positions, filled from the end of prev:
+template<int N>
+__attribute__((target("avx2"))) inline __m256i prevBytes(__m256i input, __m256i prev) noexcept
+{
+    return _mm256_alignr_epi8(input, _mm256_permute2x128_si256(prev, input, 0x21), 16 - N);
+}
+
+__attribute__((target("avx2"))) inline __m256i checkBlock(__m256i input, __m256i prevInput) noexcept
+{
+    static constexpr std::uint8_t byte1High[16] = {
+        TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,  // 0_______
+        TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,                                      // 10______
+        TOO_SHORT | OVERLONG_2,                                                          // 1100____
+        TOO_SHORT,                                                                       // 1101____
+        TOO_SHORT | OVERLONG_3 | SURROGATE,                                              // 1110____
+        TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4                              // 1111____
+    };
+    static constexpr std::uint8_t byte1Low[16] = {
+        CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,             // ____0000
+        CARRY | OVERLONG_2,                                       // ____0001
+        CARRY, CARRY,                                             // ____001_
+        CARRY | TOO_LARGE,                                        // ____0100
+        CARRY | TOO_LARGE | TOO_LARGE_1000,                       // ____0101
+        CARRY | TOO_LARGE | TOO_LARGE_1000,                       // ____011_
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,                       // ____1___
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,           // ____1101
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000
+    };
+    static constexpr std::uint8_t byte2High[16] = {
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,  // 0_______
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,           // 1000____
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,                            // 1001____
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,                             // 101_____
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT                                              // 11______
+    };
+
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    __m256i prev1 = prevBytes<1>(input, prevInput);
+    __m256i sc = _mm256_and_si256(_mm256_and_si256(lookup16(_mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble), byte1High),
+                                                   lookup16(_mm256_and_si256(prev1, nibble), byte1Low)),
+                                  lookup16(_mm256_and_si256(_mm256_srli_epi16(input, 4), nibble), byte2High));
+
+    // 3rd and 4th bytes of a sequence must be continuations (and only these, which sc can't see):
+    __m256i prev2 = prevBytes<2>(input, prevInput);
+    __m256i prev3 = prevBytes<3>(input, prevInput);
+    __m256i isThird = _mm256_subs_epu8(prev2, _mm256_set1_epi8(static_cast<char>(0xE0 - 0x80)));
+    __m256i isFourth = _mm256_subs_epu8(prev3, _mm256_set1_epi8(static_cast<char>(0xF0 - 0x80)));
+    __m256i must23 = _mm256_and_si256(_mm256_or_si256(isThird, isFourth), _mm256_set1_epi8(static_cast<char>(0x80)));
+    return _mm256_xor_si256(must23, sc);
+}
+
+// non-zero if the last bytes of the block start a sequence that continues in the next block:
+__attribute__((target("avx2"))) inline __m256i isIncomplete(__m256i input) noexcept
+{
+    const __m256i maxValue = _mm256_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                              -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                              static_cast<char>(0xF0 - 1), static_cast<char>(0xE0 - 1), static_cast<char>(0xC0 - 1));
+    return _mm256_subs_epu8(input, maxValue);
+}
+
+__attribute__((target("avx2"))) inline std::optional<std::size_t> validateAvx2(const unsigned char* p, std::size_t n) noexcept
+{
+    __m256i prevInput = _mm256_setzero_si256();
+    __m256i prevIncomplete = _mm256_setzero_si256();
+    std::size_t pos{0};
+    for(; pos + 32 <= n; pos += 32)
+    {
+        __m256i input = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + pos));
+        __m256i error;
+        if(_mm256_movemask_epi8(input) == 0)
+        {
+            // pure ASCII: only a sequence left open by the previous block is an error
+            error = prevIncomplete;
+            prevIncomplete = _mm256_setzero_si256();
+        }
+        else
+        {
+            error = checkBlock(input, prevInput);
+            prevIncomplete = isIncomplete(input);
+        }
+        if(!_mm256_testz_si256(error, error))
+        {
+            // everything before this block is valid, find the exact position byte by byte:
+            return validateScalar(p, n, restartPoint(p, pos));
+        }
+        prevInput = input;
+    }
+    // the tail and a sequence left open by the last block:
+    return validateScalar(p, n, restartPoint(p, pos));
+}
+
+inline bool haveAvx2() noexcept
+{
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+}
+
+#endif
+
+}  // namespace utf8_detail
+
+// offset of the first invalid sequence, std::nullopt if sv is valid UTF-8:
+inline std::optional<std::size_t> validateUtf8(std::string_view sv) noexcept
+{
+    auto p = reinterpret_cast<const unsigned char*>(sv.data());
+#ifdef UTF8_HAVE_AVX2_KERNEL
+    if(utf8_detail::haveAvx2())
+    {
+        return utf8_detail::validateAvx2(p, sv.size());
+    }
+#endif
+    return utf8_detail::validateScalar(p, sv.size());
+}
+
+// naive byte loop without vectorization, for comparison:
+inline std::optional<std::size_t> validateUtf8Scalar(std::string_view sv) noexcept
+{
+    return utf8_detail::validateScalar(reinterpret_cast<const unsigned char*>(sv.data()), sv.size());
+}
+
+/********************************************
+* Utf8Validator
+* streaming validation: feed() chunks of arbitrary size, a sequence split
+* across chunks is kept (at most 3 bytes) until the next chunk arrives.
+* Offsets are counted from the beginning of the stream. After the first
+* error the validator keeps reporting it.
+********************************************/
+
+class Utf8Validator
+{
+public:
+    // returns the stream offset of the first error found so far:
+    std::optional<std::size_t> feed(std::string_view chunk)
+    {
+        if(m_error)
+        {
+            return m_error;
+        }
+        auto p = reinterpret_cast<const unsigned char*>(chunk.data());
+        std::size_t n = chunk.size();
+        std::size_t pos{0};
+
+        // complete a sequence left open by the previous chunk:
+        if(m_pendingSize > 0)
+        {
+            std::size_t need = utf8_detail::sequenceLength(m_pending[0]) - m_pendingSize;
+            std::size_t take = need < n ? need : n;
+            std::memcpy(m_pending + m_pendingSize, p, take);
+            m_pendingSize += take;
+            pos = take;
+            if(take < need)
+            {
+                // still incomplete, unless the bytes so far are already wrong:
+                if(!prefixOk())
+                {
+                    m_error = m_offset - (m_pendingSize - take);
+                }
+                m_offset += n;
+                return m_error;
+            }
+            if(utf8_detail::validSequence(m_pending, m_pendingSize) == 0)
+            {
+                m_error = m_offset - (m_pendingSize - take);
+                return m_error;
+            }
+            m_pendingSize = 0;
+        }
+
+        // keep an incomplete sequence at the end for the next chunk:
+        std::size_t end = n;
+        if(n > pos)
+        {
+            std::size_t start = utf8_detail::characterStart(p, n - 1);
+            if(start >= pos && utf8_detail::sequenceLength(p[start]) > n - start)
+            {
+                end = start;
+            }
+        }
+
+        if(auto err = validateUtf8(std::string_view{chunk.data() + pos, end - pos}); err)
+        {
+            m_error = m_offset + pos + *err;
+            return m_error;
+        }
+        if(end < n)
+        {
+            m_pendingSize = n - end;
+            std::memcpy(m_pending, p + end, m_pendingSize);
+            if(!prefixOk())
+            {
+                m_error = m_offset + end;
+                return m_error;
+            }
+        }
+        m_offset += n;
+        return std::nullopt;
+    }
+
+    // end of stream: an open sequence is an error
+    std::optional<std::size_t> finish()
+    {
+        if(!m_error && m_pendingSize > 0)
+        {
+            m_error = m_offset - m_pendingSize;
+        }
+        return m_error;
+    }
+
+    void reset() noexcept { *this = Utf8Validator{}; }
+
+private:
+    // can the pending bytes still become a valid sequence?
+    bool prefixOk() const noexcept
+    {
+        unsigned char buf[4];
+        std::memcpy(buf, m_pending, m_pendingSize);
+        // complete with the smallest valid continuation for the lead byte:
+        unsigned char second = m_pending[0] == 0xE0 ? 0xA0 : (m_pending[0] == 0xF0 ? 0x90 : 0x80);
+        auto len = utf8_detail::sequenceLength(m_pending[0]);
+        for(std::size_t i = m_pendingSize; i < len; ++i)
+        {
+            buf[i] = i == 1 ? second : 0x80;
+        }
+        return len > 0 && utf8_detail::validSequence(buf, len) == len;
+    }
+
+    unsigned char m_pending[4]{};
+    std::size_t m_pendingSize{0};
+    std::size_t m_offset{0};  // stream offset of the current chunk
+    std::optional<std::size_t> m_error;
+};
@@ -0,0 +1,563 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+/*
+  BatchedFileIo
+  asynchronous open/read/write/fsync/close for many small files (Linux only):
+  - with io_uring (set up with the raw syscalls, no liburing needed), operations are
+    queued in the submission ring and handed to the kernel in batches by one
+    io_uring_enter() call
+  - if io_uring isn't available (old kernel, disabled by kernel.io_uring_disabled or a
+    seccomp filter) or lacks one of the opcodes used here (kernels before 5.6 have
+    io_uring, but no openat/read/write/close), a pool of threads runs
+    open/pread/pwrite/fsync/close instead
+  - registerBuffers(): buffers pinned once for readFixed()/writeFixed(), which saves
+    the kernel mapping the pages for each operation
+  - the result of an operation is what the syscall returns, or -errno on failure;
+    it is passed to a callback or to a std::future<int> (pass useFuture)
+  Callbacks run in the thread calling reap()/drain(), never concurrently, and may queue
+  further operations (e.g. the write after an open). Futures are only fulfilled by
+  reap()/drain() as well. Buffers and paths have to stay valid until completion
+  (paths are copied). One BatchedFileIo must only be used by one thread.
+*/
+
+enum class IoBackend { automatic, ioUring, threadPool };
+
+struct UseFuture {};
+inline constexpr UseFuture useFuture {};
+
+namespace batched_io_detail {
+
+enum class OpCode : std::uint8_t { open, read, write, readFixed, writeFixed, fsync, close };
+
+struct Op {
+  OpCode code { OpCode::close };
+  int fd { -1 };
+  int flags { 0 };
+  unsigned mode { 0 };
+  void* buf { nullptr };
+  std::size_t len { 0 };
+  std::uint64_t offset { 0 };
+  unsigned bufIndex { 0 };
+  std::string path;
+  std::function<void(int)> done;
+};
+
+inline unsigned loadAcquire(const unsigned* p) noexcept { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+inline void storeRelease(unsigned* p, unsigned v) noexcept { __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+
+// the rings shared with the kernel:
+class Ring {
+public:
+  // false if io_uring isn't available:
+  bool setup(unsigned entries) {
+    io_uring_params p {};
+    m_fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &p));
+    if (m_fd < 0) {
+      return false;
+    }
+    if (!supportsOps()) {
+      release();
+      errno = EOPNOTSUPP;
+      return false;
+    }
+    m_sqLen = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    m_cqLen = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    bool single { (p.features & IORING_FEAT_SINGLE_MMAP) != 0 };
+    if (single) {
+      m_sqLen = m_cqLen = std::max(m_sqLen, m_cqLen);
+    }
+    m_sq = ::mmap(nullptr, m_sqLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+    m_cq = single ? m_sq : ::mmap(nullptr, m_cqLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_CQ_RING);
+    m_sqesLen = p.sq_entries * sizeof(io_uring_sqe);
+    void* sqes { ::mmap(nullptr, m_sqesLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES) };
+    if (m_sq == MAP_FAILED || m_cq == MAP_FAILED || sqes == MAP_FAILED) {
+      m_sqes = sqes == MAP_FAILED ? nullptr : static_cast<io_uring_sqe*>(sqes);
+      release();
+      return false;
+    }
+    m_sqes = static_cast<io_uring_sqe*>(sqes);
+
+    auto* sq = static_cast<char*>(m_sq);
+    auto* cq = static_cast<char*>(m_cq);
+    m_sqHead = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+    m_sqTail = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+    m_sqMask = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+    m_sqEntries = p.sq_entries;
+    m_cqHead = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+    m_cqTail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+    m_cqMask = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+    m_cqEntries = p.cq_entries;
+    m_cqes = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+    // SQEs are used in ring order, so the indirection array is the identity:
+    auto* array = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+    for (unsigned i { 0 }; i < m_sqEntries; ++i) {
+      array[i] = i;
+    }
+    m_localTail = *m_sqTail;
+    return true;
+  }
+
+  ~Ring() { release(); }
+
+  // all opcodes used by BatchedFileIo; IORING_REGISTER_PROBE itself came with 5.6, so
+  // on 5.1-5.5 it fails, which also means the opcodes are missing:
+  bool supportsOps() const noexcept {
+    constexpr unsigned maxOps { 256 };
+    alignas(io_uring_probe) unsigned char buf[sizeof(io_uring_probe) + maxOps * sizeof(io_uring_probe_op)] {};
+    auto* probe { reinterpret_cast<io_uring_probe*>(buf) };
+    if (::syscall(__NR_io_uring_register, m_fd, IORING_REGISTER_PROBE, probe, maxOps) < 0) {
+      return false;
+    }
+    for (unsigned op : { IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_WRITE, IORING_OP_READ_FIXED,
+                         IORING_OP_WRITE_FIXED, IORING_OP_FSYNC, IORING_OP_CLOSE }) {
+      if (op >= probe->ops_len || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  int fd() const noexcept { return m_fd; }
+  unsigned cqEntries() const noexcept { return m_cqEntries; }
+
+  // the next free SQE, nullptr if the submission ring is full:
+  io_uring_sqe* nextSqe() noexcept {
+    if (m_localTail - loadAcquire(m_sqHead) == m_sqEntries) {
+      return nullptr;
+    }
+    io_uring_sqe* sqe { &m_sqes[m_localTail & m_sqMask] };
+    ++m_localTail;
+    ++m_unsubmitted;
+    return sqe;
+  }
+
+  // hands the queued SQEs to the kernel, waits for minComplete completions:
+  void enter(unsigned minComplete) {
+    storeRelease(m_sqTail, m_localTail);
+    for (;;) {
+      long ret { ::syscall(__NR_io_uring_enter, m_fd, m_unsubmitted, minComplete,
+                           minComplete ? IORING_ENTER_GETEVENTS : 0u, nullptr, 0) };
+      if (ret >= 0) {
+        m_unsubmitted -= static_cast<unsigned>(ret);
+        if (m_unsubmitted == 0 || minComplete != 0) {
+          return;
+        }
+      } else if (errno != EINTR) {
+        // EAGAIN/EBUSY: completions have to be reaped before more can be submitted
+        if (errno == EAGAIN || errno == EBUSY) {
+          return;
+        }
+        throw std::system_error(errno, std::system_category(), "io_uring_enter");
+      }
+    }
+  }
+
+  // f(user_data, res) for all available completions:
+  template<typename F>
+  unsigned forEachCompletion(F&& f) {
+    unsigned head { *m_cqHead };
+    unsigned tail { loadAcquire(m_cqTail) };
+    for (unsigned i { head }; i != tail; ++i) {
+      const io_uring_cqe& cqe { m_cqes[i & m_cqMask] };
+      f(cqe.user_data, cqe.res);
+    }
+    storeRelease(m_cqHead, tail);
+    return tail - head;
+  }
+
+  bool hasUnsubmitted() const noexcept { return m_unsubmitted != 0; }
+
+private:
+  void release() noexcept {
+    if (m_sqes) {
+      ::munmap(m_sqes, m_sqesLen);
+    }
+    if (m_cq && m_cq != MAP_FAILED && m_cq != m_sq) {
+      ::munmap(m_cq, m_cqLen);
+    }
+    if (m_sq && m_sq != MAP_FAILED) {
+      ::munmap(m_sq, m_sqLen);
+    }
+    if (m_fd >= 0) {
+      ::close(m_fd);
+    }
+    m_sqes = nullptr;
+    m_sq = m_cq = nullptr;
+    m_fd = -1;
+  }
+
+  int m_fd { -1 };
+  void* m_sq { nullptr };
+  void* m_cq { nullptr };
+  std::size_t m_sqLen { 0 };
+  std::size_t m_cqLen { 0 };
+  std::size_t m_sqesLen { 0 };
+  io_uring_sqe* m_sqes { nullptr };
+  unsigned* m_sqHead { nullptr };
+  unsigned* m_sqTail { nullptr };
+  unsigned m_sqMask { 0 };
+  unsigned m_sqEntries { 0 };
+  unsigned* m_cqHead { nullptr };
+  unsigned* m_cqTail { nullptr };
+  unsigned m_cqMask { 0 };
+  unsigned m_cqEntries { 0 };
+  io_uring_cqe* m_cqes { nullptr };
+  unsigned m_localTail { 0 };
+  unsigned m_unsubmitted { 0 };
+};
+
+// result of a syscall as io_uring reports it:
+inline int syscallResult(long ret) noexcept {
+  return ret < 0 ? -errno : static_cast<int>(ret);
+}
+
+}  // namespace batched_io_detail
+
+class BatchedFileIo {
+public:
+  using Completion = std::function<void(int res)>;
+
+  // queueDepth: submission ring size; up to twice as many operations may be in flight
+  explicit BatchedFileIo(unsigned queueDepth = 256, IoBackend backend = IoBackend::automatic,
+                         unsigned poolThreads = std::max(4u, std::thread::hardware_concurrency())) {
+    queueDepth = std::max(queueDepth, 2u);
+    if (backend != IoBackend::threadPool) {
+      auto ring = std::make_unique<batched_io_detail::Ring>();
+      if (ring->setup(queueDepth)) {
+        m_ring = std::move(ring);
+      } else if (backend == IoBackend::ioUring) {
+        throw std::system_error(errno, std::system_category(), "io_uring_setup");
+      }
+    }
+    std::size_t capacity { m_ring ? m_ring->cqEntries() : 2 * queueDepth };
+    m_ops.resize(capacity);
+    m_free.reserve(capacity);
+    for (std::size_t i { capacity }; i-- > 0;) {
+      m_free.push_back(static_cast<unsigned>(i));
+    }
+    if (!m_ring) {
+      for (unsigned i { 0 }; i < std::max(poolThreads, 1u); ++i) {
+        m_threads.emplace_back([this] { runPoolThread(); });
+      }
+    }
+  }
+
+  BatchedFileIo(const BatchedFileIo&) = delete;
+  BatchedFileIo& operator=(const BatchedFileIo&) = delete;
+
+  ~BatchedFileIo() {
+    try {
+      drain();
+    } catch (...) {
+    }
+    if (!m_threads.empty()) {
+      {
+        std::lock_guard<std::mutex> lock(m_poolMutex);
+        m_stop = true;
+      }
+      m_poolCv.notify_all();
+      for (auto& t : m_threads) {
+        t.join();
+      }
+    }
+  }
+
+  bool usingIoUring() const noexcept { return m_ring != nullptr; }
+  std::size_t inFlight() const noexcept { return m_inFlight; }
+
+  /******************** operations ********************/
+
+  void open(const std::string& path, int flags, unsigned mode, Completion done) {
+    auto& op = enqueue(batched_io_detail::OpCode::open, std::move(done));
+    op.path = path;
+    op.flags = flags | O_CLOEXEC;
+    op.mode = mode;
+    submitOp(op);
+  }
+
+  void read(int fd, void* buf, std::size_t len, std::uint64_t offset, Completion done) {
+    queueReadWrite(batched_io_detail::OpCode::read, fd, buf, len, offset, 0, std::move(done));
+  }
+
+  void write(int fd, const void* buf, std::size_t len, std::uint64_t offset, Completion done) {
+    queueReadWrite(batched_io_detail::OpCode::write, fd, const_cast<void*>(buf), len, offset, 0, std::move(done));
+  }
+
+  // into/from buffer bufIndex of registerBuffers(), starting at bufOffset:
+  void readFixed(int fd, unsigned bufIndex, std::size_t bufOffset, std::size_t len, std::uint64_t offset, Completion done) {
+    void* buf { static_cast<char*>(m_buffers.at(bufIndex).iov_base) + bufOffset };
+    queueReadWrite(batched_io_detail::OpCode::readFixed, fd, buf, len, offset, bufIndex, std::move(done));
+  }
+
+  void writeFixed(int fd, unsigned bufIndex, std::size_t bufOffset, std::size_t len, std::uint64_t offset, Completion done) {
+    void* buf { static_cast<char*>(m_buffers.at(bufIndex).iov_base) + bufOffset };
+    queueReadWrite(batched_io_detail::OpCode::writeFixed, fd, buf, len, offset, bufIndex, std::move(done));
+  }
+
+  void fsync(int fd, Completion done) {
+    auto& op = enqueue(batched_io_detail::OpCode::fsync, std::move(done));
+    op.fd = fd;
+    submitOp(op);
+  }
+
+  void close(int fd, Completion done = {}) {
+    auto& op = enqueue(batched_io_detail::OpCode::close, std::move(done));
+    op.fd = fd;
+    submitOp(op);
+  }
+
+  // the same operations with a future:
+  std::future<int> open(const std::string& path, int flags, unsigned mode, UseFuture) {
+    return withFuture([&](Completion c) { open(path, flags, mode, std::move(c)); });
+  }
+  std::future<int> read(int fd, void* buf, std::size_t len, std::uint64_t offset, UseFuture) {
+    return withFuture([&](Completion c) { read(fd, buf, len, offset, std::move(c)); });
+  }
+  std::future<int> write(int fd, const void* buf, std::size_t len, std::uint64_t offset, UseFuture) {
+    return withFuture([&](Completion c) { write(fd, buf, len, offset, std::move(c)); });
+  }
+  std::future<int> fsync(int fd, UseFuture) {
+    return withFuture([&](Completion c) { fsync(fd, std::move(c)); });
+  }
+  std::future<int> close(int fd, UseFuture) {
+    return withFuture([&](Completion c) { close(fd, std::move(c)); });
+  }
+
+  // pins the buffers for readFixed()/writeFixed(); replaces earlier registered buffers:
+  void registerBuffers(const std::vector<std::pair<void*, std::size_t>>& buffers) {
+    drain();
+    if (m_ring && !m_buffers.empty()) {
+      ::syscall(__NR_io_uring_register, m_ring->fd(), IORING_UNREGISTER_BUFFERS, nullptr, 0);
+    }
+    m_buffers.clear();
+    for (const auto& [ptr, size] : buffers) {
+      m_buffers.push_back(iovec { ptr, size });
+    }
+    if (m_ring && !m_buffers.empty() &&
+        ::syscall(__NR_io_uring_register, m_ring->fd(), IORING_REGISTER_BUFFERS, m_buffers.data(), m_buffers.size()) < 0) {
+      int err { errno };
+      m_buffers.clear();
+      throw std::system_error(err, std::system_category(), "io_uring_register(IORING_REGISTER_BUFFERS)");
+    }
+  }
+
+  /******************** completion ********************/
+
+  // submits queued operations, waits for at least minComplete completions and runs
+  // their callbacks; returns the number of completed operations:
+  std::size_t reap(unsigned minComplete = 0) {
+    minComplete = std::min<unsigned>(minComplete, static_cast<unsigned>(m_inFlight));
+    std::vector<std::pair<unsigned, int>> done;
+    if (m_ring) {
+      if (m_ring->hasUnsubmitted() || minComplete != 0) {
+        m_ring->enter(minComplete);
+      }
+      m_ring->forEachCompletion([&](std::uint64_t slot, int res) { done.emplace_back(static_cast<unsigned>(slot), res); });
+    } else {
+      std::unique_lock<std::mutex> lock(m_doneMutex);
+      m_doneCv.wait(lock, [&] { return m_done.size() >= minComplete; });
+      done.swap(m_done);
+    }
+    // free the slots first: the callbacks may queue new operations
+    std::vector<Completion> callbacks;
+    callbacks.reserve(done.size());
+    for (auto [slot, res] : done) {
+      callbacks.push_back(std::move(m_ops[slot].done));
+      m_ops[slot].path.clear();
+      m_free.push_back(slot);
+    }
+    m_inFlight -= done.size();
+    for (std::size_t i { 0 }; i < done.size(); ++i) {
+      if (callbacks[i]) {
+        callbacks[i](done[i].second);
+      }
+    }
+    return done.size();
+  }
+
+  // until all operations, including those queued by callbacks, are complete:
+  void drain() {
+    while (m_inFlight != 0) {
+      reap(1);
+    }
+  }
+
+private:
+  template<typename F>
+  std::future<int> withFuture(F&& queueOp) {
+    auto promise = std::make_shared<std::promise<int>>();
+    std::future<int> result { promise->get_future() };
+    queueOp([promise](int res) { promise->set_value(res); });
+    return result;
+  }
+
+  // a free slot for the operation; waits for completions if all are in use:
+  batched_io_detail::Op& enqueue(batched_io_detail::OpCode code, Completion done) {
+    while (m_free.empty()) {
+      reap(1);
+    }
+    m_lastSlot = m_free.back();
+    m_free.pop_back();
+    ++m_inFlight;
+    auto& op = m_ops[m_lastSlot];
+    op.code = code;
+    op.fd = -1;
+    op.flags = 0;
+    op.mode = 0;
+    op.buf = nullptr;
+    op.len = 0;
+    op.offset = 0;
+    op.bufIndex = 0;
+    op.done = std::move(done);
+    return op;
+  }
+
+  void queueReadWrite(batched_io_detail::OpCode code, int fd, void* buf, std::size_t len, std::uint64_t offset,
+                      unsigned bufIndex, Completion done) {
+    auto& op = enqueue(code, std::move(done));
+    op.fd = fd;
+    op.buf = buf;
+    op.len = len;
+    op.offset = offset;
+    op.bufIndex = bufIndex;
+    submitOp(op);
+  }
+
+  void submitOp(batched_io_detail::Op& op) {
+    if (m_ring) {
+      // a full submission ring is handed to the kernel; the completion ring has room for
+      // all operations in flight, so the kernel always takes them:
+      io_uring_sqe* sqe { m_ring->nextSqe() };
+      while (!sqe) {
+        m_ring->enter(0);
+        sqe = m_ring->nextSqe();
+      }
+      fillSqe(*sqe, op, m_lastSlot);
+    } else {
+      {
+        std::lock_guard<std::mutex> lock(m_poolMutex);
+        m_pending.push_back(m_lastSlot);
+      }
+      m_poolCv.notify_one();
+    }
+  }
+
+  static void fillSqe(io_uring_sqe& sqe, const batched_io_detail::Op& op, unsigned slot) noexcept {
+    using batched_io_detail::OpCode;
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.user_data = slot;
+    sqe.fd = op.fd;
+    switch (op.code) {
+      case OpCode::open:
+        sqe.opcode = IORING_OP_OPENAT;
+        sqe.fd = AT_FDCWD;
+        sqe.addr = reinterpret_cast<std::uintptr_t>(op.path.c_str());
+        sqe.len = op.mode;
+        sqe.open_flags = static_cast<std::uint32_t>(op.flags);
+        break;
+      case OpCode::read:
+      case OpCode::write:
+      case OpCode::readFixed:
+      case OpCode::writeFixed:
+        sqe.opcode = op.code == OpCode::read ? IORING_OP_READ
+                   : op.code == OpCode::write ? IORING_OP_WRITE
+                   : op.code == OpCode::readFixed ? IORING_OP_READ_FIXED : IORING_OP_WRITE_FIXED;
+        sqe.addr = reinterpret_cast<std::uintptr_t>(op.buf);
+        sqe.len = static_cast<std::uint32_t>(op.len);
+        sqe.off = op.offset;
+        sqe.buf_index = static_cast<std::uint16_t>(op.bufIndex);
+        break;
+      case OpCode::fsync:
+        sqe.opcode = IORING_OP_FSYNC;
+        break;
+      case OpCode::close:
+        sqe.opcode = IORING_OP_CLOSE;
+        break;
+    }
+  }
+
+  // the thread pool fallback runs the blocking syscalls:
+  void runPoolThread() {
+    using batched_io_detail::OpCode;
+    using batched_io_detail::syscallResult;
+    for (;;) {
+      unsigned slot;
+      {
+        std::unique_lock<std::mutex> lock(m_poolMutex);
+        m_poolCv.wait(lock, [&] { return m_stop || !m_pending.empty(); });
+        if (m_pending.empty()) {
+          return;
+        }
+        slot = m_pending.front();
+        m_pending.pop_front();
+      }
+      const auto& op = m_ops[slot];
+      int res { 0 };
+      switch (op.code) {
+        case OpCode::open:
+          res = syscallResult(::open(op.path.c_str(), op.flags, op.mode));
+          break;
+        case OpCode::read:
+        case OpCode::readFixed:
+          res = syscallResult(::pread(op.fd, op.buf, op.len, static_cast<off_t>(op.offset)));
+          break;
+        case OpCode::write:
+        case OpCode::writeFixed:
+          res = syscallResult(::pwrite(op.fd, op.buf, op.len, static_cast<off_t>(op.offset)));
+          break;
+        case OpCode::fsync:
+          res = syscallResult(::fsync(op.fd));
+          break;
+        case OpCode::close:
+          res = syscallResult(::close(op.fd));
+          break;
+      }
+      {
+        std::lock_guard<std::mutex> lock(m_doneMutex);
+        m_done.emplace_back(slot, res);
+      }
+      m_doneCv.notify_one();
+    }
+  }
+
+  std::unique_ptr<batched_io_detail::Ring> m_ring;
+  std::vector<batched_io_detail::Op> m_ops;    // one slot per operation in flight
+  std::vector<unsigned> m_free;
+  std::size_t m_inFlight { 0 };
+  unsigned m_lastSlot { 0 };
+  std::vector<iovec> m_buffers;
+
+  // thread pool fallback:
+  std::vector<std::thread> m_threads;
+  std::mutex m_poolMutex;
+  std::condition_variable m_poolCv;
+  std::deque<unsigned> m_pending;
+  bool m_stop { false };
+  std::mutex m_doneMutex;
+  std::condition_variable m_doneCv;
+  std::vector<std::pair<unsigned, int>> m_done;
+};
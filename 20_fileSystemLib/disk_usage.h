@@ -0,0 +1,238 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "parallel_walker.h"
+
+/*
+  DiskUsage
+  du-style usage per directory, as a faster replacement for a loop over
+  recursive_directory_iterator with file_size() for every file (Linux only):
+  - the tree is read by a ParallelWalker that calls statx() once per entry for size,
+    blocks and link count; each thread adds its files to the directory they are in,
+    in a table of its own, so the walk itself needs no locking
+  - a file with more than one hard link is counted once, by (device, inode), in the
+    first directory that sees it (like du; with several threads "first" isn't fixed)
+  - after the walk the tables are merged and the sums are passed up from the deepest
+    directories to the root, so each DuNode holds the totals of its whole subtree
+  - allocated = blocks on disk (st_blocks * 512, sparse files count less, small files more),
+    apparent = file sizes (what file_size() returns); directories count their own blocks too
+  Symlinks are counted themselves, never followed. Entries that can't be read are skipped
+  and counted in DuResult::walk.errors.
+*/
+
+struct DuNode {
+  std::string path;
+  std::size_t parent;                   // index in DuResult::nodes, npos for the root
+  int depth;                            // 0 for the root
+  std::uint64_t allocated { 0 };        // bytes, whole subtree including the directory itself
+  std::uint64_t apparent { 0 };
+  std::uint64_t files { 0 };            // non-directories in the subtree
+  std::uint64_t directories { 1 };      // including the directory itself
+
+  static constexpr std::size_t npos { static_cast<std::size_t>(-1) };
+};
+
+struct DuResult {
+  std::vector<DuNode> nodes;            // the root first, then its subdirectories in no particular order
+  std::size_t hardLinksSkipped { 0 };   // further links to a file that was counted already
+  WalkStats walk;
+
+  const DuNode& root() const { return nodes.front(); }
+
+  // the n largest subtrees, largest first (the root is one of them):
+  std::vector<const DuNode*> largest(std::size_t n, bool byApparentSize = false) const {
+    std::vector<const DuNode*> all;
+    all.reserve(nodes.size());
+    for (const auto& node : nodes) {
+      all.push_back(&node);
+    }
+    auto size = [byApparentSize](const DuNode* node) { return byApparentSize ? node->apparent : node->allocated; };
+    n = std::min(n, all.size());
+    std::partial_sort(all.begin(), all.begin() + static_cast<std::ptrdiff_t>(n), all.end(),
+                      [&](const DuNode* a, const DuNode* b) { return size(a) != size(b) ? size(a) > size(b) : a->path < b->path; });
+    all.resize(n);
+    return all;
+  }
+
+  // du -k style: allocated KiB, apparent KiB, files and path of the n largest subtrees:
+  void print(std::ostream& os, std::size_t n, bool byApparentSize = false) const {
+    for (const DuNode* node : largest(n, byApparentSize)) {
+      os << std::setw(12) << node->allocated / 1024 << std::setw(12) << node->apparent / 1024
+         << std::setw(10) << node->files << "  " << node->path << '\n';
+    }
+  }
+};
+
+namespace disk_usage_detail {
+
+struct DevIno {
+  std::uint64_t dev;
+  std::uint64_t ino;
+
+  friend bool operator==(const DevIno& a, const DevIno& b) noexcept { return a.dev == b.dev && a.ino == b.ino; }
+};
+
+struct DevInoHash {
+  std::size_t operator()(const DevIno& k) const noexcept {
+    std::uint64_t h { (k.ino ^ (k.dev << 29)) * 0x9e3779b97f4a7c15ULL };
+    return static_cast<std::size_t>(h ^ (h >> 32));
+  }
+};
+
+// the (device, inode) pairs of files with several links, sharded so that threads rarely wait for each other:
+class SeenLinks {
+public:
+  // true the first time a file is seen:
+  bool insert(const DevIno& key) {
+    auto& shard = m_shards[DevInoHash {}(key) % numShards];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.seen.insert(key).second;
+  }
+
+private:
+  static constexpr std::size_t numShards { 64 };
+  struct alignas(64) Shard {
+    std::mutex mutex;
+    std::unordered_set<DevIno, DevInoHash> seen;
+  };
+  Shard m_shards[numShards];
+};
+
+struct Sums {
+  std::uint64_t allocated { 0 };
+  std::uint64_t apparent { 0 };
+  std::uint64_t files { 0 };
+};
+
+struct Dir {
+  std::uint64_t id;
+  std::uint64_t parentId;
+  std::string path;
+  int depth;
+  Sums own;                             // the blocks of the directory itself
+};
+
+// what one thread collected:
+struct WorkerTable {
+  std::vector<Dir> dirs;
+  std::unordered_map<std::uint64_t, Sums> filesByDir;  // directory id -> its files
+  std::size_t hardLinksSkipped { 0 };
+};
+
+inline Sums sizesOf(const struct statx& stx) noexcept {
+  return Sums { stx.stx_blocks * 512, stx.stx_size, 0 };
+}
+
+constexpr unsigned statxMask { STATX_SIZE | STATX_BLOCKS | STATX_NLINK };
+
+}  // namespace disk_usage_detail
+
+class DiskUsage {
+public:
+  explicit DiskUsage(unsigned threads = std::max(1u, std::thread::hardware_concurrency()))
+      : m_threads { std::max(1u, threads) } {}
+
+  // throws std::filesystem::filesystem_error if root can't be read:
+  DuResult scan(const std::filesystem::path& root) const {
+    using namespace disk_usage_detail;
+    namespace fs = std::filesystem;
+
+    struct statx rootStat;
+    if (::statx(AT_FDCWD, root.c_str(), 0, statxMask | STATX_TYPE, &rootStat) != 0) {
+      throw fs::filesystem_error("DiskUsage: cannot stat", root, std::error_code(errno, std::system_category()));
+    }
+
+    WalkOptions opts;
+    opts.threads = m_threads;
+    opts.statxMask = statxMask;
+    ParallelWalker walker { opts };
+    std::vector<WorkerTable> tables(m_threads);
+    SeenLinks seenLinks;
+
+    DuResult result;
+    result.walk = walker.walk(root, [&](const WalkEntry& e) {
+      if (!e.stat) {
+        return;                         // statx() failed, the walker counted the error
+      }
+      WorkerTable& table { tables[e.worker] };
+      if (e.id != 0) {
+        table.dirs.push_back(Dir { e.id, e.parent, std::string(e.path), e.depth + 1, sizesOf(*e.stat) });
+        return;
+      }
+      if (e.stat->stx_nlink > 1
+          && !seenLinks.insert(DevIno { (std::uint64_t { e.stat->stx_dev_major } << 32) | e.stat->stx_dev_minor, e.stat->stx_ino })) {
+        ++table.hardLinksSkipped;
+        return;
+      }
+      Sums& sums { table.filesByDir[e.parent] };
+      sums.allocated += e.stat->stx_blocks * 512;
+      sums.apparent += e.stat->stx_size;
+      ++sums.files;
+    });
+
+    // merge: one node per directory, the root (id 1) first:
+    std::unordered_map<std::uint64_t, std::size_t> indexOf;
+    Sums rootSums { sizesOf(rootStat) };
+    result.nodes.push_back(DuNode { root.string(), DuNode::npos, 0, rootSums.allocated, rootSums.apparent });
+    indexOf.emplace(1, 0);
+    std::vector<std::uint64_t> parentIds { 0 };
+    for (auto& table : tables) {
+      for (auto& dir : table.dirs) {
+        indexOf.emplace(dir.id, result.nodes.size());
+        parentIds.push_back(dir.parentId);
+        result.nodes.push_back(DuNode { std::move(dir.path), DuNode::npos, dir.depth, dir.own.allocated, dir.own.apparent });
+      }
+      result.hardLinksSkipped += table.hardLinksSkipped;
+    }
+    for (std::size_t i { 1 }; i < result.nodes.size(); ++i) {
+      result.nodes[i].parent = indexOf.at(parentIds[i]);
+    }
+    for (const auto& table : tables) {
+      for (const auto& [id, sums] : table.filesByDir) {
+        DuNode& node { result.nodes[indexOf.at(id)] };
+        node.allocated += sums.allocated;
+        node.apparent += sums.apparent;
+        node.files += sums.files;
+      }
+    }
+
+    // bottom-up: children are added to their parent before the parent is added to its own:
+    std::vector<std::size_t> order(result.nodes.size());
+    for (std::size_t i { 0 }; i < order.size(); ++i) {
+      order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) { return result.nodes[a].depth > result.nodes[b].depth; });
+    for (std::size_t i : order) {
+      const DuNode& node { result.nodes[i] };
+      if (node.parent != DuNode::npos) {
+        DuNode& parent { result.nodes[node.parent] };
+        parent.allocated += node.allocated;
+        parent.apparent += node.apparent;
+        parent.files += node.files;
+        parent.directories += node.directories;
+      }
+    }
+    return result;
+  }
+
+private:
+  unsigned m_threads;
+};
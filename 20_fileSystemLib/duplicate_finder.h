@@ -0,0 +1,351 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "parallel_walker.h"
+
+/*
+  DuplicateFinder
+  finds files with the same content below a directory, reading as little as possible (Linux only):
+  1. a ParallelWalker collects the regular files with their size (statx()); only sizes
+     that occur more than once can be duplicates. Further hard links to a file are dropped,
+     they share their blocks already.
+  2. the first 4 KiB of the remaining files are hashed; only (size, head hash) pairs that
+     occur more than once stay. For files up to 4 KiB this is the whole content.
+  3. the remaining files are hashed completely, largest first, in chunks read with pread()
+  Stages 2 and 3 run on a pool of DedupOptions::threads threads that take the next file from
+  a shared counter; each thread reads into one buffer of its own, so the memory for file data
+  is threads * chunkSize, whatever the size of the files. The hash is XXH64 (64 bit, not
+  cryptographic), files are not compared byte by byte.
+  Files that change or can't be read while they are hashed are counted in DedupStats::errors
+  and left out.
+*/
+
+struct DedupOptions {
+  unsigned threads { std::max(1u, std::thread::hardware_concurrency()) };
+  std::uint64_t minSize { 1 };          // empty files are all equal, skip them by default
+  std::size_t headSize { 4096 };
+  std::size_t chunkSize { 1024 * 1024 };
+};
+
+struct DuplicateGroup {
+  std::uint64_t size;                   // of each file
+  std::uint64_t hash;
+  std::vector<std::string> paths;       // sorted
+
+  std::uint64_t reclaimable() const noexcept { return size * (paths.size() - 1); }
+};
+
+struct DedupStats {
+  std::size_t files { 0 };              // regular files of at least minSize
+  std::size_t hardLinks { 0 };          // dropped because another link to the file was seen
+  std::size_t sameSize { 0 };           // hashed in stage 2
+  std::size_t sameHead { 0 };           // hashed in stage 3
+  std::uint64_t bytesRead { 0 };
+  std::size_t errors { 0 };
+  WalkStats walk;
+};
+
+struct DedupResult {
+  std::vector<DuplicateGroup> groups;   // most reclaimable bytes first
+  std::uint64_t reclaimableBytes { 0 }; // if all but one file of each group were removed
+  DedupStats stats;
+};
+
+namespace dedup_detail {
+
+// streaming XXH64:
+class Hash64 {
+public:
+  explicit Hash64(std::uint64_t seed = 0) noexcept
+      : m_acc { seed + p1 + p2, seed + p2, seed, seed - p1 }, m_seed { seed } {}
+
+  void update(const char* data, std::size_t n) noexcept {
+    m_total += n;
+    if (m_buffered + n < 32) {
+      std::memcpy(m_buffer + m_buffered, data, n);
+      m_buffered += n;
+      return;
+    }
+    if (m_buffered != 0) {
+      std::size_t fill { 32 - m_buffered };
+      std::memcpy(m_buffer + m_buffered, data, fill);
+      stripe(m_buffer);
+      data += fill;
+      n -= fill;
+      m_buffered = 0;
+    }
+    for (; n >= 32; data += 32, n -= 32) {
+      stripe(data);
+    }
+    std::memcpy(m_buffer, data, n);
+    m_buffered = n;
+  }
+
+  std::uint64_t digest() const noexcept {
+    std::uint64_t h;
+    if (m_total >= 32) {
+      h = rotl(m_acc[0], 1) + rotl(m_acc[1], 7) + rotl(m_acc[2], 12) + rotl(m_acc[3], 18);
+      for (std::uint64_t acc : m_acc) {
+        h = (h ^ round(0, acc)) * p1 + p4;
+      }
+    } else {
+      h = m_seed + p5;
+    }
+    h += m_total;
+    const char* p { m_buffer };
+    std::size_t n { m_buffered };
+    for (; n >= 8; p += 8, n -= 8) {
+      h = rotl(h ^ round(0, load<std::uint64_t>(p)), 27) * p1 + p4;
+    }
+    if (n >= 4) {
+      h = rotl(h ^ (load<std::uint32_t>(p) * p1), 23) * p2 + p3;
+      p += 4;
+      n -= 4;
+    }
+    for (; n > 0; ++p, --n) {
+      h = rotl(h ^ (static_cast<unsigned char>(*p) * p5), 11) * p1;
+    }
+    h ^= h >> 33;
+    h *= p2;
+    h ^= h >> 29;
+    h *= p3;
+    h ^= h >> 32;
+    return h;
+  }
+
+private:
+  static constexpr std::uint64_t p1 { 11400714785074694791ULL };
+  static constexpr std::uint64_t p2 { 14029467366897019727ULL };
+  static constexpr std::uint64_t p3 { 1609587929392839161ULL };
+  static constexpr std::uint64_t p4 { 9650029242287828579ULL };
+  static constexpr std::uint64_t p5 { 2870177450012600261ULL };
+
+  static std::uint64_t rotl(std::uint64_t x, int r) noexcept { return (x << r) | (x >> (64 - r)); }
+  static std::uint64_t round(std::uint64_t acc, std::uint64_t input) noexcept { return rotl(acc + input * p2, 31) * p1; }
+
+  template<typename T>
+  static T load(const char* p) noexcept {
+    T v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+  }
+
+  void stripe(const char* p) noexcept {
+    for (int i { 0 }; i < 4; ++i) {
+      m_acc[i] = round(m_acc[i], load<std::uint64_t>(p + 8 * i));
+    }
+  }
+
+  std::uint64_t m_acc[4];
+  std::uint64_t m_seed;
+  std::uint64_t m_total { 0 };
+  char m_buffer[32];
+  std::size_t m_buffered { 0 };
+};
+
+struct File {
+  std::string path;
+  std::uint64_t size;
+  std::uint64_t dev;
+  std::uint64_t ino;
+  std::uint64_t hash { 0 };             // of the head after stage 2, of the content after stage 3
+  bool failed { false };
+};
+
+// f(i, thread) for i in [0, n), by threads threads (the caller is one of them):
+template<typename F>
+void runParallel(std::size_t n, unsigned threads, F f) {
+  std::atomic<std::size_t> next { 0 };
+  auto work = [&](unsigned t) {
+    for (std::size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < n;) {
+      f(i, t);
+    }
+  };
+  threads = static_cast<unsigned>(std::min<std::size_t>(threads, std::max<std::size_t>(n, 1)));
+  std::vector<std::thread> pool;
+  for (unsigned t { 1 }; t < threads; ++t) {
+    pool.emplace_back(work, t);
+  }
+  work(0);
+  for (auto& t : pool) {
+    t.join();
+  }
+}
+
+// keeps the runs of at least two files with equal key(); files must be sorted by key():
+template<typename Key>
+void keepGroups(std::vector<File>& files, Key key) {
+  std::size_t out { 0 };
+  for (std::size_t begin { 0 }, end; begin < files.size(); begin = end) {
+    for (end = begin + 1; end < files.size() && key(files[end]) == key(files[begin]); ++end) {
+    }
+    if (end - begin >= 2) {
+      for (std::size_t i { begin }; i < end; ++i, ++out) {
+        if (out != i) {
+          files[out] = std::move(files[i]);
+        }
+      }
+    }
+  }
+  files.resize(out);
+}
+
+}  // namespace dedup_detail
+
+class DuplicateFinder {
+public:
+  explicit DuplicateFinder(DedupOptions opts = {}) : m_opts { std::move(opts) } {
+    m_opts.threads = std::max(1u, m_opts.threads);
+    m_opts.headSize = std::max<std::size_t>(m_opts.headSize, 1);
+    m_opts.chunkSize = std::max(m_opts.chunkSize, m_opts.headSize);
+  }
+
+  const DedupOptions& options() const noexcept { return m_opts; }
+
+  // throws std::filesystem::filesystem_error if root can't be read:
+  DedupResult find(const std::filesystem::path& root) const {
+    using namespace dedup_detail;
+    namespace fs = std::filesystem;
+    DedupResult result;
+    DedupStats& stats { result.stats };
+
+    // 1. regular files by size, one link per inode:
+    WalkOptions walkOpts;
+    walkOpts.threads = m_opts.threads;
+    walkOpts.statxMask = STATX_SIZE;
+    std::vector<std::vector<File>> perWorker(m_opts.threads);
+    stats.walk = ParallelWalker { walkOpts }.walk(root, [&](const WalkEntry& e) {
+      if (e.type == fs::file_type::regular && e.stat && e.stat->stx_size >= m_opts.minSize) {
+        perWorker[e.worker].push_back(File { std::string(e.path), e.stat->stx_size,
+                                             (std::uint64_t { e.stat->stx_dev_major } << 32) | e.stat->stx_dev_minor, e.inode });
+      }
+    });
+    std::vector<File> files;
+    for (auto& v : perWorker) {
+      std::move(v.begin(), v.end(), std::back_inserter(files));
+      std::vector<File>().swap(v);
+    }
+    stats.files = files.size();
+    std::sort(files.begin(), files.end(), [](const File& a, const File& b) {
+      return std::tie(a.size, a.dev, a.ino, a.path) < std::tie(b.size, b.dev, b.ino, b.path);
+    });
+    auto last = std::unique(files.begin(), files.end(), [](const File& a, const File& b) { return a.dev == b.dev && a.ino == b.ino; });
+    stats.hardLinks = static_cast<std::size_t>(files.end() - last);
+    files.erase(last, files.end());
+    keepGroups(files, [](const File& f) { return f.size; });
+    stats.sameSize = files.size();
+
+    // 2. hash of the first headSize bytes:
+    hashAll(files, m_opts.headSize, stats);
+    sortByHash(files);
+    keepGroups(files, [](const File& f) { return std::make_pair(f.size, f.hash); });
+
+    // 3. full hash of the files longer than their head, largest first for an even load at the end:
+    std::vector<File> small, large;
+    for (auto& f : files) {
+      (f.size <= m_opts.headSize ? small : large).push_back(std::move(f));
+    }
+    stats.sameHead = large.size();
+    hashAll(large, static_cast<std::uint64_t>(-1), stats);
+    files = std::move(small);
+    std::move(large.begin(), large.end(), std::back_inserter(files));
+    sortByHash(files);
+    keepGroups(files, [](const File& f) { return std::make_pair(f.size, f.hash); });
+
+    for (std::size_t i { 0 }; i < files.size(); ++i) {
+      if (i == 0 || files[i].size != files[i - 1].size || files[i].hash != files[i - 1].hash) {
+        result.groups.push_back(DuplicateGroup { files[i].size, files[i].hash, {} });
+      }
+      result.groups.back().paths.push_back(std::move(files[i].path));
+    }
+    for (auto& g : result.groups) {
+      std::sort(g.paths.begin(), g.paths.end());
+      result.reclaimableBytes += g.reclaimable();
+    }
+    std::sort(result.groups.begin(), result.groups.end(), [](const DuplicateGroup& a, const DuplicateGroup& b) {
+      return a.reclaimable() != b.reclaimable() ? a.reclaimable() > b.reclaimable() : a.paths < b.paths;
+    });
+    return result;
+  }
+
+private:
+  // files[i].hash = hash of the first min(size, limit) bytes; files that fail are removed:
+  void hashAll(std::vector<dedup_detail::File>& files, std::uint64_t limit, DedupStats& stats) const {
+    using dedup_detail::File;
+    std::sort(files.begin(), files.end(), [](const File& a, const File& b) { return a.size > b.size; });
+    std::vector<std::unique_ptr<char[]>> buffers(m_opts.threads);
+    std::atomic<std::uint64_t> bytesRead { 0 };
+    dedup_detail::runParallel(files.size(), m_opts.threads, [&](std::size_t i, unsigned t) {
+      if (!buffers[t]) {
+        buffers[t] = std::make_unique<char[]>(m_opts.chunkSize);
+      }
+      std::uint64_t n { std::min(files[i].size, limit) };
+      files[i].failed = !hashFile(files[i], n, buffers[t].get());
+      bytesRead.fetch_add(n, std::memory_order_relaxed);
+    });
+    stats.bytesRead += bytesRead;
+    auto failed = std::remove_if(files.begin(), files.end(), [](const File& f) { return f.failed; });
+    stats.errors += static_cast<std::size_t>(files.end() - failed);
+    files.erase(failed, files.end());
+  }
+
+  // false if the file can't be read or has changed its size:
+  bool hashFile(dedup_detail::File& f, std::uint64_t n, char* buffer) const {
+    int fd { ::open(f.path.c_str(), O_RDONLY | O_CLOEXEC) };
+    if (fd < 0) {
+      return false;
+    }
+    if (n > m_opts.headSize) {
+      ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+    dedup_detail::Hash64 hash;
+    std::uint64_t pos { 0 };
+    while (pos < n) {
+      ssize_t got { ::pread(fd, buffer, static_cast<std::size_t>(std::min<std::uint64_t>(n - pos, m_opts.chunkSize)),
+                            static_cast<off_t>(pos)) };
+      if (got < 0 && errno == EINTR) {
+        continue;
+      }
+      if (got <= 0) {
+        break;
+      }
+      hash.update(buffer, static_cast<std::size_t>(got));
+      pos += static_cast<std::uint64_t>(got);
+    }
+    bool ok { pos == n };
+    if (ok && n == f.size) {
+      // at the end of the file now; more data means it has grown since the walk:
+      char probe;
+      ok = ::pread(fd, &probe, 1, static_cast<off_t>(n)) == 0;
+    }
+    ::close(fd);
+    f.hash = hash.digest();
+    return ok;
+  }
+
+  static void sortByHash(std::vector<dedup_detail::File>& files) {
+    std::sort(files.begin(), files.end(), [](const dedup_detail::File& a, const dedup_detail::File& b) {
+      return std::tie(a.size, a.hash) < std::tie(b.size, b.hash);
+    });
+  }
+
+  DedupOptions m_opts;
+};
@@ -0,0 +1,712 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "parallel_walker.h"
+
+/*
+  FsIndex
+  in-memory index of a directory tree, so that "what is in this tree" doesn't need
+  a rescan with directory_iterator and status() each time (Linux only):
+  - path (relative to the root), type, size and mtime per entry, sorted by path,
+    built with a ParallelWalker
+  - saveSnapshot()/loadSnapshot(): compact binary file (paths share their prefix with
+    the previous path, numbers are varints), so a restart doesn't need a full walk
+  - startWatching() puts an inotify watch on each directory; poll() (or a background
+    thread, startBackgroundWatch()) applies the events to the index. The paths of a batch
+    of events are coalesced and each one is compared once with the file system (statx()),
+    new and moved-in directories are scanned, removed ones are dropped with their subtree.
+    If the kernel's event queue overflows, the index is rebuilt. A directory that is gone
+    again by the time it is scanned counts as removed. If the background thread fails
+    otherwise, it rebuilds the index once; if that fails too (e.g. no inotify watches
+    left), it ends and watchError() returns the exception.
+  - find(), forEachWithPrefix() and forEachMatch()/glob() are answered from the index:
+    '*' and '?' don't match '/', "**" matches across directories, [a-z] and [!a-z] are classes
+  Queries may run concurrently with updates (shared mutex). The callbacks of the forEach
+  functions run under the shared lock. Changes made between loadSnapshot() and
+  startWatching() are not seen; build() brings the index up to date.
+*/
+
+struct FsEntry {
+  std::filesystem::file_type type { std::filesystem::file_type::none };
+  std::uint64_t size { 0 };
+  std::int64_t mtimeNs { 0 };           // nanoseconds since the epoch
+
+  friend bool operator==(const FsEntry& a, const FsEntry& b) noexcept {
+    return a.type == b.type && a.size == b.size && a.mtimeNs == b.mtimeNs;
+  }
+  friend bool operator!=(const FsEntry& a, const FsEntry& b) noexcept { return !(a == b); }
+};
+
+namespace fs_index_detail {
+
+constexpr char snapshotMagic[8] { 'F', 'S', 'I', 'D', 'X', 0, 0, 1 };  // the last byte is the version
+
+inline FsEntry fromStatx(const struct statx& stx) noexcept {
+  return FsEntry { walk_detail::fromMode(stx.stx_mode), stx.stx_size,
+                   static_cast<std::int64_t>(stx.stx_mtime.tv_sec) * 1'000'000'000 + stx.stx_mtime.tv_nsec };
+}
+
+inline void putVarint(std::string& out, std::uint64_t v) {
+  while (v >= 0x80) {
+    out += static_cast<char>((v & 0x7f) | 0x80);
+    v >>= 7;
+  }
+  out += static_cast<char>(v);
+}
+
+inline std::uint64_t getVarint(std::string_view& in) {
+  std::uint64_t v { 0 };
+  for (int shift { 0 }; shift < 64; shift += 7) {
+    if (in.empty()) {
+      break;
+    }
+    auto byte = static_cast<unsigned char>(in.front());
+    in.remove_prefix(1);
+    v |= std::uint64_t { byte & 0x7fu } << shift;
+    if (byte < 0x80) {
+      return v;
+    }
+  }
+  throw std::runtime_error("FsIndex snapshot: truncated or invalid number");
+}
+
+inline std::uint64_t zigzag(std::int64_t v) noexcept {
+  return (static_cast<std::uint64_t>(v) << 1) ^ static_cast<std::uint64_t>(v >> 63);
+}
+
+inline std::int64_t unzigzag(std::uint64_t v) noexcept {
+  return static_cast<std::int64_t>(v >> 1) ^ -static_cast<std::int64_t>(v & 1);
+}
+
+inline std::uint64_t fnv1a(std::string_view data) noexcept {
+  std::uint64_t h { 14695981039346656037ull };
+  for (char c : data) {
+    h = (h ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+  }
+  return h;
+}
+
+inline std::string_view literalPrefix(std::string_view pattern) noexcept {
+  return pattern.substr(0, std::min(pattern.find_first_of("*?[\\"), pattern.size()));
+}
+
+// [abc], [a-z], [!a-z] at the start of pat; returns the length of the class, 0 if it is not closed:
+inline std::size_t matchClass(std::string_view pat, char c, bool& matched) noexcept {
+  std::size_t i { 1 };
+  bool negate { i < pat.size() && (pat[i] == '!' || pat[i] == '^') };
+  if (negate) {
+    ++i;
+  }
+  matched = false;
+  for (bool first { true }; i < pat.size() && (first || pat[i] != ']'); first = false) {
+    char lo { pat[i] };
+    char hi { lo };
+    if (i + 2 < pat.size() && pat[i + 1] == '-' && pat[i + 2] != ']') {
+      hi = pat[i + 2];
+      i += 3;
+    } else {
+      ++i;
+    }
+    matched = matched || (lo <= c && c <= hi);
+  }
+  if (i >= pat.size()) {
+    return 0;
+  }
+  matched = matched != negate;
+  return i + 1;
+}
+
+}  // namespace fs_index_detail
+
+// shell style glob match of a whole path:
+inline bool globMatch(std::string_view pat, std::string_view s) {
+  using namespace fs_index_detail;
+  while (!pat.empty()) {
+    if (pat.substr(0, 2) == "**") {
+      pat.remove_prefix(2);
+      // "a/**/b" also matches "a/b":
+      if (!pat.empty() && pat.front() == '/' && globMatch(pat.substr(1), s)) {
+        return true;
+      }
+      for (std::size_t i { 0 }; i <= s.size(); ++i) {
+        if (globMatch(pat, s.substr(i))) {
+          return true;
+        }
+      }
+      return false;
+    }
+    switch (pat.front()) {
+      case '*':
+        pat.remove_prefix(1);
+        for (std::size_t i { 0 };; ++i) {
+          if (globMatch(pat, s.substr(i))) {
+            return true;
+          }
+          if (i == s.size() || s[i] == '/') {
+            return false;
+          }
+        }
+      case '?':
+        if (s.empty() || s.front() == '/') {
+          return false;
+        }
+        pat.remove_prefix(1);
+        s.remove_prefix(1);
+        break;
+      case '[': {
+        bool matched;
+        std::size_t len { s.empty() || s.front() == '/' ? 0 : matchClass(pat, s.front(), matched) };
+        if (len == 0) {
+          // not a class: a literal '['
+          if (s.empty() || s.front() != '[') {
+            return false;
+          }
+          len = 1;
+          matched = true;
+        }
+        if (!matched) {
+          return false;
+        }
+        pat.remove_prefix(len);
+        s.remove_prefix(1);
+        break;
+      }
+      case '\\':
+        if (pat.size() > 1) {
+          pat.remove_prefix(1);
+        }
+        [[fallthrough]];
+      default:
+        if (s.empty() || s.front() != pat.front()) {
+          return false;
+        }
+        pat.remove_prefix(1);
+        s.remove_prefix(1);
+        break;
+    }
+  }
+  return s.empty();
+}
+
+class FsIndex {
+public:
+  explicit FsIndex(std::filesystem::path root, unsigned threads = std::max(1u, std::thread::hardware_concurrency()))
+    : m_root { std::move(root) }, m_threads { threads } {
+    std::string r { m_root.native() };
+    while (r.size() > 1 && r.back() == '/') {
+      r.pop_back();
+    }
+    m_root = r;
+  }
+
+  FsIndex(const FsIndex&) = delete;
+  FsIndex& operator=(const FsIndex&) = delete;
+
+  ~FsIndex() {
+    stopBackgroundWatch();
+    if (m_inotifyFd >= 0) {
+      ::close(m_inotifyFd);
+    }
+  }
+
+  const std::filesystem::path& root() const noexcept { return m_root; }
+
+  // full walk of the tree, replaces the current contents:
+  void build() {
+    auto scanned = scan(m_root.native());
+    std::sort(scanned.begin(), scanned.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    Map entries;
+    for (auto& [path, entry] : scanned) {
+      entries.emplace_hint(entries.end(), std::move(path), entry);
+    }
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    m_entries.swap(entries);
+    if (m_inotifyFd >= 0) {
+      rewatchAll();
+    }
+  }
+
+  /******************** queries ********************/
+
+  std::size_t size() const {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    return m_entries.size();
+  }
+
+  // path relative to the root, e.g. "dir/file.txt":
+  std::optional<FsEntry> find(std::string_view path) const {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    if (auto pos = m_entries.find(path); pos != m_entries.end()) {
+      return pos->second;
+    }
+    return std::nullopt;
+  }
+
+  // f(std::string_view path, const FsEntry&) for all paths starting with prefix (e.g. "dir/"):
+  template<typename F>
+  std::size_t forEachWithPrefix(std::string_view prefix, F&& f) const {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    std::size_t count { 0 };
+    for (auto pos = m_entries.lower_bound(prefix); pos != m_entries.end() && pos->first.compare(0, prefix.size(), prefix) == 0; ++pos) {
+      f(std::string_view(pos->first), pos->second);
+      ++count;
+    }
+    return count;
+  }
+
+  // f(path, entry) for all paths matching the glob pattern; only the range of the
+  // literal prefix of the pattern (before the first wildcard) is searched:
+  template<typename F>
+  std::size_t forEachMatch(std::string_view pattern, F&& f) const {
+    std::size_t count { 0 };
+    forEachWithPrefix(fs_index_detail::literalPrefix(pattern), [&](std::string_view path, const FsEntry& e) {
+      if (globMatch(pattern, path)) {
+        f(path, e);
+        ++count;
+      }
+    });
+    return count;
+  }
+
+  std::vector<std::string> glob(std::string_view pattern) const {
+    std::vector<std::string> result;
+    forEachMatch(pattern, [&](std::string_view path, const FsEntry&) { result.emplace_back(path); });
+    return result;
+  }
+
+  /******************** snapshots ********************/
+
+  // written to a temporary file which is renamed to file, so readers never see half a snapshot:
+  void saveSnapshot(const std::filesystem::path& file) const {
+    using namespace fs_index_detail;
+    std::string out(snapshotMagic, sizeof(snapshotMagic));
+    {
+      std::shared_lock<std::shared_mutex> lock(m_mutex);
+      out.reserve(m_entries.size() * 16);
+      putVarint(out, m_root.native().size());
+      out += m_root.native();
+      putVarint(out, m_entries.size());
+      std::string_view prev;
+      std::int64_t prevMtime { 0 };
+      for (const auto& [path, e] : m_entries) {
+        std::size_t shared { 0 };
+        while (shared < prev.size() && shared < path.size() && prev[shared] == path[shared]) {
+          ++shared;
+        }
+        putVarint(out, shared);
+        putVarint(out, path.size() - shared);
+        out.append(path, shared, std::string::npos);
+        out += static_cast<char>(e.type);
+        putVarint(out, e.size);
+        putVarint(out, zigzag(e.mtimeNs - prevMtime));
+        prev = path;
+        prevMtime = e.mtimeNs;
+      }
+    }
+    std::uint64_t sum { fnv1a(out) };
+    out.append(reinterpret_cast<const char*>(&sum), sizeof(sum));
+
+    std::filesystem::path tmp { file };
+    tmp += ".tmp";
+    {
+      std::ofstream f { tmp, std::ios::binary | std::ios::trunc };
+      f.write(out.data(), static_cast<std::streamsize>(out.size()));
+      if (!f) {
+        throw std::filesystem::filesystem_error("FsIndex::saveSnapshot", tmp, std::make_error_code(std::errc::io_error));
+      }
+    }
+    std::filesystem::rename(tmp, file);
+  }
+
+  // replaces the contents; throws if the file is damaged or belongs to another root:
+  void loadSnapshot(const std::filesystem::path& file) {
+    using namespace fs_index_detail;
+    std::ifstream f { file, std::ios::binary };
+    if (!f) {
+      throw std::filesystem::filesystem_error("FsIndex::loadSnapshot", file, std::make_error_code(std::errc::no_such_file_or_directory));
+    }
+    std::string data { std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>() };
+    std::uint64_t sum;
+    if (data.size() < sizeof(snapshotMagic) + sizeof(sum) || data.compare(0, sizeof(snapshotMagic), snapshotMagic, sizeof(snapshotMagic)) != 0) {
+      throw std::runtime_error("FsIndex snapshot: not a snapshot file or wrong version");
+    }
+    std::memcpy(&sum, data.data() + data.size() - sizeof(sum), sizeof(sum));
+    std::string_view in { data.data(), data.size() - sizeof(sum) };
+    if (fnv1a(in) != sum) {
+      throw std::runtime_error("FsIndex snapshot: checksum mismatch");
+    }
+    in.remove_prefix(sizeof(snapshotMagic));
+
+    auto take = [&](std::size_t n) {
+      if (n > in.size()) {
+        throw std::runtime_error("FsIndex snapshot: truncated");
+      }
+      std::string_view s { in.substr(0, n) };
+      in.remove_prefix(n);
+      return s;
+    };
+    if (take(getVarint(in)) != m_root.native()) {
+      throw std::runtime_error("FsIndex snapshot: taken of another root");
+    }
+    std::uint64_t count { getVarint(in) };
+    Map entries;
+    std::string path;
+    std::int64_t mtime { 0 };
+    for (std::uint64_t i { 0 }; i < count; ++i) {
+      std::uint64_t shared { getVarint(in) };
+      if (shared > path.size()) {
+        throw std::runtime_error("FsIndex snapshot: invalid path prefix");
+      }
+      path.resize(shared);
+      path += take(getVarint(in));
+      FsEntry e;
+      e.type = static_cast<std::filesystem::file_type>(static_cast<signed char>(take(1).front()));
+      e.size = getVarint(in);
+      mtime += unzigzag(getVarint(in));
+      e.mtimeNs = mtime;
+      entries.emplace_hint(entries.end(), path, e);
+    }
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    m_entries.swap(entries);
+    if (m_inotifyFd >= 0) {
+      rewatchAll();
+    }
+  }
+
+  /******************** inotify ********************/
+
+  // watches the root and all directories in the index:
+  void startWatching() {
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    if (m_inotifyFd >= 0) {
+      return;
+    }
+    m_inotifyFd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotifyFd < 0) {
+      throw std::system_error(errno, std::system_category(), "FsIndex: inotify_init1");
+    }
+    rewatchAll();
+  }
+
+  // waits up to timeoutMs for events and applies them, returns the number of changed entries:
+  std::size_t poll(int timeoutMs = 0) {
+    if (m_inotifyFd < 0) {
+      return 0;
+    }
+    pollfd pfd { m_inotifyFd, POLLIN, 0 };
+    if (::poll(&pfd, 1, timeoutMs) <= 0) {
+      return 0;
+    }
+    // events of the whole batch, the value is true if a directory appeared at the path:
+    std::map<std::string, bool> dirty;
+    bool overflow { false };
+    alignas(inotify_event) char buf[64 * 1024];
+    for (;;) {
+      ssize_t n { ::read(m_inotifyFd, buf, sizeof(buf)) };
+      if (n <= 0) {
+        break;
+      }
+      for (ssize_t pos { 0 }; pos < n;) {
+        const auto* ev = reinterpret_cast<const inotify_event*>(buf + pos);
+        pos += static_cast<ssize_t>(sizeof(inotify_event) + ev->len);
+        if (ev->mask & IN_Q_OVERFLOW) {
+          overflow = true;
+          continue;
+        }
+        std::unique_lock<std::shared_mutex> lock(m_mutex);
+        auto wd = m_watches.find(ev->wd);
+        if (wd == m_watches.end()) {
+          continue;
+        }
+        if (ev->mask & IN_IGNORED) {
+          m_watchedDirs.erase(wd->second);
+          m_watches.erase(wd);
+          continue;
+        }
+        if (ev->len == 0) {
+          continue;  // events of the watched directory itself are seen in its parent
+        }
+        std::string path { wd->second.empty() ? std::string(ev->name) : wd->second + '/' + ev->name };
+        bool newDir { (ev->mask & IN_ISDIR) && (ev->mask & (IN_CREATE | IN_MOVED_TO)) };
+        dirty[std::move(path)] |= newDir;
+        // adding or removing a name changes the mtime of the directory, which has no event of its own:
+        if (!wd->second.empty() && (ev->mask & (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO))) {
+          dirty.try_emplace(wd->second, false);
+        }
+      }
+    }
+    if (overflow) {
+      ++m_rebuilds;
+      build();
+      return size();
+    }
+
+    // an error doesn't abandon the rest of the batch, the first one is rethrown afterwards:
+    std::size_t changes { 0 };
+    std::exception_ptr error;
+    for (const auto& [path, newDir] : dirty) {
+      try {
+        changes += reconcile(path, newDir);
+      } catch (...) {
+        if (!error) {
+          error = std::current_exception();
+        }
+      }
+    }
+    m_updates += changes;
+    if (error) {
+      std::rethrow_exception(error);
+    }
+    return changes;
+  }
+
+  // poll() in a thread of its own until stopBackgroundWatch():
+  void startBackgroundWatch() {
+    startWatching();
+    if (m_watchThread.joinable()) {
+      return;
+    }
+    m_stopWatch = false;
+    m_watchError = nullptr;
+    m_watchThread = std::thread { [this] {
+      while (!m_stopWatch) {
+        try {
+          poll(100);
+        } catch (...) {
+          // the index may have missed changes; start over from the file system:
+          try {
+            ++m_rebuilds;
+            build();
+          } catch (...) {
+            std::lock_guard<std::mutex> lock(m_errorMutex);
+            m_watchError = std::current_exception();
+            return;
+          }
+        }
+      }
+    } };
+  }
+
+  // the exception that ended the background thread, nullptr while it runs:
+  std::exception_ptr watchError() const {
+    std::lock_guard<std::mutex> lock(m_errorMutex);
+    return m_watchError;
+  }
+
+  void stopBackgroundWatch() {
+    if (m_watchThread.joinable()) {
+      m_stopWatch = true;
+      m_watchThread.join();
+    }
+  }
+
+  std::size_t numWatches() const {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    return m_watches.size();
+  }
+
+  // entries changed by events, and full rebuilds after a queue overflow:
+  std::size_t updatesApplied() const noexcept { return m_updates; }
+  std::size_t rebuilds() const noexcept { return m_rebuilds; }
+
+private:
+  using Map = std::map<std::string, FsEntry, std::less<>>;
+
+  static constexpr std::uint32_t watchMask { IN_CREATE | IN_DELETE | IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE |
+                                             IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK };
+
+  std::string fullPath(std::string_view rel) const {
+    std::string p { m_root.native() };
+    if (!rel.empty()) {
+      if (p.back() != '/') {
+        p += '/';
+      }
+      p += rel;
+    }
+    return p;
+  }
+
+  // (relative path, entry) of everything below dir (a full path):
+  std::vector<std::pair<std::string, FsEntry>> scan(const std::string& dir) const {
+    WalkOptions opts;
+    opts.threads = m_threads;
+    opts.statxMask = STATX_SIZE | STATX_MTIME;
+    ParallelWalker walker { opts };
+    std::vector<std::vector<std::pair<std::string, FsEntry>>> perWorker(m_threads);
+    const std::size_t skip { m_root.native() == "/" ? 1 : m_root.native().size() + 1 };
+    walker.walk(dir, [&](const WalkEntry& e) {
+      FsEntry entry { e.stat ? fs_index_detail::fromStatx(*e.stat) : FsEntry { e.type } };
+      perWorker[e.worker].emplace_back(std::string(e.path.substr(skip)), entry);
+    });
+    std::vector<std::pair<std::string, FsEntry>> all;
+    for (auto& v : perWorker) {
+      std::move(v.begin(), v.end(), std::back_inserter(all));
+    }
+    return all;
+  }
+
+  // with the unique lock held:
+  void addWatch(const std::string& rel) {
+    int wd { ::inotify_add_watch(m_inotifyFd, fullPath(rel).c_str(), watchMask) };
+    if (wd < 0) {
+      if (errno == ENOSPC) {
+        throw std::system_error(errno, std::system_category(), "FsIndex: too many inotify watches (fs.inotify.max_user_watches)");
+      }
+      return;  // the directory is gone already, its events will say so
+    }
+    // a directory moved within the tree keeps its watch descriptor:
+    if (auto old = m_watches.find(wd); old != m_watches.end()) {
+      m_watchedDirs.erase(old->second);
+    }
+    m_watches[wd] = rel;
+    m_watchedDirs[rel] = wd;
+  }
+
+  // rel and everything below it ("dir", then "dir/..."; "dir-x" sorts in between but doesn't match):
+  void removeWatchesBelow(const std::string& rel) {
+    std::string prefix { rel + '/' };
+    for (auto pos = m_watchedDirs.lower_bound(rel); pos != m_watchedDirs.end();) {
+      if (pos->first == rel || pos->first.compare(0, prefix.size(), prefix) == 0) {
+        ::inotify_rm_watch(m_inotifyFd, pos->second);
+        m_watches.erase(pos->second);
+        pos = m_watchedDirs.erase(pos);
+      } else if (pos->first.compare(0, rel.size(), rel) == 0) {
+        ++pos;
+      } else {
+        break;
+      }
+    }
+  }
+
+  void rewatchAll() {
+    for (const auto& [wd, rel] : m_watches) {
+      ::inotify_rm_watch(m_inotifyFd, wd);
+    }
+    m_watches.clear();
+    m_watchedDirs.clear();
+    addWatch("");
+    for (const auto& [path, e] : m_entries) {
+      if (e.type == std::filesystem::file_type::directory) {
+        addWatch(path);
+      }
+    }
+  }
+
+  // compares the index entry of path with the file system, returns the number of changed entries:
+  std::size_t reconcile(const std::string& rel, bool newDir) {
+    struct statx stx;
+    bool exists { ::statx(AT_FDCWD, fullPath(rel).c_str(), AT_SYMLINK_NOFOLLOW, STATX_TYPE | STATX_SIZE | STATX_MTIME, &stx) == 0 };
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    auto pos = m_entries.find(rel);
+    if (!exists) {
+      if (pos == m_entries.end()) {
+        return 0;
+      }
+      std::size_t changes { 1 };
+      if (pos->second.type == std::filesystem::file_type::directory) {
+        changes += eraseBelow(rel);
+        removeWatchesBelow(rel);
+      }
+      m_entries.erase(rel);
+      return changes;
+    }
+
+    FsEntry e { fs_index_detail::fromStatx(stx) };
+    bool wasDir { pos != m_entries.end() && pos->second.type == std::filesystem::file_type::directory };
+    std::size_t changes { 0 };
+    if (pos == m_entries.end()) {
+      m_entries.emplace(rel, e);
+      changes = 1;
+    } else if (pos->second != e) {
+      pos->second = e;
+      changes = 1;
+    }
+    if (wasDir && (newDir || e.type != std::filesystem::file_type::directory)) {
+      // replaced: forget the old contents
+      changes += eraseBelow(rel);
+      removeWatchesBelow(rel);
+    }
+    if (e.type == std::filesystem::file_type::directory && (newDir || !wasDir)) {
+      // watch first, then scan, so that nothing created in between is lost:
+      addWatch(rel);
+      lock.unlock();
+      std::vector<std::pair<std::string, FsEntry>> scanned;
+      try {
+        scanned = scan(fullPath(rel));
+      } catch (const std::filesystem::filesystem_error& ex) {
+        if (ex.code() != std::errc::no_such_file_or_directory && ex.code() != std::errc::not_a_directory) {
+          throw;
+        }
+        // removed (or replaced by a file) since the statx(); the events of that follow:
+        lock.lock();
+        m_entries.erase(rel);
+        removeWatchesBelow(rel);
+        return 1 + eraseBelow(rel);
+      }
+      lock.lock();
+      for (auto& [path, entry] : scanned) {
+        if (entry.type == std::filesystem::file_type::directory) {
+          addWatch(path);
+        }
+        m_entries.insert_or_assign(std::move(path), entry);
+      }
+      changes += scanned.size();
+    }
+    return changes;
+  }
+
+  std::size_t eraseBelow(const std::string& rel) {
+    std::string prefix { rel + '/' };
+    auto first = m_entries.lower_bound(prefix);
+    auto last = first;
+    std::size_t n { 0 };
+    while (last != m_entries.end() && last->first.compare(0, prefix.size(), prefix) == 0) {
+      ++last;
+      ++n;
+    }
+    m_entries.erase(first, last);
+    return n;
+  }
+
+  std::filesystem::path m_root;
+  unsigned m_threads;
+  mutable std::shared_mutex m_mutex;
+  Map m_entries;
+
+  int m_inotifyFd { -1 };
+  std::unordered_map<int, std::string> m_watches;     // watch descriptor -> directory
+  std::map<std::string, int> m_watchedDirs;           // directory -> watch descriptor
+  std::thread m_watchThread;
+  std::atomic<bool> m_stopWatch { false };
+  mutable std::mutex m_errorMutex;
+  std::exception_ptr m_watchError;
+  std::atomic<std::size_t> m_updates { 0 };
+  std::atomic<std::size_t> m_rebuilds { 0 };
+};
@@ -3,6 +3,23 @@
 #include <filesystem>
 #include <fstream>
 #include <cstdlib>
+#include <chrono>
+#include <atomic>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <map>
+#include <random>
+#include <new>
+#include <cstring>
+#include <dirent.h>
+#include "parallel_walker.h"
+#include "fs_index.h"
+#include "batched_io.h"
+#include "disk_usage.h"
+#include "duplicate_finder.h"
+#include "path_builder.h"
+#include "tree_copier.h"
 
 /*
     With C++17 the Boost.filesystem library was finally adopted as a C++ standard library. By doing
@@ -11,6 +28,20 @@
     relative path between filesystem paths).
 */
 
+// every operator new of the program is counted (malloc() isn't), for the allocations per entry
+// in path_builder_benchmark(); out of line, so that GCC doesn't pair a malloc() with a delete:
+static std::atomic<std::size_t> numAllocations { 0 };
+
+[[gnu::noinline]] void* operator new(std::size_t size) {
+  numAllocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* p= std::malloc(size ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc {};
+}
+[[gnu::noinline]] void operator delete(void* p) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
 void create_different_types_of_files() {
   namespace fs= std::filesystem;
   try {
@@ -41,6 +72,523 @@ void create_different_types_of_files() {
   }
 }
 
+template <typename T>
+double diff(const T& t0, const T& t1) {
+  return std::chrono::duration<double, std::milli>(t1 - t0).count();
+}
+
+// 100 directories with 10 subdirectories each, numFiles empty files spread over the 1000 leaves
+// and a symlink back to the root (a loop when symlinks are followed):
+void make_walk_tree(const std::filesystem::path& root, std::size_t numFiles) {
+  namespace fs= std::filesystem;
+  if (exists(root / "done")) {
+    return;
+  }
+  remove_all(root);
+  for (int i { 0 }; i < 100; ++i) {
+    for (int j { 0 }; j < 10; ++j) {
+      fs::path dir { root / ("d" + std::to_string(i)) / ("s" + std::to_string(j)) };
+      create_directories(dir);
+      for (std::size_t k { 0 }; k < numFiles / 1000; ++k) {
+        std::ofstream { dir / ("f" + std::to_string(k) + ".txt") } << k;
+      }
+    }
+  }
+  create_directory_symlink("..", root / "d0" / "up");
+  std::ofstream { root / "done" };
+}
+
+void parallel_walk_benchmark(std::size_t numFiles= 1'000'000) {
+  namespace fs= std::filesystem;
+  fs::path root { fs::temp_directory_path() / "walk_bench" };
+  make_walk_tree(root, numFiles);
+  std::cout << "tree with " << numFiles << " files in " << root.string() << '\n';
+
+  for (int run { 0 }; run < 3; ++run) {
+    // types only:
+    auto t0= std::chrono::steady_clock::now();
+    std::size_t numRegular { 0 };
+    for (const auto& e : fs::recursive_directory_iterator(root)) {
+      numRegular += e.is_regular_file();
+    }
+    auto t1= std::chrono::steady_clock::now();
+    ParallelWalker walker;
+    std::atomic<std::size_t> numRegular2 { 0 };
+    WalkStats st= walker.walk(root, [&](const WalkEntry& e) {
+      if (e.type == fs::file_type::regular) {
+        numRegular2.fetch_add(1, std::memory_order_relaxed);
+      }
+    });
+    auto t2= std::chrono::steady_clock::now();
+    std::cout << "regular files: recursive_directory_iterator " << diff(t0, t1) << "ms (" << numRegular
+              << "), ParallelWalker with " << walker.options().threads << " threads " << diff(t1, t2) << "ms ("
+              << numRegular2 << ", " << st.statxCalls << " statx calls, " << st.steals << " steals)\n";
+
+    // with the size of each file:
+    t0= std::chrono::steady_clock::now();
+    std::uintmax_t bytes { 0 };
+    for (const auto& e : fs::recursive_directory_iterator(root)) {
+      if (e.is_regular_file()) {
+        bytes += e.file_size();
+      }
+    }
+    t1= std::chrono::steady_clock::now();
+    WalkOptions opts;
+    opts.statxMask= STATX_SIZE;
+    ParallelWalker sizeWalker { opts };
+    std::atomic<std::uintmax_t> bytes2 { 0 };
+    sizeWalker.walk(root, [&](const WalkEntry& e) {
+      if (e.type == fs::file_type::regular && e.stat) {
+        bytes2.fetch_add(e.stat->stx_size, std::memory_order_relaxed);
+      }
+    });
+    t2= std::chrono::steady_clock::now();
+    std::cout << "with file sizes: recursive_directory_iterator " << diff(t0, t1) << "ms (" << bytes
+              << " bytes), ParallelWalker " << diff(t1, t2) << "ms (" << bytes2 << " bytes)\n";
+  }
+
+  // following symlinks: d0/up points back to the root, but each directory is read once
+  WalkOptions followOpts;
+  followOpts.followSymlinks= true;
+  ParallelWalker followWalker { followOpts };
+  WalkStats st= followWalker.walk(root, [](const WalkEntry&) {});
+  std::cout << "following symlinks: " << st.entries << " entries in " << st.directories << " directories\n";
+
+  // entries through a bounded queue to a consumer thread:
+  WalkQueue queue { 4096 };
+  std::size_t consumed { 0 };
+  std::thread consumer { [&] {
+    std::vector<WalkRecord> batch;
+    while (queue.popBatch(batch) != 0) {
+      consumed += batch.size();
+      batch.clear();
+    }
+  } };
+  ParallelWalker queueWalker;
+  walkInto(queueWalker, root, queue);
+  consumer.join();
+  std::cout << "consumed " << consumed << " entries from the queue\n";
+  std::cout << "(the tree is kept for the next run, remove " << root.string() << " when done)\n";
+}
+
+void fs_index_benchmark() {
+  namespace fs= std::filesystem;
+  fs::path root { fs::temp_directory_path() / "index_bench" };
+  make_walk_tree(root, 100'000);
+
+  // the question "which files match d1?/s2/f1*.txt and how large are they", asked by a rescan:
+  auto t0= std::chrono::steady_clock::now();
+  std::size_t count { 0 };
+  std::uintmax_t bytes { 0 };
+  for (const auto& e : fs::recursive_directory_iterator(root)) {
+    auto rel= e.path().lexically_relative(root).string();
+    if (status(e.path()).type() == fs::file_type::regular && globMatch("d1?/s2/f1*.txt", rel)) {
+      ++count;
+      bytes += file_size(e.path());
+    }
+  }
+  auto t1= std::chrono::steady_clock::now();
+
+  FsIndex index { root };
+  index.build();
+  auto t2= std::chrono::steady_clock::now();
+  std::size_t count2 { 0 };
+  std::uintmax_t bytes2 { 0 };
+  for (int i { 0 }; i < 100; ++i) {
+    count2= index.forEachMatch("d1?/s2/f1*.txt", [&](std::string_view, const FsEntry& e) { bytes2 += e.size; });
+  }
+  auto t3= std::chrono::steady_clock::now();
+  std::cout << "rescan: " << diff(t0, t1) << "ms (" << count << " files, " << bytes << " bytes), index build: "
+            << diff(t1, t2) << "ms, query: " << diff(t2, t3) / 100 << "ms (" << count2 << " files, " << bytes2 / 100 << " bytes)\n";
+
+  fs::path snapshot { fs::temp_directory_path() / "index_bench.snapshot" };
+  t0= std::chrono::steady_clock::now();
+  index.saveSnapshot(snapshot);
+  t1= std::chrono::steady_clock::now();
+  FsIndex restored { root };
+  restored.loadSnapshot(snapshot);
+  t2= std::chrono::steady_clock::now();
+  std::cout << "snapshot of " << index.size() << " entries: " << file_size(snapshot) / 1024 << " KiB, save "
+            << diff(t0, t1) << "ms, load " << diff(t1, t2) << "ms\n";
+
+  // changes are applied from inotify events instead of rescanning:
+  restored.startWatching();
+  for (int i { 0 }; i < 1000; ++i) {
+    std::ofstream { root / "d7" / "s7" / ("new" + std::to_string(i)) } << "new file";
+  }
+  rename(root / "d8", root / "d7" / "d8");
+  t0= std::chrono::steady_clock::now();
+  std::size_t changes { 0 };
+  while (std::size_t n= restored.poll(10)) {
+    changes += n;
+  }
+  t1= std::chrono::steady_clock::now();
+  std::cout << "applied " << changes << " changes from inotify in " << diff(t0, t1) << "ms, "
+            << restored.forEachWithPrefix("d7/", [](std::string_view, const FsEntry&) {}) << " entries below d7/ now\n";
+
+  // restore the tree for the next run:
+  rename(root / "d7" / "d8", root / "d8");
+  for (int i { 0 }; i < 1000; ++i) {
+    fs::remove(root / "d7" / "s7" / ("new" + std::to_string(i)));
+  }
+}
+
+void batched_io_benchmark(int numFiles= 10'000) {
+  namespace fs= std::filesystem;
+  fs::path dir { fs::temp_directory_path() / "small_files" };
+  const std::string content(4096, 'x');
+  auto fileName= [&](int i) { return (dir / ("f" + std::to_string(i))).string(); };
+  auto fresh= [&] {
+    remove_all(dir);
+    create_directories(dir);
+  };
+
+  // create: open, write 4 KiB, close; a callback queues the next step of each file
+  auto createAll= [&](BatchedFileIo& io) {
+    int created { 0 };
+    for (int i { 0 }; i < numFiles; ++i) {
+      io.open(fileName(i), O_CREAT | O_WRONLY | O_TRUNC, 0644, [&](int fd) {
+        io.write(fd, content.data(), content.size(), 0, [&, fd](int) {
+          io.close(fd, [&](int res) { created += res == 0; });
+        });
+      });
+    }
+    io.drain();
+    return created;
+  };
+  std::vector<char> readBuf(std::size_t(numFiles) * 4096);
+  auto readAll= [&](BatchedFileIo& io, bool fixed) {
+    std::size_t bytes { 0 };
+    for (int i { 0 }; i < numFiles; ++i) {
+      io.open(fileName(i), O_RDONLY, 0, [&, i, fixed](int fd) {
+        auto done= [&, fd](int n) {
+          bytes += n > 0 ? std::size_t(n) : 0;
+          io.close(fd);
+        };
+        if (fixed) {
+          io.readFixed(fd, 0, std::size_t(i) * 4096, 4096, 0, done);
+        } else {
+          io.read(fd, readBuf.data() + std::size_t(i) * 4096, 4096, 0, done);
+        }
+      });
+    }
+    io.drain();
+    return bytes;
+  };
+
+  for (int run { 0 }; run < 3; ++run) {
+    fresh();
+    auto t0= std::chrono::steady_clock::now();
+    for (int i { 0 }; i < numFiles; ++i) {
+      std::ofstream f { fileName(i), std::ios::binary };
+      f.write(content.data(), static_cast<std::streamsize>(content.size()));
+    }
+    auto t1= std::chrono::steady_clock::now();
+    std::size_t bytes { 0 };
+    for (int i { 0 }; i < numFiles; ++i) {
+      std::ifstream f { fileName(i), std::ios::binary };
+      f.read(readBuf.data() + std::size_t(i) * 4096, 4096);
+      bytes += static_cast<std::size_t>(f.gcount());
+    }
+    auto t2= std::chrono::steady_clock::now();
+    std::cout << numFiles << " files: ofstream " << numFiles / diff(t0, t1) << " creates/ms, ifstream "
+              << numFiles / diff(t1, t2) << " reads/ms (" << bytes << " bytes)\n";
+
+    for (IoBackend backend : { IoBackend::automatic, IoBackend::threadPool }) {
+      BatchedFileIo io { 256, backend };
+      fresh();
+      t0= std::chrono::steady_clock::now();
+      int created= createAll(io);
+      t1= std::chrono::steady_clock::now();
+      bytes= readAll(io, false);
+      t2= std::chrono::steady_clock::now();
+      io.registerBuffers({ { readBuf.data(), readBuf.size() } });
+      auto t3= std::chrono::steady_clock::now();
+      std::size_t bytesFixed= readAll(io, true);
+      auto t4= std::chrono::steady_clock::now();
+      std::cout << "  " << (io.usingIoUring() ? "io_uring:    " : "thread pool: ") << created / diff(t0, t1)
+                << " creates/ms, " << numFiles / diff(t1, t2) << " reads/ms (" << bytes << " bytes), with registered buffers "
+                << numFiles / diff(t3, t4) << " reads/ms (" << bytesFixed << " bytes)\n";
+    }
+  }
+  remove_all(dir);
+}
+
+void disk_usage_benchmark(std::size_t numFiles= 1'000'000) {
+  namespace fs= std::filesystem;
+  fs::path root { fs::temp_directory_path() / "walk_bench" };
+  make_walk_tree(root, numFiles);
+  // a second link to the files of d0/s0, to be counted once:
+  remove_all(root / "links");
+  create_directories(root / "links");
+  for (std::size_t i { 0 }; i < numFiles / 1000; ++i) {
+    fs::create_hard_link(root / "d0" / "s0" / ("f" + std::to_string(i) + ".txt"), root / "links" / std::to_string(i));
+  }
+
+  // file_size() per file, summed per directory and then passed up to the root:
+  auto t0= std::chrono::steady_clock::now();
+  std::unordered_map<std::string, std::uintmax_t> sizes;
+  for (const auto& e : fs::recursive_directory_iterator(root)) {
+    if (e.is_regular_file()) {
+      sizes[e.path().parent_path().string()] += file_size(e.path());
+    }
+  }
+  std::vector<std::pair<std::string, std::uintmax_t>> dirs(sizes.begin(), sizes.end());
+  std::sort(dirs.begin(), dirs.end(), [](const auto& a, const auto& b) { return a.first.size() > b.first.size(); });
+  for (const auto& [dir, size] : dirs) {
+    for (fs::path p { dir }; p != root; ) {
+      p= p.parent_path();
+      sizes[p.string()] += size;
+    }
+  }
+  auto t1= std::chrono::steady_clock::now();
+  std::cout << "recursive_directory_iterator + file_size: " << diff(t0, t1) << "ms, " << sizes[root.string()] << " bytes\n";
+
+  for (unsigned threads : { 1u, 4u }) {
+    t0= std::chrono::steady_clock::now();
+    DuResult du= DiskUsage { threads }.scan(root);
+    t1= std::chrono::steady_clock::now();
+    std::cout << "DiskUsage, " << threads << " threads: " << diff(t0, t1) << "ms, " << du.root().apparent << " bytes ("
+              << du.root().allocated / 1024 << " KiB allocated) in " << du.root().files << " files and "
+              << du.root().directories << " directories, " << du.hardLinksSkipped << " hard links counted once\n";
+    if (threads == 4) {
+      std::cout << "   alloc KiB   apprnt KiB     files  path\n";
+      du.print(std::cout, 10);
+    }
+  }
+  remove_all(root / "links");
+}
+
+// 40 directories with 12000 unique small files, 300 files of up to 8 MiB that occur one to
+// three times, and files that only share their size or their first 4 KiB with them:
+void make_dedup_tree(const std::filesystem::path& root) {
+  namespace fs= std::filesystem;
+  if (exists(root / "done")) {
+    return;
+  }
+  remove_all(root);
+  for (int d { 0 }; d < 40; ++d) {
+    create_directories(root / ("d" + std::to_string(d)));
+  }
+  std::mt19937_64 rng { 42 };
+  auto dir= [&] { return root / ("d" + std::to_string(rng() % 40)); };
+  auto write= [](const fs::path& p, const std::string& data) {
+    std::ofstream { p, std::ios::binary }.write(data.data(), static_cast<std::streamsize>(data.size()));
+  };
+  auto randomData= [&](std::size_t size) {
+    std::string data(size, '\0');
+    for (auto& c : data) {
+      c= static_cast<char>(rng());
+    }
+    return data;
+  };
+  for (int i { 0 }; i < 12'000; ++i) {
+    write(dir() / ("small" + std::to_string(i)), randomData(1 + rng() % 16'384));
+  }
+  for (int i { 0 }; i < 300; ++i) {
+    std::string data { randomData(1 + rng() % (8 << 20)) };
+    for (int copy { 0 }, copies= 1 + static_cast<int>(rng() % 3); copy < copies; ++copy) {
+      write(dir() / ("big" + std::to_string(i) + "_" + std::to_string(copy)), data);
+    }
+    if (i % 10 == 0) {
+      data.back() ^= 1;                 // same size and head, different tail
+      write(dir() / ("tail" + std::to_string(i)), data);
+      data.front() ^= 1;                // same size, different head
+      write(dir() / ("head" + std::to_string(i)), data);
+    }
+  }
+  std::ofstream { root / "done" };
+}
+
+void duplicate_finder_benchmark() {
+  namespace fs= std::filesystem;
+  fs::path root { fs::temp_directory_path() / "dedup_bench" };
+  make_dedup_tree(root);
+
+  // read and hash every file completely:
+  auto t0= std::chrono::steady_clock::now();
+  std::map<std::pair<std::uintmax_t, std::size_t>, std::vector<fs::path>> byContent;
+  std::uintmax_t bytesRead { 0 };
+  for (const auto& e : fs::recursive_directory_iterator(root)) {
+    if (e.is_regular_file() && e.file_size() > 0) {
+      std::ifstream in { e.path(), std::ios::binary };
+      std::string data(e.file_size(), '\0');
+      in.read(data.data(), static_cast<std::streamsize>(data.size()));
+      bytesRead += data.size();
+      byContent[{ data.size(), std::hash<std::string> {}(data) }].push_back(e.path());
+    }
+  }
+  std::size_t groups { 0 };
+  std::uintmax_t reclaimable { 0 };
+  for (const auto& [key, paths] : byContent) {
+    if (paths.size() > 1) {
+      ++groups;
+      reclaimable += key.first * (paths.size() - 1);
+    }
+  }
+  auto t1= std::chrono::steady_clock::now();
+  std::cout << "read everything: " << diff(t0, t1) << "ms, " << groups << " groups, " << reclaimable / 1024 << " KiB reclaimable, "
+            << bytesRead / 1024 / 1024 << " MiB read (" << bytesRead / 1024.0 / 1024 / diff(t0, t1) * 1000 << " MiB/s)\n";
+
+  for (unsigned threads : { 1u, 4u }) {
+    DedupOptions opts;
+    opts.threads= threads;
+    t0= std::chrono::steady_clock::now();
+    DedupResult r= DuplicateFinder { opts }.find(root);
+    t1= std::chrono::steady_clock::now();
+    std::cout << "DuplicateFinder, " << threads << " threads: " << diff(t0, t1) << "ms, " << r.groups.size() << " groups, "
+              << r.reclaimableBytes / 1024 << " KiB reclaimable, " << r.stats.bytesRead / 1024 / 1024 << " MiB read ("
+              << r.stats.bytesRead / 1024.0 / 1024 / diff(t0, t1) * 1000 << " MiB/s); " << r.stats.files << " files, "
+              << r.stats.sameSize << " with a common size, " << r.stats.sameHead << " with a common head\n";
+  }
+  DedupResult r= DuplicateFinder {}.find(root);
+  for (std::size_t i { 0 }; i < std::min<std::size_t>(3, r.groups.size()); ++i) {
+    std::cout << "  " << r.groups[i].size << " bytes:";
+    for (const auto& p : r.groups[i].paths) {
+      std::cout << ' ' << fs::path(p).lexically_relative(root).string();
+    }
+    std::cout << '\n';
+  }
+}
+
+// depth first with opendir()/readdir(), all entries share the buffer of one PathBuilder:
+template<typename F>
+void walk_with_path_builder(PathBuilder& path, F& f) {
+  DIR* dir= ::opendir(path.c_str());
+  if (!dir) {
+    return;
+  }
+  while (const dirent* d= ::readdir(dir)) {
+    std::string_view name { d->d_name };
+    if (name == "." || name == "..") {
+      continue;
+    }
+    auto mark= path.push(name);
+    f(path, d->d_type);
+    if (d->d_type == DT_DIR) {
+      walk_with_path_builder(path, f);
+    }
+    path.pop(mark);
+  }
+  ::closedir(dir);
+}
+
+void path_builder_benchmark() {
+  namespace fs= std::filesystem;
+  fs::path root { fs::temp_directory_path() / "walk_bench" };
+  make_walk_tree(root, 1'000'000);
+  // "./" and ".." in the paths, so that normalizing has something to do:
+  std::string start { (root / "." / "d0" / "..").string() };
+
+  for (int run { 0 }; run < 2; ++run) {
+    // a fs::path per entry, and a normalized copy as a std::string:
+    std::size_t entries { 0 }, chars { 0 };
+    std::size_t a0= numAllocations;
+    auto t0= std::chrono::steady_clock::now();
+    for (const auto& e : fs::recursive_directory_iterator(start)) {
+      ++entries;
+      chars += e.path().lexically_normal().string().size() + e.path().filename().string().size();
+    }
+    auto t1= std::chrono::steady_clock::now();
+    std::size_t a1= numAllocations;
+    std::cout << "recursive_directory_iterator + lexically_normal(): " << diff(t0, t1) << "ms, " << entries << " entries, "
+              << double(a1 - a0) / entries << " allocations per entry (" << chars << " chars)\n";
+
+    // one PathBuilder for the walk and one for the normalized path:
+    std::size_t entries2 { 0 }, chars2 { 0 };
+    PathBuilder path { start };
+    PathBuilder normal;
+    normal.reserve(4096);
+    auto count= [&](const PathBuilder& p, unsigned char) {
+      ++entries2;
+      normal.assign(p.view());
+      normal.normalize();
+      chars2 += normal.size() + p.filename().size();
+    };
+    a0= numAllocations;
+    t0= std::chrono::steady_clock::now();
+    walk_with_path_builder(path, count);
+    t1= std::chrono::steady_clock::now();
+    a1= numAllocations;
+    std::cout << "PathBuilder + normalize(): " << diff(t0, t1) << "ms, " << entries2 << " entries, "
+              << double(a1 - a0) / entries2 << " allocations per entry (" << chars2 << " chars)\n";
+  }
+
+  // the ParallelWalker keeps its paths in a buffer per thread as well:
+  std::size_t a0= numAllocations;
+  WalkStats st= ParallelWalker {}.walk(root, [](const WalkEntry&) {});
+  std::cout << "ParallelWalker: " << double(numAllocations - a0) / st.entries << " allocations per entry\n";
+}
+
+// 64 files of 8 MiB, 4000 files of 4 to 64 KiB in 20 directories and a sparse 2 GiB file with 4 MiB of data:
+void make_copy_tree(const std::filesystem::path& root) {
+  namespace fs= std::filesystem;
+  if (exists(root / "done")) {
+    return;
+  }
+  remove_all(root);
+  std::mt19937_64 rng { 7 };
+  auto write= [&](const fs::path& p, std::size_t size) {
+    std::string data(size, '\0');
+    for (std::size_t i { 0 }; i + 8 <= size; i += 8) {
+      std::uint64_t r { rng() };
+      std::memcpy(data.data() + i, &r, 8);
+    }
+    std::ofstream { p, std::ios::binary }.write(data.data(), static_cast<std::streamsize>(size));
+  };
+  create_directories(root / "large");
+  for (int i { 0 }; i < 64; ++i) {
+    write(root / "large" / ("f" + std::to_string(i)), 8 << 20);
+  }
+  for (int i { 0 }; i < 4000; ++i) {
+    fs::path dir { root / "small" / ("d" + std::to_string(i % 20)) };
+    create_directories(dir);
+    write(dir / ("f" + std::to_string(i)), 4096 + rng() % (60 * 1024));
+  }
+  std::ofstream sparse { root / "sparse.img", std::ios::binary };
+  for (int i { 0 }; i < 4; ++i) {
+    sparse.seekp(std::streamoff(i) * (512 << 20));
+    sparse << std::string(1 << 20, 'x');
+  }
+  sparse.close();
+  resize_file(root / "sparse.img", std::uintmax_t { 2 } << 30);
+  std::ofstream { root / "done" };
+}
+
+void tree_copier_benchmark() {
+  namespace fs= std::filesystem;
+  fs::path src { fs::temp_directory_path() / "copy_bench" };
+  fs::path dst { fs::temp_directory_path() / "copy_bench_copy" };
+  make_copy_tree(src);
+  std::uintmax_t bytes { DiskUsage {}.scan(src).root().apparent };
+  auto gbPerSecond= [&](double ms) { return bytes / ms / 1e6; };
+  auto allocatedMiB= [&] { return DiskUsage {}.scan(dst).root().allocated >> 20; };
+
+  for (int run { 0 }; run < 2; ++run) {
+    remove_all(dst);
+    auto t0= std::chrono::steady_clock::now();
+    fs::copy(src, dst, fs::copy_options::recursive);
+    auto t1= std::chrono::steady_clock::now();
+    std::cout << "fs::copy recursive: " << diff(t0, t1) << "ms, " << gbPerSecond(diff(t0, t1)) << " GB/s, "
+              << allocatedMiB() << " MiB allocated\n";
+
+    for (unsigned threads : { 1u, 4u }) {
+      remove_all(dst);
+      CopyOptions opts;
+      opts.threads= threads;
+      t0= std::chrono::steady_clock::now();
+      CopyStats st= TreeCopier { opts }.copy(src, dst);
+      t1= std::chrono::steady_clock::now();
+      std::cout << "TreeCopier, " << threads << " threads: " << diff(t0, t1) << "ms, " << gbPerSecond(diff(t0, t1)) << " GB/s, "
+                << allocatedMiB() << " MiB allocated; " << st.files << " files (" << st.byMethod[int(CopyMethod::copyFileRange)]
+                << " copy_file_range, " << st.byMethod[int(CopyMethod::sendfile)] << " sendfile, "
+                << st.byMethod[int(CopyMethod::readWrite)] << " read/write), " << (st.bytes - st.dataBytes) / (1 << 20)
+                << " MiB of holes, " << st.errors << " errors\n";
+    }
+  }
+  remove_all(dst);
+}
+
 int main() {
   if (std::filesystem::path p { "/home/phytm/Desktop" }; is_regular_file(p)) {
     std::cout << p << " exists with " << file_size(p) << " bytes\n";
@@ -77,6 +625,13 @@ int main() {
   }
 
   create_different_types_of_files();
+  // parallel_walk_benchmark();
+  // fs_index_benchmark();
+  // batched_io_benchmark();
+  // disk_usage_benchmark();
+  // duplicate_finder_benchmark();
+  // path_builder_benchmark();
+  // tree_copier_benchmark();
 
   return 0;
 }
@@ -0,0 +1,516 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/*
+  ParallelWalker
+  walks a directory tree with several threads, as a faster replacement for
+  std::filesystem::recursive_directory_iterator on large trees (Linux only):
+  - each thread owns a deque of directories still to read; it takes work from the
+    back of its own deque (depth first) and steals from the front of the others
+  - directories are opened relative to their parent with openat() and read with
+    getdents64() into a large per-thread buffer, so one syscall returns hundreds of entries
+  - the file type comes from d_type; statx() is only called if the file system doesn't
+    fill in d_type, for symlinks that are followed, or if WalkOptions::statxMask asks for it
+  - with followSymlinks, each directory is entered once per (device, inode),
+    so symlink loops end the walk instead of recursing forever
+  - entries are passed to a callback, called concurrently from all threads, or to a
+    bounded WalkQueue drained by a consumer thread
+  A callback returning false for a directory skips its contents. The root itself is
+  not reported. An exception thrown by the callback stops the walk and is rethrown by
+  walk(). If the root can't be opened, walk() throws std::filesystem::filesystem_error;
+  later errors (e.g. permission denied) are counted and passed to WalkOptions::onError.
+*/
+
+namespace walk_detail {
+
+// the kernel's struct linux_dirent64: d_ino (8), d_off (8), d_reclen (2), d_type (1), d_name
+constexpr std::size_t direntReclenOffset { 16 };
+constexpr std::size_t direntTypeOffset { 18 };
+constexpr std::size_t direntNameOffset { 19 };
+
+inline std::filesystem::file_type fromDirentType(unsigned char t) noexcept {
+  namespace fs = std::filesystem;
+  switch (t) {
+    case DT_REG: return fs::file_type::regular;
+    case DT_DIR: return fs::file_type::directory;
+    case DT_LNK: return fs::file_type::symlink;
+    case DT_BLK: return fs::file_type::block;
+    case DT_CHR: return fs::file_type::character;
+    case DT_FIFO: return fs::file_type::fifo;
+    case DT_SOCK: return fs::file_type::socket;
+    default: return fs::file_type::unknown;
+  }
+}
+
+inline std::filesystem::file_type fromMode(unsigned mode) noexcept {
+  namespace fs = std::filesystem;
+  switch (mode & S_IFMT) {
+    case S_IFREG: return fs::file_type::regular;
+    case S_IFDIR: return fs::file_type::directory;
+    case S_IFLNK: return fs::file_type::symlink;
+    case S_IFBLK: return fs::file_type::block;
+    case S_IFCHR: return fs::file_type::character;
+    case S_IFIFO: return fs::file_type::fifo;
+    case S_IFSOCK: return fs::file_type::socket;
+    default: return fs::file_type::unknown;
+  }
+}
+
+// an open directory, shared by the tasks of its subdirectories (they are opened with openat()):
+class DirFd {
+public:
+  explicit DirFd(int fd) noexcept : m_fd { fd } {}
+  DirFd(const DirFd&) = delete;
+  DirFd& operator=(const DirFd&) = delete;
+  ~DirFd() { ::close(m_fd); }
+  int get() const noexcept { return m_fd; }
+private:
+  int m_fd;
+};
+
+struct DirTask {
+  std::shared_ptr<const DirFd> parent;  // nullptr: path is opened as it is (the root)
+  std::string path;
+  std::size_t nameOffset { 0 };         // name relative to parent
+  std::uint64_t id { 0 };
+  int depth { 0 };
+  bool viaSymlink { false };
+};
+
+struct alignas(64) WorkerDeque {
+  std::mutex mutex;
+  std::deque<DirTask> tasks;
+};
+
+// function object returning void or bool:
+template<typename F, typename... Args>
+bool invokeContinue(F& f, Args&&... args) {
+  if constexpr (std::is_same_v<std::invoke_result_t<F&, Args...>, void>) {
+    f(std::forward<Args>(args)...);
+    return true;
+  } else {
+    return static_cast<bool>(f(std::forward<Args>(args)...));
+  }
+}
+
+}  // namespace walk_detail
+
+struct WalkEntry {
+  std::string_view path;                // root / ... / name, valid during the callback only
+  std::string_view name;
+  std::filesystem::file_type type;      // of the entry itself, symlinks are reported as symlink
+  std::uint64_t inode;
+  int depth;                            // 0 for entries of the root
+  std::uint64_t parent;                 // id of the containing directory, the root has id 1
+  std::uint64_t id;                     // id of a directory that will be descended, else 0
+  const struct statx* stat;             // nullptr if statx() wasn't called for this entry
+  unsigned worker;                      // index of the calling thread, for per-thread results
+};
+
+struct WalkOptions {
+  unsigned threads { std::max(1u, std::thread::hardware_concurrency()) };
+  bool followSymlinks { false };
+  unsigned statxMask { 0 };             // e.g. STATX_SIZE | STATX_BLOCKS: statx() for every entry
+  std::size_t bufferSize { 256 * 1024 }; // getdents64() buffer per thread
+  std::function<void(std::string_view path, int err)> onError;
+};
+
+struct WalkStats {
+  std::size_t entries { 0 };
+  std::size_t directories { 0 };        // directories read, including the root
+  std::size_t statxCalls { 0 };
+  std::size_t steals { 0 };
+  std::size_t errors { 0 };
+};
+
+class ParallelWalker {
+public:
+  explicit ParallelWalker(WalkOptions opts = {}) : m_opts { std::move(opts) } {
+    m_opts.threads = std::max(1u, m_opts.threads);
+    m_opts.bufferSize = std::max<std::size_t>(m_opts.bufferSize, 4096);
+  }
+
+  const WalkOptions& options() const noexcept { return m_opts; }
+
+  // f(const WalkEntry&) for all entries below root, concurrently from options().threads threads:
+  template<typename F>
+  WalkStats walk(const std::filesystem::path& root, F&& f) {
+    using namespace walk_detail;
+    State state(m_opts.threads);
+
+    int rootFd = ::open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (rootFd < 0) {
+      throw std::filesystem::filesystem_error("ParallelWalker::walk", root, std::error_code(errno, std::system_category()));
+    }
+    DirTask rootTask;
+    rootTask.path = root.native();
+    while (rootTask.path.size() > 1 && rootTask.path.back() == '/') {
+      rootTask.path.pop_back();
+    }
+    rootTask.id = state.nextId++;
+    state.pending = 1;
+
+    std::vector<Worker> workers(m_opts.threads);
+    for (auto& w : workers) {
+      w.buffer.reset(new char[m_opts.bufferSize]);
+    }
+    // the root is processed right away, its subdirectories are then spread by stealing:
+    processDir(state, workers[0], 0, std::move(rootTask), rootFd, f);
+    --state.pending;
+
+    std::vector<std::thread> threads;
+    for (unsigned i { 1 }; i < m_opts.threads; ++i) {
+      threads.emplace_back([&, i] { runWorker(state, workers[i], i, f); });
+    }
+    runWorker(state, workers[0], 0, f);
+    for (auto& t : threads) {
+      t.join();
+    }
+    if (state.error) {
+      std::rethrow_exception(state.error);
+    }
+
+    WalkStats total;
+    for (const auto& w : workers) {
+      total.entries += w.stats.entries;
+      total.directories += w.stats.directories;
+      total.statxCalls += w.stats.statxCalls;
+      total.steals += w.stats.steals;
+      total.errors += w.stats.errors;
+    }
+    return total;
+  }
+
+private:
+  struct Worker {
+    std::unique_ptr<char[]> buffer;
+    std::string path;                   // reused for the path of each entry
+    WalkStats stats;
+  };
+
+  struct State {
+    explicit State(unsigned n) : deques(n) {}
+    std::vector<walk_detail::WorkerDeque> deques;
+    std::atomic<std::size_t> pending { 0 };   // directories pushed but not finished
+    std::atomic<std::uint64_t> nextId { 1 };
+    std::atomic<bool> stop { false };         // an exception was thrown by the callback
+    std::mutex errorMutex;
+    std::exception_ptr error;
+    std::mutex visitedMutex;
+    std::set<std::pair<std::uint64_t, std::uint64_t>> visited;  // (dev, ino), only with followSymlinks
+  };
+
+  template<typename F>
+  void runWorker(State& state, Worker& w, unsigned idx, F& f) {
+    using namespace walk_detail;
+    unsigned idle { 0 };
+    for (;;) {
+      // after an exception neither the own tasks nor those of other threads are started:
+      if (state.stop.load()) {
+        return;
+      }
+      std::optional<DirTask> task { popLocal(state, idx) };
+      if (!task) {
+        task = steal(state, idx);
+        if (task) {
+          ++w.stats.steals;
+        }
+      }
+      if (task) {
+        idle = 0;
+        try {
+          processDir(state, w, idx, std::move(*task), -1, f);
+        } catch (...) {
+          std::lock_guard<std::mutex> lock(state.errorMutex);
+          if (!state.error) {
+            state.error = std::current_exception();
+          }
+          state.stop = true;
+        }
+        --state.pending;
+        continue;
+      }
+      if (state.pending.load() == 0) {
+        return;
+      }
+      // others are still reading directories which may yield new work:
+      if (++idle < 64) {
+        std::this_thread::yield();
+      } else {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+      }
+    }
+  }
+
+  static std::optional<walk_detail::DirTask> popLocal(State& state, unsigned idx) {
+    auto& d = state.deques[idx];
+    std::lock_guard<std::mutex> lock(d.mutex);
+    if (d.tasks.empty()) {
+      return std::nullopt;
+    }
+    walk_detail::DirTask t = std::move(d.tasks.back());
+    d.tasks.pop_back();
+    return t;
+  }
+
+  // the oldest task of another thread, i.e. the one closest to the root with the most work below:
+  static std::optional<walk_detail::DirTask> steal(State& state, unsigned idx) {
+    const auto n = static_cast<unsigned>(state.deques.size());
+    for (unsigned k { 1 }; k < n; ++k) {
+      auto& d = state.deques[(idx + k) % n];
+      std::unique_lock<std::mutex> lock(d.mutex, std::try_to_lock);
+      if (lock && !d.tasks.empty()) {
+        walk_detail::DirTask t = std::move(d.tasks.front());
+        d.tasks.pop_front();
+        return t;
+      }
+    }
+    return std::nullopt;
+  }
+
+  void reportError(Worker& w, std::string_view path, int err) {
+    ++w.stats.errors;
+    if (m_opts.onError) {
+      m_opts.onError(path, err);
+    }
+  }
+
+  // fd >= 0: the directory is already open
+  template<typename F>
+  void processDir(State& state, Worker& w, unsigned idx, walk_detail::DirTask task, int fd, F& f) {
+    using namespace walk_detail;
+    if (fd < 0) {
+      int flags { O_RDONLY | O_DIRECTORY | O_CLOEXEC | (task.viaSymlink ? 0 : O_NOFOLLOW) };
+      fd = task.parent ? ::openat(task.parent->get(), task.path.c_str() + task.nameOffset, flags)
+                       : ::open(task.path.c_str(), flags);
+      if (fd < 0) {
+        reportError(w, task.path, errno);
+        return;
+      }
+    }
+    auto dir = std::make_shared<const DirFd>(fd);
+    task.parent.reset();  // the parent may be closed as soon as all its subdirectories are open
+
+    if (m_opts.followSymlinks && !markVisited(state, w, fd)) {
+      return;
+    }
+    ++w.stats.directories;
+
+    w.path.assign(task.path);
+    if (w.path.back() != '/') {
+      w.path += '/';
+    }
+    const std::size_t nameStart { w.path.size() };
+    char* buf { w.buffer.get() };
+    for (;;) {
+      long n { ::syscall(SYS_getdents64, fd, buf, m_opts.bufferSize) };
+      if (n <= 0) {
+        if (n < 0) {
+          reportError(w, task.path, errno);
+        }
+        break;
+      }
+      for (long pos { 0 }; pos < n;) {
+        const char* rec { buf + pos };
+        unsigned short reclen;
+        std::memcpy(&reclen, rec + direntReclenOffset, sizeof(reclen));
+        pos += reclen;
+        const char* name { rec + direntNameOffset };
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+          continue;
+        }
+        std::uint64_t inode;
+        std::memcpy(&inode, rec, sizeof(inode));
+        handleEntry(state, w, idx, task, dir, nameStart, name, static_cast<unsigned char>(rec[direntTypeOffset]), inode, f);
+      }
+    }
+  }
+
+  template<typename F>
+  void handleEntry(State& state, Worker& w, unsigned idx, const walk_detail::DirTask& task,
+                   const std::shared_ptr<const walk_detail::DirFd>& dir, std::size_t nameStart,
+                   const char* name, unsigned char dtype, std::uint64_t inode, F& f) {
+    using namespace walk_detail;
+    namespace fs = std::filesystem;
+    w.path.resize(nameStart);
+    w.path += name;
+    ++w.stats.entries;
+
+    fs::file_type type { fromDirentType(dtype) };
+    struct statx stx;
+    const struct statx* stat { nullptr };
+    if (type == fs::file_type::unknown || m_opts.statxMask != 0) {
+      ++w.stats.statxCalls;
+      if (::statx(dir->get(), name, AT_SYMLINK_NOFOLLOW, m_opts.statxMask | STATX_TYPE | STATX_INO, &stx) == 0) {
+        type = fromMode(stx.stx_mode);
+        stat = &stx;
+      } else {
+        reportError(w, w.path, errno);
+      }
+    }
+
+    bool descend { type == fs::file_type::directory };
+    bool viaSymlink { false };
+    if (type == fs::file_type::symlink && m_opts.followSymlinks) {
+      struct statx target;
+      ++w.stats.statxCalls;
+      if (::statx(dir->get(), name, 0, STATX_TYPE, &target) == 0 && S_ISDIR(target.stx_mode)) {
+        descend = viaSymlink = true;
+      }
+    }
+
+    std::uint64_t id { descend ? state.nextId++ : 0 };
+    WalkEntry e { std::string_view(w.path), std::string_view(w.path).substr(nameStart), type, inode,
+                  task.depth, task.id, id, stat, idx };
+    if (!invokeContinue(f, static_cast<const WalkEntry&>(e)) || !descend) {
+      return;
+    }
+
+    DirTask sub;
+    sub.parent = dir;
+    sub.path = w.path;
+    sub.nameOffset = nameStart;
+    sub.id = id;
+    sub.depth = task.depth + 1;
+    sub.viaSymlink = viaSymlink;
+    ++state.pending;
+    auto& d = state.deques[idx];
+    std::lock_guard<std::mutex> lock(d.mutex);
+    d.tasks.push_back(std::move(sub));
+  }
+
+  // false if the directory was entered before (through a symlink):
+  static bool markVisited(State& state, Worker& w, int fd) {
+    struct statx stx;
+    ++w.stats.statxCalls;
+    if (::statx(fd, "", AT_EMPTY_PATH, STATX_INO, &stx) != 0) {
+      return true;
+    }
+    std::uint64_t dev { (std::uint64_t { stx.stx_dev_major } << 32) | stx.stx_dev_minor };
+    std::lock_guard<std::mutex> lock(state.visitedMutex);
+    return state.visited.emplace(dev, stx.stx_ino).second;
+  }
+
+  WalkOptions m_opts;
+};
+
+/*
+  WalkQueue
+  bounded queue of owned entries between a ParallelWalker and a consumer thread:
+  the walker threads block while the queue is full, so memory stays bounded even
+  if the consumer is slower than the walk. Records are moved in batches.
+*/
+
+struct WalkRecord {
+  std::string path;
+  std::filesystem::file_type type;
+  std::uint64_t inode;
+  int depth;
+};
+
+class WalkQueue {
+public:
+  explicit WalkQueue(std::size_t capacity) : m_capacity { std::max<std::size_t>(capacity, 1) } {}
+
+  // moves all records of batch into the queue, waits while it is full:
+  void pushBatch(std::vector<WalkRecord>& batch) {
+    std::size_t i { 0 };
+    while (i < batch.size()) {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_notFull.wait(lock, [&] { return m_records.size() < m_capacity; });
+      while (i < batch.size() && m_records.size() < m_capacity) {
+        m_records.push_back(std::move(batch[i++]));
+      }
+      lock.unlock();
+      m_notEmpty.notify_one();
+    }
+    batch.clear();
+  }
+
+  // up to max records appended to out; 0 only if the queue is closed and empty:
+  std::size_t popBatch(std::vector<WalkRecord>& out, std::size_t max = 1024) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_notEmpty.wait(lock, [&] { return !m_records.empty() || m_closed; });
+    std::size_t n { std::min(max, m_records.size()) };
+    for (std::size_t i { 0 }; i < n; ++i) {
+      out.push_back(std::move(m_records.front()));
+      m_records.pop_front();
+    }
+    lock.unlock();
+    m_notFull.notify_all();
+    return n;
+  }
+
+  std::optional<WalkRecord> pop() {
+    std::vector<WalkRecord> one;
+    if (popBatch(one, 1) == 0) {
+      return std::nullopt;
+    }
+    return std::move(one.front());
+  }
+
+  void close() {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_closed = true;
+    }
+    m_notEmpty.notify_all();
+  }
+
+private:
+  std::size_t m_capacity;
+  std::mutex m_mutex;
+  std::condition_variable m_notFull;
+  std::condition_variable m_notEmpty;
+  std::deque<WalkRecord> m_records;
+  bool m_closed { false };
+};
+
+// walks root into queue (batches of 256 records per thread) and closes the queue at the end:
+inline WalkStats walkInto(ParallelWalker& walker, const std::filesystem::path& root, WalkQueue& queue) {
+  struct CloseGuard {
+    WalkQueue& q;
+    ~CloseGuard() { q.close(); }
+  } guard { queue };
+
+  std::vector<std::vector<WalkRecord>> batches(walker.options().threads);
+  WalkStats stats = walker.walk(root, [&](const WalkEntry& e) {
+    auto& batch = batches[e.worker];
+    batch.push_back(WalkRecord { std::string(e.path), e.type, e.inode, e.depth });
+    if (batch.size() == 256) {
+      queue.pushBatch(batch);
+    }
+  });
+  for (auto& batch : batches) {
+    queue.pushBatch(batch);
+  }
+  return stats;
+}
@@ -0,0 +1,223 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <iterator>
+#include <string>
+#include <string_view>
+
+/*
+  PathBuilder
+  a path as one growable character buffer, for loops that visit many entries and
+  would otherwise create a std::filesystem::path (a heap string, plus a vector of
+  components once it's iterated) for each of them:
+  - push(name) appends "/name" and returns a mark, pop(mark) goes back to it; a
+    traversal pushes each entry and pops it again, so the buffer is allocated once
+    and only grows when a longer path comes along (POSIX separators only)
+  - view(), filename(), parentPath() and components() are std::string_views into the buffer
+  - normalize() is lexically_normal() done in place: no "." components, "x/.." removed,
+    no repeated separators; it never needs more room than the path had
+  - path() creates the std::filesystem::path when one is needed
+  The views are valid until the next change of the builder.
+*/
+
+class PathBuilder {
+public:
+  PathBuilder() = default;
+  explicit PathBuilder(std::string_view path, std::size_t capacity = 4096) {
+    m_buf.reserve(std::max(capacity, path.size()));
+    m_buf.assign(path);
+  }
+
+  void assign(std::string_view path) { m_buf.assign(path.data(), path.size()); }
+  void clear() noexcept { m_buf.clear(); }
+  void reserve(std::size_t capacity) { m_buf.reserve(capacity); }
+
+  // appends name (one or more components) with a separator if needed; returns the mark for pop():
+  std::size_t push(std::string_view name) {
+    std::size_t mark { m_buf.size() };
+    if (!m_buf.empty() && m_buf.back() != '/' && !name.empty()) {
+      m_buf += '/';
+    }
+    m_buf.append(name.data(), name.size());
+    return mark;
+  }
+  PathBuilder& operator/=(std::string_view name) {
+    push(name);
+    return *this;
+  }
+
+  void pop(std::size_t mark) noexcept { m_buf.resize(mark); }
+  // removes the last component ("a/b" -> "a", "/a" -> "/", "a" -> ""):
+  void pop() noexcept { m_buf.resize(parentPath().size()); }
+
+  std::string_view view() const noexcept { return m_buf; }
+  const char* c_str() const noexcept { return m_buf.c_str(); }
+  const std::string& string() const noexcept { return m_buf; }
+  std::filesystem::path path() const { return std::filesystem::path { m_buf }; }
+  std::size_t size() const noexcept { return m_buf.size(); }
+  bool empty() const noexcept { return m_buf.empty(); }
+  bool isAbsolute() const noexcept { return !m_buf.empty() && m_buf.front() == '/'; }
+
+  // the part after the last separator ("" for "a/"):
+  std::string_view filename() const noexcept {
+    std::size_t sep { m_buf.rfind('/') };
+    return sep == std::string::npos ? view() : view().substr(sep + 1);
+  }
+  // the part before the last separator, "/" for the root:
+  std::string_view parentPath() const noexcept {
+    std::size_t sep { m_buf.rfind('/') };
+    if (sep == std::string::npos) {
+      return {};
+    }
+    return view().substr(0, sep == 0 ? 1 : sep);
+  }
+  // the extension of filename() including the dot, none for ".", ".." and ".hidden":
+  std::string_view extension() const noexcept {
+    std::string_view name { filename() };
+    std::size_t dot { name.rfind('.') };
+    if (dot == 0 || dot == std::string_view::npos || name == "..") {
+      return {};
+    }
+    return name.substr(dot);
+  }
+
+  class ComponentIterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = std::string_view;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const std::string_view*;
+    using reference = const std::string_view&;
+
+    ComponentIterator() = default;
+    ComponentIterator(std::string_view path, std::size_t pos) noexcept : m_path { path } { seek(pos); }
+
+    reference operator*() const noexcept { return m_current; }
+    pointer operator->() const noexcept { return &m_current; }
+    ComponentIterator& operator++() noexcept {
+      seek(m_next);
+      return *this;
+    }
+    ComponentIterator operator++(int) noexcept {
+      ComponentIterator old { *this };
+      ++*this;
+      return old;
+    }
+    friend bool operator==(const ComponentIterator& a, const ComponentIterator& b) noexcept {
+      return a.m_current.data() == b.m_current.data() && a.m_current.size() == b.m_current.size();
+    }
+    friend bool operator!=(const ComponentIterator& a, const ComponentIterator& b) noexcept { return !(a == b); }
+
+  private:
+    void seek(std::size_t pos) noexcept {
+      while (pos < m_path.size() && m_path[pos] == '/') {
+        ++pos;
+      }
+      std::size_t end { std::min(m_path.find('/', pos), m_path.size()) };
+      m_current = m_path.substr(pos, end - pos);
+      m_next = end;
+    }
+
+    std::string_view m_path;
+    std::string_view m_current;
+    std::size_t m_next { 0 };
+  };
+
+  struct Components {
+    ComponentIterator first;
+    ComponentIterator last;
+    ComponentIterator begin() const noexcept { return first; }
+    ComponentIterator end() const noexcept { return last; }
+  };
+
+  // the names between the separators, without the root and without empty ones:
+  Components components() const noexcept {
+    return Components { ComponentIterator { view(), 0 }, ComponentIterator { view(), m_buf.size() } };
+  }
+
+  // the same result as std::filesystem::path::lexically_normal() (POSIX), without allocating;
+  // only a path of separators ("//") becomes "/", libstdc++ leaves that unchanged:
+  void normalize() noexcept {
+    const std::size_t n { m_buf.size() };
+    if (n == 0) {
+      return;
+    }
+    char* buf { m_buf.data() };
+    const std::size_t base { buf[0] == '/' ? 1u : 0u };
+    // the output is written into the front of the buffer while the input is read behind it;
+    // a component is written with the separator before it, which was in the input as well:
+    std::size_t out { base };
+    bool trailingSeparator { false };
+    for (std::size_t pos { base }; pos < n;) {
+      while (pos < n && buf[pos] == '/') {
+        ++pos;
+      }
+      if (pos == n) {
+        trailingSeparator = true;     // "a/"
+        break;
+      }
+      std::size_t end { pos };
+      while (end < n && buf[end] != '/') {
+        ++end;
+      }
+      std::size_t len { end - pos };
+      if (len == 1 && buf[pos] == '.') {
+        trailingSeparator = true;     // "a/." -> "a/"
+      } else if (len == 2 && buf[pos] == '.' && buf[pos + 1] == '.' && out > base && !lastIsDotDot(buf, base, out)) {
+        out = lastSeparator(buf, base, out);
+        trailingSeparator = true;     // "a/b/.." -> "a/"
+      } else if (len == 2 && buf[pos] == '.' && buf[pos + 1] == '.' && base == 1 && out == base) {
+        trailingSeparator = true;     // "/.." -> "/"
+      } else {
+        if (out > base) {
+          buf[out++] = '/';
+        }
+        std::memmove(buf + out, buf + pos, len);
+        out += len;
+        trailingSeparator = false;
+      }
+      pos = end;
+    }
+    if (out == base) {
+      m_buf.resize(base);
+      if (base == 0) {
+        m_buf = ".";                    // fits into the small string buffer, doesn't allocate
+      }
+      return;
+    }
+    if (trailingSeparator && !lastIsDotDot(buf, base, out)) {
+      buf[out++] = '/';
+    }
+    m_buf.resize(out);
+  }
+
+  PathBuilder lexicallyNormal() const {
+    PathBuilder copy { *this };
+    copy.normalize();
+    return copy;
+  }
+
+  friend bool operator==(const PathBuilder& a, const PathBuilder& b) noexcept { return a.m_buf == b.m_buf; }
+  friend bool operator!=(const PathBuilder& a, const PathBuilder& b) noexcept { return !(a == b); }
+
+private:
+  // start of the separator before the last component written, base if it's the first one:
+  static std::size_t lastSeparator(const char* buf, std::size_t base, std::size_t out) noexcept {
+    while (out > base && buf[out - 1] != '/') {
+      --out;
+    }
+    return out > base ? out - 1 : base;
+  }
+  static bool lastIsDotDot(const char* buf, std::size_t base, std::size_t out) noexcept {
+    std::size_t start { lastSeparator(buf, base, out) };
+    if (start > base) {
+      ++start;
+    }
+    return out - start == 2 && buf[start] == '.' && buf[start + 1] == '.';
+  }
+
+  std::string m_buf;
+};
@@ -0,0 +1,422 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "parallel_walker.h"
+
+/*
+  TreeCopier
+  copies a directory tree without passing the file data through user space where the
+  kernel can avoid it, as a faster replacement for std::filesystem::copy(from, to,
+  copy_options::recursive) (Linux only):
+  - the data of each file is copied with copy_file_range() (in the kernel, or as a reflink
+    on file systems that share blocks); if the kernel or the file system pair doesn't
+    support it, with sendfile(), and if that fails too, with pread()/pwrite() through a
+    buffer. A method that isn't supported is not tried again for the following files.
+  - files with fewer blocks than their size are copied extent by extent, found with
+    lseek(SEEK_DATA)/lseek(SEEK_HOLE), so holes stay holes
+  - a ParallelWalker reads the source tree and creates the directories and symlinks; then
+    CopyOptions::threads threads copy the files, largest first, from a shared counter
+  - mode bits, owner (when running as root) and access/modification times are copied;
+    the times of directories are set at the end, deepest first, when nothing is added
+    to them anymore
+  Hard links are copied as separate files, special files (fifos, devices, sockets) are
+  skipped. Errors for single entries go to CopyOptions::onError and are counted, the copy
+  goes on.
+*/
+
+enum class CopyMethod { copyFileRange, sendfile, readWrite };
+
+struct CopyOptions {
+  unsigned threads { std::max(1u, std::thread::hardware_concurrency()) };
+  bool preserveSparse { true };
+  bool preserveMetadata { true };
+  std::size_t bufferSize { 1024 * 1024 }; // per thread, for pread()/pwrite() only
+  std::function<void(std::string_view path, int err)> onError;
+};
+
+struct CopyStats {
+  std::size_t files { 0 };
+  std::size_t directories { 0 };        // created below the destination
+  std::size_t symlinks { 0 };
+  std::size_t skipped { 0 };            // special files
+  std::size_t errors { 0 };
+  std::uint64_t bytes { 0 };            // size of the files copied
+  std::uint64_t dataBytes { 0 };        // of which not in holes
+  std::size_t byMethod[3] { 0, 0, 0 };  // files with data, indexed by CopyMethod
+};
+
+namespace tree_copy_detail {
+
+struct Item {
+  std::string rel;                      // path relative to the roots
+  std::uint64_t size;
+  std::uint64_t blocks;
+  unsigned mode;
+  unsigned uid;
+  unsigned gid;
+  struct timespec times[2];             // access, modification
+};
+
+inline Item toItem(std::string_view rel, const struct statx& stx) {
+  Item item { std::string(rel), stx.stx_size, stx.stx_blocks, stx.stx_mode & 07777u, stx.stx_uid, stx.stx_gid, {} };
+  item.times[0] = { static_cast<time_t>(stx.stx_atime.tv_sec), static_cast<long>(stx.stx_atime.tv_nsec) };
+  item.times[1] = { static_cast<time_t>(stx.stx_mtime.tv_sec), static_cast<long>(stx.stx_mtime.tv_nsec) };
+  return item;
+}
+
+// errors that mean "this method doesn't work for these files", not "the copy failed":
+inline bool unsupported(int err) noexcept {
+  return err == ENOSYS || err == EXDEV || err == EINVAL || err == EOPNOTSUPP || err == ENOTSUP;
+}
+
+class Fd {
+public:
+  explicit Fd(int fd) noexcept : m_fd { fd } {}
+  Fd(const Fd&) = delete;
+  Fd& operator=(const Fd&) = delete;
+  ~Fd() {
+    if (m_fd >= 0) {
+      ::close(m_fd);
+    }
+  }
+  int get() const noexcept { return m_fd; }
+
+private:
+  int m_fd;
+};
+
+}  // namespace tree_copy_detail
+
+class TreeCopier {
+public:
+  explicit TreeCopier(CopyOptions opts = {}) : m_opts { std::move(opts) } {
+    m_opts.threads = std::max(1u, m_opts.threads);
+    m_opts.bufferSize = std::max<std::size_t>(m_opts.bufferSize, 4096);
+  }
+
+  const CopyOptions& options() const noexcept { return m_opts; }
+
+  // copies the contents of from into to (created if needed, existing files are overwritten);
+  // throws std::filesystem::filesystem_error if from can't be read or to can't be created:
+  CopyStats copy(const std::filesystem::path& from, const std::filesystem::path& to) {
+    using namespace tree_copy_detail;
+    namespace fs = std::filesystem;
+    struct statx rootStat;
+    if (::statx(AT_FDCWD, from.c_str(), 0, STATX_BASIC_STATS, &rootStat) != 0 || !S_ISDIR(rootStat.stx_mode)) {
+      int err { errno };
+      throw fs::filesystem_error("TreeCopier: not a directory", from, std::error_code(err ? err : ENOTDIR, std::system_category()));
+    }
+    fs::create_directories(to);
+    m_stats = CopyStats {};
+    m_dest = to.native();
+
+    // 1. directories and symlinks while walking, the files are collected:
+    WalkOptions walkOpts;
+    walkOpts.threads = m_opts.threads;
+    walkOpts.statxMask = STATX_BASIC_STATS;
+    walkOpts.onError = [this](std::string_view path, int err) { reportError(path, err); };
+    const std::size_t skip { from.native().size() + (from.native().back() == '/' ? 0 : 1) };
+    std::vector<std::vector<Item>> files(m_opts.threads), dirs(m_opts.threads);
+    ParallelWalker { walkOpts }.walk(from, [&](const WalkEntry& e) {
+      if (!e.stat) {
+        return false;
+      }
+      std::string_view rel { e.path.substr(skip) };
+      switch (e.type) {
+        case fs::file_type::directory:
+          if (::mkdir(destPath(rel).c_str(), m_opts.preserveMetadata ? 0700 : 0777) != 0 && errno != EEXIST) {
+            reportError(e.path, errno);
+            return false;
+          }
+          dirs[e.worker].push_back(toItem(rel, *e.stat));
+          return true;
+        case fs::file_type::regular:
+          files[e.worker].push_back(toItem(rel, *e.stat));
+          return true;
+        case fs::file_type::symlink:
+          copySymlink(std::string(e.path), toItem(rel, *e.stat));
+          return true;
+        default: {
+          std::lock_guard<std::mutex> lock(m_statsMutex);
+          ++m_stats.skipped;
+          return true;
+        }
+      }
+    });
+
+    // 2. the files, largest first, so that the last ones to finish are small:
+    std::vector<Item> all;
+    for (auto& v : files) {
+      std::move(v.begin(), v.end(), std::back_inserter(all));
+    }
+    std::sort(all.begin(), all.end(), [](const Item& a, const Item& b) { return a.size > b.size; });
+    std::atomic<std::size_t> next { 0 };
+    auto work = [&] {
+      std::unique_ptr<char[]> buffer;
+      for (std::size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < all.size();) {
+        std::string src { from.native() };
+        if (!src.empty() && src.back() != '/') {
+          src += '/';
+        }
+        src += all[i].rel;
+        copyFile(src, all[i], buffer);
+      }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned t { 1 }; t < std::min<std::size_t>(m_opts.threads, all.size()); ++t) {
+      pool.emplace_back(work);
+    }
+    work();
+    for (auto& t : pool) {
+      t.join();
+    }
+
+    // 3. the times of the directories, once their contents are complete:
+    std::vector<Item> allDirs;
+    for (auto& v : dirs) {
+      std::move(v.begin(), v.end(), std::back_inserter(allDirs));
+    }
+    m_stats.directories = allDirs.size();
+    if (m_opts.preserveMetadata) {
+      std::sort(allDirs.begin(), allDirs.end(), [](const Item& a, const Item& b) { return a.rel > b.rel; });
+      for (const Item& dir : allDirs) {
+        setMetadata(-1, destPath(dir.rel), dir, false);
+      }
+      setMetadata(-1, m_dest, toItem({}, rootStat), false);
+    }
+    return m_stats;
+  }
+
+private:
+  std::string destPath(std::string_view rel) const {
+    std::string p { m_dest };
+    if (!p.empty() && p.back() != '/') {
+      p += '/';
+    }
+    p.append(rel.data(), rel.size());
+    return p;
+  }
+
+  void reportError(std::string_view path, int err) {
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    ++m_stats.errors;
+    if (m_opts.onError) {
+      m_opts.onError(path, err);
+    }
+  }
+
+  // bytes [begin, end) of in to the same offsets of out; returns the method used, err is set on errors:
+  CopyMethod copyData(int in, int out, std::uint64_t begin, std::uint64_t end, std::unique_ptr<char[]>& buffer, int& err) {
+    err = 0;
+    if (m_copyFileRange.load(std::memory_order_relaxed)) {
+      loff_t inOff { static_cast<loff_t>(begin) }, outOff { static_cast<loff_t>(begin) };
+      while (static_cast<std::uint64_t>(inOff) < end) {
+        ssize_t n { ::copy_file_range(in, &inOff, out, &outOff, static_cast<std::size_t>(end - static_cast<std::uint64_t>(inOff)), 0) };
+        if (n > 0) {
+          continue;
+        }
+        if (n == 0) {
+          break;                        // the source was truncated meanwhile
+        }
+        if (errno == EINTR) {
+          continue;
+        }
+        if (tree_copy_detail::unsupported(errno) && static_cast<std::uint64_t>(inOff) == begin) {
+          m_copyFileRange.store(false, std::memory_order_relaxed);
+          break;
+        }
+        err = errno;
+        return CopyMethod::copyFileRange;
+      }
+      if (m_copyFileRange.load(std::memory_order_relaxed)) {
+        return CopyMethod::copyFileRange;
+      }
+    }
+    if (m_sendfile.load(std::memory_order_relaxed)) {
+      // sendfile() writes at the file position of out:
+      off_t inOff { static_cast<off_t>(begin) };
+      if (::lseek(out, inOff, SEEK_SET) < 0) {
+        err = errno;
+        return CopyMethod::sendfile;
+      }
+      while (static_cast<std::uint64_t>(inOff) < end) {
+        ssize_t n { ::sendfile(out, in, &inOff, static_cast<std::size_t>(end - static_cast<std::uint64_t>(inOff))) };
+        if (n > 0) {
+          continue;
+        }
+        if (n == 0) {
+          break;
+        }
+        if (errno == EINTR) {
+          continue;
+        }
+        if (tree_copy_detail::unsupported(errno) && static_cast<std::uint64_t>(inOff) == begin) {
+          m_sendfile.store(false, std::memory_order_relaxed);
+          break;
+        }
+        err = errno;
+        return CopyMethod::sendfile;
+      }
+      if (m_sendfile.load(std::memory_order_relaxed)) {
+        return CopyMethod::sendfile;
+      }
+    }
+    if (!buffer) {
+      buffer = std::make_unique<char[]>(m_opts.bufferSize);
+    }
+    for (std::uint64_t pos { begin }; pos < end;) {
+      ssize_t n { ::pread(in, buffer.get(), static_cast<std::size_t>(std::min<std::uint64_t>(end - pos, m_opts.bufferSize)),
+                          static_cast<off_t>(pos)) };
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n <= 0) {
+        err = n < 0 ? errno : 0;
+        break;
+      }
+      for (ssize_t done { 0 }; done < n;) {
+        ssize_t w { ::pwrite(out, buffer.get() + done, static_cast<std::size_t>(n - done), static_cast<off_t>(pos) + done) };
+        if (w < 0 && errno == EINTR) {
+          continue;
+        }
+        if (w < 0) {
+          err = errno;
+          return CopyMethod::readWrite;
+        }
+        done += w;
+      }
+      pos += static_cast<std::uint64_t>(n);
+    }
+    return CopyMethod::readWrite;
+  }
+
+  void copyFile(const std::string& src, const tree_copy_detail::Item& item, std::unique_ptr<char[]>& buffer) {
+    using tree_copy_detail::Fd;
+    Fd in { ::open(src.c_str(), O_RDONLY | O_CLOEXEC) };
+    if (in.get() < 0) {
+      reportError(src, errno);
+      return;
+    }
+    std::string dst { destPath(item.rel) };
+    Fd out { ::open(dst.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, m_opts.preserveMetadata ? 0600 : 0666) };
+    if (out.get() < 0) {
+      reportError(dst, errno);
+      return;
+    }
+
+    int err { 0 };
+    CopyMethod method { CopyMethod::copyFileRange };
+    std::uint64_t dataBytes { 0 };
+    if (m_opts.preserveSparse && item.blocks * 512 < item.size) {
+      // data extents only; the holes between them are left out, ftruncate() sets the size:
+      for (off_t pos { 0 }; err == 0 && static_cast<std::uint64_t>(pos) < item.size;) {
+        off_t data { ::lseek(in.get(), pos, SEEK_DATA) };
+        if (data < 0) {
+          err = errno == ENXIO ? 0 : errno;  // ENXIO: only a hole up to the end
+          break;
+        }
+        off_t hole { ::lseek(in.get(), data, SEEK_HOLE) };
+        if (hole < 0) {
+          err = errno;
+          break;
+        }
+        hole = std::min<off_t>(hole, static_cast<off_t>(item.size));
+        method = copyData(in.get(), out.get(), static_cast<std::uint64_t>(data), static_cast<std::uint64_t>(hole), buffer, err);
+        dataBytes += static_cast<std::uint64_t>(hole - data);
+        pos = hole;
+      }
+      if (err == 0 && ::ftruncate(out.get(), static_cast<off_t>(item.size)) != 0) {
+        err = errno;
+      }
+    } else if (item.size > 0) {
+      method = copyData(in.get(), out.get(), 0, item.size, buffer, err);
+      dataBytes = item.size;
+    }
+    if (err != 0) {
+      reportError(dst, err);
+      return;
+    }
+    if (m_opts.preserveMetadata) {
+      setMetadata(out.get(), dst, item, false);
+    }
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    ++m_stats.files;
+    if (dataBytes != 0) {
+      ++m_stats.byMethod[static_cast<int>(method)];
+    }
+    m_stats.bytes += item.size;
+    m_stats.dataBytes += dataBytes;
+  }
+
+  void copySymlink(const std::string& src, const tree_copy_detail::Item& item) {
+    std::string target(std::max<std::uint64_t>(item.size, 1) + 1, '\0');
+    ssize_t n { ::readlink(src.c_str(), target.data(), target.size()) };
+    if (n < 0) {
+      reportError(src, errno);
+      return;
+    }
+    target.resize(static_cast<std::size_t>(n));
+    std::string dst { destPath(item.rel) };
+    if (::symlink(target.c_str(), dst.c_str()) != 0) {
+      if (errno != EEXIST || ::unlink(dst.c_str()) != 0 || ::symlink(target.c_str(), dst.c_str()) != 0) {
+        reportError(dst, errno);
+        return;
+      }
+    }
+    if (m_opts.preserveMetadata) {
+      setMetadata(-1, dst, item, true);
+    }
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    ++m_stats.symlinks;
+  }
+
+  // owner (only root may give files away, and before the mode, which chown() changes), mode and
+  // times; of the open file fd, or of path if fd is -1. Symlinks have no mode of their own:
+  void setMetadata(int fd, const std::string& path, const tree_copy_detail::Item& item, bool symlink) {
+    if (fd >= 0) {
+      if (m_isRoot) {
+        ::fchown(fd, item.uid, item.gid);
+      }
+      if (::fchmod(fd, item.mode) != 0 || ::futimens(fd, item.times) != 0) {
+        reportError(path, errno);
+      }
+      return;
+    }
+    if (m_isRoot) {
+      ::fchownat(AT_FDCWD, path.c_str(), item.uid, item.gid, symlink ? AT_SYMLINK_NOFOLLOW : 0);
+    }
+    if ((!symlink && ::chmod(path.c_str(), item.mode) != 0)
+        || ::utimensat(AT_FDCWD, path.c_str(), item.times, symlink ? AT_SYMLINK_NOFOLLOW : 0) != 0) {
+      reportError(path, errno);
+    }
+  }
+
+  CopyOptions m_opts;
+  std::string m_dest;
+  std::atomic<bool> m_copyFileRange { true };
+  std::atomic<bool> m_sendfile { true };
+  const bool m_isRoot { ::geteuid() == 0 };
+  std::mutex m_statsMutex;
+  CopyStats m_stats;
+};
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <ostream>
+#include <stdexcept>
+#include <string_view>
+
+/********************************************
+* inplace_string<N>
+* fixed capacity string stored by value (no heap), trivially copyable.
+* The storage is rounded up to whole 64-bit words, unused bytes are kept zero
+* and the last byte holds the length, so that compare and hash can run
+* word-at-a-time instead of byte-at-a-time.
+********************************************/
+
+template<std::size_t N>
+class inplace_string
+{
+    static_assert(N > 0 && N < 256, "inplace_string: the length has to fit into one byte");
+
+public:
+    static constexpr std::size_t wordSize = sizeof(std::uint64_t);
+    static constexpr std::size_t numWords = (N + 1 + wordSize - 1) / wordSize;
+    static constexpr std::size_t numBytes = numWords * wordSize;
+
+    constexpr inplace_string() noexcept = default;
+
+    inplace_string(std::string_view sv)
+    {
+        if(sv.size() > N)
+        {
+            throw std::length_error{"inplace_string: capacity exceeded"};
+        }
+        // assemble whole words, so that later word loads are not stalled by narrow stores:
+        for(std::size_t i{0}; i < numWords; ++i)
+        {
+            std::uint64_t w{0};
+            std::size_t pos = i * wordSize;
+            if(pos + wordSize <= sv.size())
+            {
+                std::memcpy(&w, sv.data() + pos, wordSize);
+            }
+            else if(pos < sv.size())
+            {
+                std::memcpy(&w, sv.data() + pos, sv.size() - pos);
+            }
+            if(i == numWords - 1)
+            {
+                w |= lengthInLastWord(sv.size());
+            }
+            std::memcpy(m_buf.data() + pos, &w, wordSize);
+        }
+    }
+
+    inplace_string(const char* s) : inplace_string(std::string_view{s}){}
+
+    static constexpr std::size_t capacity() noexcept { return N; }
+    std::size_t size() const noexcept { return static_cast<unsigned char>(m_buf[numBytes - 1]); }
+    bool empty() const noexcept { return size() == 0; }
+    const char* data() const noexcept { return m_buf.data(); }
+
+    operator std::string_view() const noexcept
+    {
+        return std::string_view{m_buf.data(), size()};
+    }
+
+    // word-at-a-time access, used by compare and hash:
+    std::uint64_t word(std::size_t idx) const noexcept
+    {
+        std::uint64_t w;
+        std::memcpy(&w, m_buf.data() + idx * wordSize, wordSize);
+        return w;
+    }
+
+    friend bool operator==(const inplace_string& lhs, const inplace_string& rhs) noexcept
+    {
+        // unused bytes are zero and the length is part of the last word:
+        for(std::size_t i{0}; i < numWords; ++i)
+        {
+            if(lhs.word(i) != rhs.word(i))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    friend bool operator<(const inplace_string& lhs, const inplace_string& rhs) noexcept
+    {
+        // compare words in big endian order, so that the first differing character decides.
+        // For equal characters the zero padding and finally the length byte decide, which
+        // yields the same order as std::string_view:
+        for(std::size_t i{0}; i < numWords; ++i)
+        {
+            auto l = toBigEndian(lhs.word(i));
+            auto r = toBigEndian(rhs.word(i));
+            if(l != r)
+            {
+                return l < r;
+            }
+        }
+        return false;
+    }
+
+    friend bool operator!=(const inplace_string& lhs, const inplace_string& rhs) noexcept { return !(lhs == rhs); }
+    friend bool operator>(const inplace_string& lhs, const inplace_string& rhs) noexcept { return rhs < lhs; }
+    friend bool operator<=(const inplace_string& lhs, const inplace_string& rhs) noexcept { return !(rhs < lhs); }
+    friend bool operator>=(const inplace_string& lhs, const inplace_string& rhs) noexcept { return !(lhs < rhs); }
+
+    friend std::ostream& operator<<(std::ostream& strm, const inplace_string& s)
+    {
+        return strm << static_cast<std::string_view>(s);
+    }
+
+    std::size_t hash() const noexcept
+    {
+        std::uint64_t h{0x9E3779B97F4A7C15ull};
+        for(std::size_t i{0}; i < numWords; ++i)
+        {
+            h = (h ^ word(i)) * 0xBF58476D1CE4E5B9ull;
+            h ^= h >> 31;
+        }
+        return static_cast<std::size_t>(h);
+    }
+
+private:
+    static std::uint64_t lengthInLastWord(std::size_t len) noexcept
+    {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        return static_cast<std::uint64_t>(len) << 56;
+#else
+        return static_cast<std::uint64_t>(len);
+#endif
+    }
+
+    static std::uint64_t toBigEndian(std::uint64_t w) noexcept
+    {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        return __builtin_bswap64(w);
+#else
+        return w;
+#endif
+    }
+
+    std::array<char, numBytes> m_buf{};
+};
+
+template<std::size_t N>
+struct std::hash<inplace_string<N>> {
+    std::size_t operator()(const inplace_string<N>& s) const noexcept
+    {
+        return s.hash();
+    }
+};
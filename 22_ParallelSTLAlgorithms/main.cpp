@@ -4,7 +4,11 @@
 #include <cmath>
 #include <execution>  // for the execution policy
 #include <cstdlib>    // for atoi()
+#include <string>
+#include <unordered_map>
+#include <type_traits>
 #include "timer.h"
+#include "inplace_string.h"
 
 
 
@@ -103,6 +107,100 @@ void using_parallel_sort()
     }
 }
 
+void using_inplace_string_sort()
+{
+    /*
+    Keys like "id123" are short. In a std::string each one still needs 32 bytes, may spill to the heap
+    and every compare has to follow a pointer. inplace_string<15> keeps the characters and the length
+    in 16 bytes by value and compares them word by word:
+    */
+    static_assert(std::is_trivially_copyable_v<inplace_string<15>>);
+    static_assert(sizeof(inplace_string<15>) == 16);
+
+    int numElems{1'000'000};
+
+    std::vector<std::string> strColl;
+    std::vector<inplace_string<15>> inplaceColl;
+    strColl.reserve(numElems);
+    inplaceColl.reserve(numElems);
+    for(int i=0; i<numElems / 2; ++i)
+    {
+        strColl.emplace_back("id" + std::to_string(i));
+        strColl.emplace_back("ID" + std::to_string(i));
+    }
+    for(const auto& s : strColl)
+    {
+        inplaceColl.emplace_back(s);
+    }
+
+    // loop to make measurements mature:
+    for(int i{0}; i<10; ++i)
+    {
+        auto strWork = strColl;
+        auto inplaceWork = inplaceColl;
+        auto parWork = inplaceColl;
+
+        Timer t;
+        sort(strWork.begin(), strWork.end());
+        t.printDiff("std::string sort:      ");
+
+        sort(inplaceWork.begin(), inplaceWork.end());
+        t.printDiff("inplace_string sort:   ");
+
+        sort(std::execution::par, parWork.begin(), parWork.end());
+        t.printDiff("inplace_string par:    ");
+        std::cout << '\n';
+    }
+}
+
+void using_inplace_string_hash()
+{
+    int numElems{1'000'000};
+
+    std::vector<std::string> keys;
+    keys.reserve(numElems);
+    for(int i=0; i<numElems; ++i)
+    {
+        keys.emplace_back("id" + std::to_string(i));
+    }
+
+    // loop to make measurements mature:
+    for(int i{0}; i<10; ++i)
+    {
+        std::unordered_map<std::string, int> strMap;
+        std::unordered_map<inplace_string<15>, int> inplaceMap;
+        strMap.reserve(numElems);
+        inplaceMap.reserve(numElems);
+
+        Timer t;
+        for(int j=0; j<numElems; ++j)
+        {
+            strMap.emplace(keys[j], j);
+        }
+        t.printDiff("std::string insert:    ");
+
+        for(int j=0; j<numElems; ++j)
+        {
+            inplaceMap.emplace(keys[j], j);
+        }
+        t.printDiff("inplace_string insert: ");
+
+        long sum{0};
+        for(const auto& k : keys)
+        {
+            sum += strMap.find(k)->second;
+        }
+        t.printDiff("std::string find:      ");
+
+        for(const auto& k : keys)
+        {
+            sum += inplaceMap.find(inplace_string<15>{k})->second;
+        }
+        t.printDiff("inplace_string find:   ");
+        std::cout << "checksum: " << sum << "\n\n";
+    }
+}
+
 void seq_accumulate(long num)
 {
     /*
@@ -145,6 +243,8 @@ int main()
 {
     // using_parallel_for_each();
     // using_parallel_sort();
+    // using_inplace_string_sort();
+    // using_inplace_string_hash();
     
     seq_accumulate(1);
     seq_accumulate(100);
@@ -0,0 +1,450 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ARRAY_EXPR_X86 1
+#endif
+
+/*
+  Array expressions
+  element-wise operations on arrays that are evaluated lazily: sqrt(x) * k computes nothing,
+  it returns a small object that describes the computation, and evaluate() or assign() runs
+  the whole chain in one loop. So
+    auto y = evaluate(clamp(sqrt(lazy(x)) * k, lo, hi));
+  reads x and writes y once, where std::transform() step by step makes one pass over the
+  memory (and needs a temporary array) for each operation:
+  - lazy(container) refers to the elements of a contiguous container (data(), size()) of
+    arithmetic values; the container has to outlive the expression
+  - +, -, *, /, unary -, min(), max(), clamp(), abs() and sqrt(), found by argument dependent
+    lookup; one operand may be a number, which is converted to the element type of the other.
+    All arrays of an expression need the same element type and the same size
+    (std::invalid_argument otherwise)
+  - the loop computes SIMD vectors (GCC vector extensions) of 32 bytes if the CPU has AVX2,
+    chosen at run time, of 16 bytes otherwise; the elements after the last full vector are
+    computed one by one with the same results. min(), max() and clamp() behave like
+    std::min(), std::max() and std::clamp(), also for NaN
+  - evaluate(expr, threads) and assign(out, expr, threads) split the range among threads;
+    out may be one of the arrays in the expression (x = sqrt(x))
+*/
+
+namespace array_expr_detail {
+
+struct ExprBase {};
+
+template<typename E>
+constexpr bool isExpr = std::is_base_of_v<ExprBase, E>;
+
+// an expression and an expression or a number:
+template<typename L, typename R>
+constexpr bool isOperandPair = (isExpr<L> && (isExpr<R> || std::is_arithmetic_v<R>)) || (std::is_arithmetic_v<L> && isExpr<R>);
+
+template<typename T>
+constexpr bool isElement = std::is_arithmetic_v<T> && !std::is_same_v<T, bool> && sizeof(T) <= 8;
+
+// Bytes / sizeof(T) elements of type T:
+template<typename T, std::size_t Bytes>
+struct BatchOf {
+  typedef T type __attribute__((vector_size(Bytes)));
+};
+template<typename T, std::size_t Bytes>
+using Batch = typename BatchOf<T, Bytes>::type;
+
+// batches are passed by reference: as values, a 32-byte vector would change the calling
+// convention between code with and without AVX (and GCC warns about that)
+
+// the size of a number that is used for every element:
+constexpr std::size_t broadcast { std::numeric_limits<std::size_t>::max() };
+
+inline std::size_t commonSize(std::size_t a, std::size_t b) {
+  if (a == broadcast || a == b) {
+    return b;
+  }
+  if (b == broadcast) {
+    return a;
+  }
+  throw std::invalid_argument { "array expression: arrays of different sizes" };
+}
+
+// the operations, a = a op b, for single elements and for batches alike:
+struct Add {
+  template<typename V>
+  static void apply(V& a, const V& b) noexcept { a = a + b; }
+};
+struct Sub {
+  template<typename V>
+  static void apply(V& a, const V& b) noexcept { a = a - b; }
+};
+struct Mul {
+  template<typename V>
+  static void apply(V& a, const V& b) noexcept { a = a * b; }
+};
+struct Div {
+  template<typename V>
+  static void apply(V& a, const V& b) noexcept { a = a / b; }
+};
+struct Neg {
+  template<typename V>
+  static void apply(V& a) noexcept { a = -a; }
+};
+// as std::min() and std::max(): a unless b compares less (greater):
+struct Min {
+  template<typename V>
+  static void apply(V& a, const V& b) noexcept { a = b < a ? b : a; }
+};
+struct Max {
+  template<typename V>
+  static void apply(V& a, const V& b) noexcept { a = a < b ? b : a; }
+};
+
+struct Abs {
+  template<typename V>
+  static void apply(V& a) noexcept {
+    if constexpr (std::is_arithmetic_v<V>) {
+      if constexpr (std::is_floating_point_v<V>) {
+        a = std::fabs(a);
+      } else if constexpr (std::is_signed_v<V>) {
+        a = a < 0 ? -a : a;
+      }
+    } else {
+      using T = std::decay_t<decltype(a[0])>;
+      if constexpr (std::is_floating_point_v<T>) {
+        // clears the sign bit, as fabs() does for -0.0 and NaN:
+        using Mask = decltype(a < a);
+        using M = std::decay_t<decltype(std::declval<Mask>()[0])>;
+        a = (V)((Mask)a & std::numeric_limits<M>::max());
+      } else if constexpr (std::is_signed_v<T>) {
+        a = a < 0 ? -a : a;
+      }
+    }
+  }
+};
+
+#ifdef ARRAY_EXPR_X86
+template<typename V>
+__attribute__((target("avx2"))) void sqrtAvx2(V& a) noexcept {
+  if constexpr (std::is_same_v<std::decay_t<decltype(a[0])>, double>) {
+    a = (V)_mm256_sqrt_pd((__m256d)a);
+  } else {
+    a = (V)_mm256_sqrt_ps((__m256)a);
+  }
+}
+template<typename V>
+void sqrtSse2(V& a) noexcept {
+  if constexpr (std::is_same_v<std::decay_t<decltype(a[0])>, double>) {
+    a = (V)_mm_sqrt_pd((__m128d)a);
+  } else {
+    a = (V)_mm_sqrt_ps((__m128)a);
+  }
+}
+#endif
+
+struct Sqrt {
+  template<typename V>
+  static void apply(V& a) noexcept {
+    if constexpr (std::is_arithmetic_v<V>) {
+      a = std::sqrt(a);
+    } else {
+#ifdef ARRAY_EXPR_X86
+      // std::sqrt() may set errno, which keeps the compiler from using the vector instruction:
+      if constexpr (sizeof(V) == 32) {
+        sqrtAvx2(a);
+      } else {
+        sqrtSse2(a);
+      }
+#else
+      using T = std::decay_t<decltype(a[0])>;
+      for (std::size_t j { 0 }; j < sizeof(V) / sizeof(T); ++j) {
+        a[j] = std::sqrt(a[j]);
+      }
+#endif
+    }
+  }
+};
+
+}  // namespace array_expr_detail
+
+namespace array_expr {
+
+template<typename T>
+class ArrayRef : public array_expr_detail::ExprBase {
+public:
+  static_assert(array_expr_detail::isElement<T>, "array expressions need arithmetic elements of at most 8 bytes");
+  using value_type = T;
+
+  ArrayRef(const T* data, std::size_t size) noexcept : m_data { data }, m_size { size } {}
+
+  std::size_t size() const noexcept { return m_size; }
+  T operator[](std::size_t i) const noexcept { return m_data[i]; }
+  // the element at i (V = T) or the batch starting at i:
+  template<typename V>
+  void batch(std::size_t i, V& v) const noexcept { std::memcpy(&v, m_data + i, sizeof(V)); }
+
+private:
+  const T* m_data;
+  std::size_t m_size;
+};
+
+// a number that is used for every element:
+template<typename T>
+class Scalar : public array_expr_detail::ExprBase {
+public:
+  using value_type = T;
+
+  explicit Scalar(T value) noexcept : m_value { value } {}
+
+  std::size_t size() const noexcept { return array_expr_detail::broadcast; }
+  T operator[](std::size_t) const noexcept { return m_value; }
+  template<typename V>
+  void batch(std::size_t, V& v) const noexcept { v = V {} + m_value; }
+
+private:
+  T m_value;
+};
+
+template<typename Op, typename E>
+class Unary : public array_expr_detail::ExprBase {
+public:
+  using value_type = typename E::value_type;
+
+  explicit Unary(E e) : m_e { std::move(e) } {}
+
+  std::size_t size() const noexcept { return m_e.size(); }
+  value_type operator[](std::size_t i) const noexcept {
+    value_type v;
+    batch(i, v);
+    return v;
+  }
+  template<typename V>
+  void batch(std::size_t i, V& v) const noexcept {
+    m_e.batch(i, v);
+    Op::apply(v);
+  }
+
+private:
+  E m_e;
+};
+
+template<typename Op, typename L, typename R>
+class Binary : public array_expr_detail::ExprBase {
+public:
+  static_assert(std::is_same_v<typename L::value_type, typename R::value_type>,
+                "the arrays of an expression need the same element type");
+  using value_type = typename L::value_type;
+
+  Binary(L l, R r) : m_size { array_expr_detail::commonSize(l.size(), r.size()) }, m_l { std::move(l) }, m_r { std::move(r) } {}
+
+  std::size_t size() const noexcept { return m_size; }
+  value_type operator[](std::size_t i) const noexcept {
+    value_type v;
+    batch(i, v);
+    return v;
+  }
+  template<typename V>
+  void batch(std::size_t i, V& v) const noexcept {
+    V r;
+    m_l.batch(i, v);
+    m_r.batch(i, r);
+    Op::apply(v, r);
+  }
+
+private:
+  std::size_t m_size;
+  L m_l;
+  R m_r;
+};
+
+// the elements of a contiguous container, or of data[0, size):
+template<typename C>
+auto lazy(const C& c) {
+  using T = std::remove_cv_t<std::remove_pointer_t<decltype(std::data(c))>>;
+  return ArrayRef<T> { std::data(c), std::size(c) };
+}
+template<typename C>
+void lazy(const C&&) = delete;  // the expression would refer to a destroyed temporary
+template<typename T>
+ArrayRef<T> lazy(const T* data, std::size_t size) noexcept {
+  return ArrayRef<T> { data, size };
+}
+
+}  // namespace array_expr
+
+namespace array_expr_detail {
+
+template<typename L, typename R>
+using ValueOf = typename std::conditional_t<isExpr<L>, L, R>::value_type;
+
+template<typename X, typename T>
+using Operand = std::conditional_t<isExpr<X>, X, array_expr::Scalar<T>>;
+
+template<typename T, typename X>
+Operand<X, T> operand(const X& x) {
+  if constexpr (isExpr<X>) {
+    return x;
+  } else {
+    return array_expr::Scalar<T> { static_cast<T>(x) };
+  }
+}
+
+template<typename Op, typename L, typename R>
+auto binary(const L& l, const R& r) {
+  using T = ValueOf<L, R>;
+  return array_expr::Binary<Op, Operand<L, T>, Operand<R, T>> { operand<T>(l), operand<T>(r) };
+}
+
+template<typename Op, typename E>
+auto unary(const E& e) {
+  return array_expr::Unary<Op, E> { e };
+}
+
+#ifdef ARRAY_EXPR_X86
+inline bool haveAvx2() noexcept {
+  static const bool avx2 = __builtin_cpu_supports("avx2");
+  return avx2;
+}
+#endif
+
+template<std::size_t Bytes, typename E, typename T>
+void loop(const E& e, T* out, std::size_t first, std::size_t last) noexcept {
+  using V = Batch<T, Bytes>;
+  constexpr std::size_t width { Bytes / sizeof(T) };
+  std::size_t i { first };
+  for (; i + width <= last; i += width) {
+    V v;
+    e.batch(i, v);
+    std::memcpy(out + i, &v, sizeof(V));
+  }
+  for (; i < last; ++i) {
+    T v;
+    e.batch(i, v);
+    out[i] = v;
+  }
+}
+
+// flatten inlines the whole expression into the loop, so it's compiled for the loop's target:
+#ifdef ARRAY_EXPR_X86
+template<typename E, typename T>
+__attribute__((target("avx2"), flatten)) void loopAvx2(const E& e, T* out, std::size_t first, std::size_t last) noexcept {
+  loop<32>(e, out, first, last);
+}
+#endif
+template<typename E, typename T>
+__attribute__((flatten)) void loopDefault(const E& e, T* out, std::size_t first, std::size_t last) noexcept {
+  loop<16>(e, out, first, last);
+}
+
+template<typename E, typename T>
+void run(const E& e, T* out, std::size_t first, std::size_t last) noexcept {
+#ifdef ARRAY_EXPR_X86
+  if (haveAvx2()) {
+    loopAvx2(e, out, first, last);
+    return;
+  }
+#endif
+  loopDefault(e, out, first, last);
+}
+
+// below this many elements per thread, starting a thread costs more than it saves:
+constexpr std::size_t minPerThread { std::size_t { 1 } << 15 };
+
+template<typename E, typename T>
+void evaluateTo(const E& e, T* out, std::size_t n, unsigned threads) {
+  threads = static_cast<unsigned>(std::clamp<std::size_t>(threads, 1, n / minPerThread + 1));
+  if (threads == 1) {
+    run(e, out, 0, n);
+    return;
+  }
+  // the parts start at multiples of 64 elements, so that threads don't share cache lines of out:
+  auto bound = [&](unsigned t) { return t == threads ? n : n / threads * t / 64 * 64; };
+  std::vector<std::thread> pool;
+  for (unsigned t { 1 }; t < threads; ++t) {
+    pool.emplace_back([&e, out, first = bound(t), last = bound(t + 1)] { run(e, out, first, last); });
+  }
+  run(e, out, 0, bound(1));
+  for (auto& t : pool) {
+    t.join();
+  }
+}
+
+}  // namespace array_expr_detail
+
+namespace array_expr {
+
+template<typename L, typename R, typename = std::enable_if_t<array_expr_detail::isOperandPair<L, R>>>
+auto operator+(const L& l, const R& r) {
+  return array_expr_detail::binary<array_expr_detail::Add>(l, r);
+}
+template<typename L, typename R, typename = std::enable_if_t<array_expr_detail::isOperandPair<L, R>>>
+auto operator-(const L& l, const R& r) {
+  return array_expr_detail::binary<array_expr_detail::Sub>(l, r);
+}
+template<typename L, typename R, typename = std::enable_if_t<array_expr_detail::isOperandPair<L, R>>>
+auto operator*(const L& l, const R& r) {
+  return array_expr_detail::binary<array_expr_detail::Mul>(l, r);
+}
+template<typename L, typename R, typename = std::enable_if_t<array_expr_detail::isOperandPair<L, R>>>
+auto operator/(const L& l, const R& r) {
+  return array_expr_detail::binary<array_expr_detail::Div>(l, r);
+}
+template<typename L, typename R, typename = std::enable_if_t<array_expr_detail::isOperandPair<L, R>>>
+auto min(const L& l, const R& r) {
+  return array_expr_detail::binary<array_expr_detail::Min>(l, r);
+}
+template<typename L, typename R, typename = std::enable_if_t<array_expr_detail::isOperandPair<L, R>>>
+auto max(const L& l, const R& r) {
+  return array_expr_detail::binary<array_expr_detail::Max>(l, r);
+}
+
+template<typename E, typename = std::enable_if_t<array_expr_detail::isExpr<E>>>
+auto operator-(const E& e) {
+  return array_expr_detail::unary<array_expr_detail::Neg>(e);
+}
+template<typename E, typename = std::enable_if_t<array_expr_detail::isExpr<E>>>
+auto abs(const E& e) {
+  return array_expr_detail::unary<array_expr_detail::Abs>(e);
+}
+template<typename E, typename = std::enable_if_t<array_expr_detail::isExpr<E>>>
+auto sqrt(const E& e) {
+  static_assert(std::is_floating_point_v<typename E::value_type>, "sqrt() needs floating point elements");
+  return array_expr_detail::unary<array_expr_detail::Sqrt>(e);
+}
+
+// std::clamp(v, lo, hi) is max(v, lo) followed by min(..., hi), also for NaN:
+template<typename E, typename Lo, typename Hi,
+         typename = std::enable_if_t<array_expr_detail::isExpr<E> && array_expr_detail::isOperandPair<E, Lo> &&
+                                     array_expr_detail::isOperandPair<E, Hi>>>
+auto clamp(const E& v, const Lo& lo, const Hi& hi) {
+  using T = typename E::value_type;
+  return min(max(v, array_expr_detail::operand<T>(lo)), array_expr_detail::operand<T>(hi));
+}
+
+// computes the expression into out, which must have its size:
+template<typename C, typename E, typename = std::enable_if_t<array_expr_detail::isExpr<E>>>
+void assign(C& out, const E& e, unsigned threads = 1) {
+  static_assert(std::is_same_v<std::remove_pointer_t<decltype(std::data(out))>, typename E::value_type>,
+                "the output needs the element type of the expression");
+  if (std::size(out) != e.size()) {
+    throw std::invalid_argument { "array expression: output of a different size" };
+  }
+  array_expr_detail::evaluateTo(e, std::data(out), e.size(), threads);
+}
+
+template<typename E, typename = std::enable_if_t<array_expr_detail::isExpr<E>>>
+std::vector<typename E::value_type> evaluate(const E& e, unsigned threads = 1) {
+  std::vector<typename E::value_type> out(e.size());
+  array_expr_detail::evaluateTo(e, out.data(), out.size(), threads);
+  return out;
+}
+
+}  // namespace array_expr
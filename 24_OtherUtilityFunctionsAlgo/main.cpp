@@ -1,10 +1,25 @@
 #include <iostream>
 #include <string>
 #include <any>
+#include <array>
 #include <vector>
 #include <algorithm>
 #include <iterator>
+#include <numeric>
 #include <random>  // for default_random_engine
+#include <chrono>
+#include <cstdint>
+#include <cmath>
+#include <functional>
+#include <thread>
+#include "reservoir_sampling.h"
+#include "random_engines.h"
+#include "array_expr.h"
+
+template <typename T>
+double diff(T t0, T t1) {
+  return std::chrono::duration<double, std::milli>(t1 - t0).count();
+}
 
 template <typename T>
 void generic_size_function(const T &coll) {
@@ -91,6 +106,187 @@ void sample_func() {
   for_each(subset.begin(), end, [](const auto &s) { std::cout << "random elem: " << s << '\n'; });
 }
 
+// the numbers first, first + 1, ... as a random access range that needs no memory:
+class CountingIterator {
+public:
+  using iterator_category= std::random_access_iterator_tag;
+  using value_type= std::uint64_t;
+  using difference_type= std::int64_t;
+  using pointer= const std::uint64_t *;
+  using reference= std::uint64_t;
+
+  explicit CountingIterator(std::uint64_t v= 0) : m_v { v } {}
+  reference operator*() const { return m_v; }
+  reference operator[](difference_type n) const { return m_v + n; }
+  CountingIterator &operator++() { ++m_v; return *this; }
+  CountingIterator operator++(int) { return CountingIterator { m_v++ }; }
+  CountingIterator &operator--() { --m_v; return *this; }
+  CountingIterator operator--(int) { return CountingIterator { m_v-- }; }
+  CountingIterator &operator+=(difference_type n) { m_v += n; return *this; }
+  CountingIterator &operator-=(difference_type n) { m_v -= n; return *this; }
+  friend CountingIterator operator+(CountingIterator it, difference_type n) { return it+= n; }
+  friend CountingIterator operator+(difference_type n, CountingIterator it) { return it+= n; }
+  friend CountingIterator operator-(CountingIterator it, difference_type n) { return it-= n; }
+  friend difference_type operator-(CountingIterator a, CountingIterator b) { return difference_type(a.m_v - b.m_v); }
+  friend bool operator==(CountingIterator a, CountingIterator b) { return a.m_v == b.m_v; }
+  friend bool operator!=(CountingIterator a, CountingIterator b) { return a.m_v != b.m_v; }
+  friend bool operator<(CountingIterator a, CountingIterator b) { return a.m_v < b.m_v; }
+  friend bool operator>(CountingIterator a, CountingIterator b) { return a.m_v > b.m_v; }
+  friend bool operator<=(CountingIterator a, CountingIterator b) { return a.m_v <= b.m_v; }
+  friend bool operator>=(CountingIterator a, CountingIterator b) { return a.m_v >= b.m_v; }
+
+private:
+  std::uint64_t m_v;
+};
+
+void reservoir_sampling_benchmark(std::uint64_t n= 1'000'000'000, std::size_t k= 100) {
+  CountingIterator first { 0 }, last { n };
+  std::vector<std::uint64_t> out(k);
+  auto checksum= [](const auto &v) {
+    std::uint64_t sum { 0 };
+    for (auto x : v) {
+      sum += x;
+    }
+    return sum / v.size();  // the mean, about n / 2
+  };
+
+  // std::sample() needs the size and draws a random number for each element (selection sampling):
+  auto t0= std::chrono::steady_clock::now();
+  std::sample(first, last, out.begin(), k, std::mt19937_64 { 1 });
+  auto t1= std::chrono::steady_clock::now();
+  std::cout << "std::sample: " << diff(t0, t1) << "ms (mean " << checksum(out) << ")\n";
+
+  // Algorithm L, one item after the other as from a stream of unknown length:
+  t0= std::chrono::steady_clock::now();
+  ReservoirSampler<std::uint64_t> stream { k, std::mt19937_64 { 1 } };
+  for (std::uint64_t i= 0; i < n; ++i) {
+    stream.push(i);
+  }
+  t1= std::chrono::steady_clock::now();
+  std::cout << "ReservoirSampler::push() per item: " << diff(t0, t1) << "ms (mean " << checksum(stream.sample()) << ")\n";
+
+  // the reader skips what toSkip() says, as a reader of records could:
+  t0= std::chrono::steady_clock::now();
+  ReservoirSampler<std::uint64_t> skipping { k, std::mt19937_64 { 1 } };
+  skipping.push(first, last);
+  t1= std::chrono::steady_clock::now();
+  std::cout << "ReservoirSampler::push(first, last): " << diff(t0, t1) << "ms (mean " << checksum(skipping.sample()) << ")\n";
+
+  for (unsigned threads : { 1u, 4u }) {
+    t0= std::chrono::steady_clock::now();
+    auto sample= parallelSample(first, last, k, threads, 1);
+    t1= std::chrono::steady_clock::now();
+    std::cout << "parallelSample, " << threads << " threads: " << diff(t0, t1) << "ms (mean " << checksum(sample) << ")\n";
+  }
+
+  // weights 1 to 8, the items with weight 8 should make up 8/36 of the sample:
+  t0= std::chrono::steady_clock::now();
+  WeightedReservoirSampler<std::uint64_t> weighted { k, std::mt19937_64 { 1 } };
+  for (std::uint64_t i= 0; i < n; ++i) {
+    weighted.push(i, double(1 + i % 8));
+  }
+  t1= std::chrono::steady_clock::now();
+  auto sample= weighted.sample();
+  auto heavy= std::count_if(sample.begin(), sample.end(), [](auto i) { return i % 8 == 7; });
+  std::cout << "WeightedReservoirSampler::push() per item: " << diff(t0, t1) << "ms (" << heavy << " of " << k
+            << " with weight 8)\n";
+}
+
+void random_engines_benchmark(std::size_t numValues= std::size_t { 1 } << 28) {
+  std::vector<std::uint64_t> buf(std::size_t { 1 } << 16);  // stays in the L2 cache
+  std::size_t rounds { numValues / buf.size() };
+  auto measure= [&](const char *name, auto generate) {
+    std::uint64_t check { 0 };
+    auto t0= std::chrono::steady_clock::now();
+    for (std::size_t r= 0; r < rounds; ++r) {
+      generate(buf);
+      check ^= buf[r % buf.size()];
+    }
+    auto t1= std::chrono::steady_clock::now();
+    std::cout << name << ": " << rounds * buf.size() / diff(t0, t1) / 1e3 << " M values/s (" << (check & 0xff) << ")\n";
+  };
+  auto byCalls= [](auto &engine) {
+    return [&engine](std::vector<std::uint64_t> &v) {
+      for (auto &x : v) {
+        x= engine();
+      }
+    };
+  };
+
+  std::mt19937 mt;
+  std::mt19937_64 mt64;
+  Xoshiro256pp xoshiro;
+  Pcg64 pcg;
+  measure("std::mt19937 (32 bit values)", byCalls(mt));
+  measure("std::mt19937_64", byCalls(mt64));
+  measure("Xoshiro256pp", byCalls(xoshiro));
+  measure("Xoshiro256pp::fill()", [&](std::vector<std::uint64_t> &v) { xoshiro.fill(v); });
+  measure("Pcg64", byCalls(pcg));
+  measure("Pcg64::fill()", [&](std::vector<std::uint64_t> &v) { pcg.fill(v); });
+
+  // they are UniformRandomBitGenerators, for distributions and std::sample():
+  std::uniform_real_distribution<double> unit { 0.0, 1.0 };
+  std::size_t inside { 0 };
+  for (int i= 0; i < 1'000'000; ++i) {
+    double x { unit(xoshiro) }, y { unit(xoshiro) };
+    inside += x * x + y * y < 1.0;
+  }
+  std::vector<int> coll(100);
+  std::iota(coll.begin(), coll.end(), 0);
+  std::vector<int> subset(5);
+  std::sample(coll.begin(), coll.end(), subset.begin(), subset.size(), pcg);
+  std::cout << "pi ~ " << 4.0 * inside / 1'000'000 << ", sample:";
+  for (int i : subset) {
+    std::cout << ' ' << i;
+  }
+  std::cout << '\n';
+}
+
+void array_expr_benchmark(std::size_t n= std::size_t { 1 } << 24) {
+  // clamp(sqrt(x) * k, lo, hi) and sqrt(a * a + b * b) on arrays larger than the caches:
+  std::vector<double> x(n), a(n), b(n), out(n), tmp(n);
+  std::mt19937_64 rng { 1 };
+  std::uniform_real_distribution<double> dist { -100.0, 100.0 };
+  for (std::size_t i= 0; i < n; ++i) {
+    x[i]= std::abs(dist(rng));
+    a[i]= dist(rng);
+    b[i]= dist(rng);
+  }
+  const double k { 3.0 }, lo { 5.0 }, hi { 25.0 };
+  auto measure= [&](const char *name, auto compute) {
+    compute();  // the pages of out and tmp are touched before
+    auto t0= std::chrono::steady_clock::now();
+    compute();
+    auto t1= std::chrono::steady_clock::now();
+    std::cout << name << ": " << diff(t0, t1) << "ms (sum " << std::accumulate(out.begin(), out.end(), 0.0) << ")\n";
+  };
+
+  measure("std::transform, one pass per operation", [&] {
+    std::transform(x.begin(), x.end(), out.begin(), [](double v) { return std::sqrt(v); });
+    std::transform(out.begin(), out.end(), out.begin(), [k](double v) { return v * k; });
+    std::transform(out.begin(), out.end(), out.begin(), [lo, hi](double v) { return std::clamp(v, lo, hi); });
+  });
+  measure("std::transform, fused by hand", [&] {
+    std::transform(x.begin(), x.end(), out.begin(), [k, lo, hi](double v) { return std::clamp(std::sqrt(v) * k, lo, hi); });
+  });
+  measure("array_expr::assign()", [&] { array_expr::assign(out, clamp(sqrt(array_expr::lazy(x)) * k, lo, hi)); });
+  unsigned threads { std::max(1u, std::thread::hardware_concurrency()) };
+  measure("array_expr::assign(), all threads", [&] { array_expr::assign(out, clamp(sqrt(array_expr::lazy(x)) * k, lo, hi), threads); });
+
+  measure("std::transform, one pass per operation", [&] {
+    std::transform(a.begin(), a.end(), out.begin(), [](double v) { return v * v; });
+    std::transform(b.begin(), b.end(), tmp.begin(), [](double v) { return v * v; });
+    std::transform(out.begin(), out.end(), tmp.begin(), out.begin(), std::plus<> {});
+    std::transform(out.begin(), out.end(), out.begin(), [](double v) { return std::sqrt(v); });
+  });
+  measure("std::transform, fused by hand", [&] {
+    std::transform(a.begin(), a.end(), b.begin(), out.begin(), [](double u, double v) { return std::sqrt(u * u + v * v); });
+  });
+  auto va= array_expr::lazy(a), vb= array_expr::lazy(b);
+  measure("array_expr::assign()", [&] { array_expr::assign(out, sqrt(va * va + vb * vb)); });
+  measure("array_expr::assign(), all threads", [&] { array_expr::assign(out, sqrt(va * va + vb * vb), threads); });
+}
+
 int main() {
   std::array arr { 27, 3, 5, 8, 7, 12, 22, 0, 55 };
   std::vector v { 0.0, 8.8, 15.15 };
@@ -110,6 +306,9 @@ int main() {
   clamp_func();
   std::cout << "-------------\n";
   sample_func();
+  // reservoir_sampling_benchmark();
+  // random_engines_benchmark();
+  // array_expr_benchmark();
 
   return 0;
 }
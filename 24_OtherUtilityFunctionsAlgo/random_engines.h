@@ -0,0 +1,348 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RANDOM_ENGINES_X86 1
+#endif
+
+/*
+  Xoshiro256pp, Pcg64
+  small and fast 64-bit engines as replacements for std::mt19937 (2.5 KB of state, and a
+  table regeneration every 624 values), e.g. for Monte Carlo loops:
+  - both are UniformRandomBitGenerators (result_type, min(), max(), operator()), so they
+    can be passed to std::sample(), std::shuffle() and the distributions of <random>
+  - Xoshiro256pp: xoshiro256++ (Blackman/Vigna), 32 bytes of state, period 2^256 - 1;
+    jump() advances by 2^128 values, for non-overlapping streams
+  - Pcg64: PCG XSL-RR 128/64 (O'Neill), a 128-bit LCG with a permuted output; advance(n)
+    skips n values in O(log n), set_stream() selects one of 2^127 sequences
+  - fill(out, n) (or fill(container)) generates values in bulk from several streams at
+    once: lane j starts at the state of the engine advanced j times by a large distance,
+    value i of lane j goes to out[i * lanes + j]. Xoshiro256pp runs its 8 lanes in two
+    AVX2 registers when the CPU has AVX2 (the same values come from the scalar fallback);
+    Pcg64's 128-bit multiplication has no AVX2 counterpart, so it interleaves 4 lanes in
+    scalar code so that their multiplications overlap in the pipeline. Afterwards the
+    engine continues lane 0 (which also fills the last incomplete row), and the next fill()
+    starts its lanes where the previous ones stopped, so no value is repeated.
+    Setting up Xoshiro256pp's lanes takes 7 jump()s (about 1800 steps), so the engine keeps
+    them (256 bytes) and only sets them up again after it was moved by anything but fill().
+  Seeding from one 64-bit number goes through SplitMix64, as recommended for xoshiro.
+*/
+
+namespace random_engines_detail {
+
+inline std::uint64_t splitMix64(std::uint64_t& x) noexcept {
+  std::uint64_t z { x += 0x9e3779b97f4a7c15ULL };
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+constexpr std::uint64_t rotl(std::uint64_t x, int k) noexcept { return (x << k) | (x >> (64 - k)); }
+constexpr std::uint64_t rotr(std::uint64_t x, unsigned k) noexcept { return (x >> k) | (x << ((64 - k) & 63)); }
+
+inline bool haveAvx2() noexcept {
+#ifdef RANDOM_ENGINES_X86
+  static const bool avx2 = __builtin_cpu_supports("avx2");
+  return avx2;
+#else
+  return false;
+#endif
+}
+
+// below this many values, fill() doesn't use lanes:
+constexpr std::size_t minBulk { 256 };
+
+}  // namespace random_engines_detail
+
+class Xoshiro256pp {
+public:
+  using result_type = std::uint64_t;
+  static constexpr std::size_t lanes { 8 };
+
+  explicit Xoshiro256pp(std::uint64_t seed = 0x853c49e6748fea9bULL) noexcept { this->seed(seed); }
+
+  void seed(std::uint64_t seed) noexcept {
+    for (auto& word : m_s) {
+      word = random_engines_detail::splitMix64(seed);
+    }
+  }
+
+  static constexpr result_type min() noexcept { return 0; }
+  static constexpr result_type max() noexcept { return std::numeric_limits<result_type>::max(); }
+
+  result_type operator()() noexcept { return step(m_s); }
+
+  void discard(unsigned long long n) noexcept {
+    for (; n > 0; --n) {
+      step(m_s);
+    }
+  }
+
+  // the same as 2^128 calls of operator():
+  void jump() noexcept { jump(m_s, jumpPoly); }
+  // 2^192 calls:
+  void longJump() noexcept { jump(m_s, longJumpPoly); }
+
+  void fill(result_type* out, std::size_t n) noexcept {
+    if (n < random_engines_detail::minBulk) {
+      for (std::size_t i { 0 }; i < n; ++i) {
+        out[i] = step(m_s);
+      }
+      return;
+    }
+    if (!lanesCurrent()) {
+      setUpLanes();
+    }
+    std::size_t rows { n / lanes };
+#ifdef RANDOM_ENGINES_X86
+    if (random_engines_detail::haveAvx2()) {
+      fillAvx2(m_lanes, out, rows);
+    } else
+#endif
+    {
+      fillScalar(m_lanes, out, rows);
+    }
+    // lane 0 fills the last incomplete row; the other lanes skip as many values, so that
+    // they stay jump()s of lane 0 for the next fill():
+    for (std::size_t j { 0 }; j < lanes; ++j) {
+      std::uint64_t s[4] { m_lanes[0][j], m_lanes[1][j], m_lanes[2][j], m_lanes[3][j] };
+      for (std::size_t i { rows * lanes }; i < n; ++i) {
+        std::uint64_t val { step(s) };
+        if (j == 0) {
+          out[i] = val;
+        }
+      }
+      for (int w { 0 }; w < 4; ++w) {
+        m_lanes[w][j] = s[w];
+      }
+    }
+    for (int w { 0 }; w < 4; ++w) {
+      m_s[w] = m_lanes[w][0];
+    }
+  }
+
+  template<typename Container>
+  void fill(Container& c) noexcept {
+    fill(std::data(c), std::size(c));
+  }
+
+  friend bool operator==(const Xoshiro256pp& a, const Xoshiro256pp& b) noexcept {
+    return a.m_s[0] == b.m_s[0] && a.m_s[1] == b.m_s[1] && a.m_s[2] == b.m_s[2] && a.m_s[3] == b.m_s[3];
+  }
+  friend bool operator!=(const Xoshiro256pp& a, const Xoshiro256pp& b) noexcept { return !(a == b); }
+
+private:
+  static constexpr std::uint64_t jumpPoly[4] { 0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL, 0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL };
+  static constexpr std::uint64_t longJumpPoly[4] { 0x76e15d3efefdcbbfULL, 0xc5004e441c522fb3ULL, 0x77710069854ee241ULL, 0x39109bb02acbe635ULL };
+
+  static std::uint64_t step(std::uint64_t* s) noexcept {
+    std::uint64_t result { random_engines_detail::rotl(s[0] + s[3], 23) + s[0] };
+    std::uint64_t t { s[1] << 17 };
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = random_engines_detail::rotl(s[3], 45);
+    return result;
+  }
+
+  static void jump(std::uint64_t* s, const std::uint64_t (&poly)[4]) noexcept {
+    std::uint64_t t[4] { 0, 0, 0, 0 };
+    for (std::uint64_t word : poly) {
+      for (int b { 0 }; b < 64; ++b) {
+        if (word & (std::uint64_t { 1 } << b)) {
+          for (int w { 0 }; w < 4; ++w) {
+            t[w] ^= s[w];
+          }
+        }
+        step(s);
+      }
+    }
+    for (int w { 0 }; w < 4; ++w) {
+      s[w] = t[w];
+    }
+  }
+
+  // lane 0 is the engine as the last fill() left it, i.e. nothing else moved it since:
+  bool lanesCurrent() const noexcept {
+    return m_lanes[0][0] == m_s[0] && m_lanes[1][0] == m_s[1] && m_lanes[2][0] == m_s[2] && m_lanes[3][0] == m_s[3];
+  }
+
+  void setUpLanes() noexcept {
+    std::uint64_t s[4] { m_s[0], m_s[1], m_s[2], m_s[3] };
+    for (std::size_t j { 0 }; j < lanes; ++j) {
+      for (int w { 0 }; w < 4; ++w) {
+        m_lanes[w][j] = s[w];
+      }
+      jump(s, jumpPoly);
+    }
+  }
+
+  static void fillScalar(std::uint64_t (&state)[4][lanes], std::uint64_t* out, std::size_t rows) noexcept {
+    for (std::size_t i { 0 }; i < rows; ++i) {
+      for (std::size_t j { 0 }; j < lanes; ++j) {
+        std::uint64_t s[4] { state[0][j], state[1][j], state[2][j], state[3][j] };
+        out[i * lanes + j] = step(s);
+        for (int w { 0 }; w < 4; ++w) {
+          state[w][j] = s[w];
+        }
+      }
+    }
+  }
+
+#ifdef RANDOM_ENGINES_X86
+  __attribute__((target("avx2"))) static inline __m256i rotlAvx2(__m256i x, int k) noexcept {
+    return _mm256_or_si256(_mm256_slli_epi64(x, k), _mm256_srli_epi64(x, 64 - k));
+  }
+
+  // two registers of 4 lanes each, interleaved so that their dependency chains overlap:
+  __attribute__((target("avx2"))) static void fillAvx2(std::uint64_t (&state)[4][lanes], std::uint64_t* out, std::size_t rows) noexcept {
+    __m256i a0 { _mm256_load_si256(reinterpret_cast<const __m256i*>(&state[0][0])) };
+    __m256i a1 { _mm256_load_si256(reinterpret_cast<const __m256i*>(&state[1][0])) };
+    __m256i a2 { _mm256_load_si256(reinterpret_cast<const __m256i*>(&state[2][0])) };
+    __m256i a3 { _mm256_load_si256(reinterpret_cast<const __m256i*>(&state[3][0])) };
+    __m256i b0 { _mm256_load_si256(reinterpret_cast<const __m256i*>(&state[0][4])) };
+    __m256i b1 { _mm256_load_si256(reinterpret_cast<const __m256i*>(&state[1][4])) };
+    __m256i b2 { _mm256_load_si256(reinterpret_cast<const __m256i*>(&state[2][4])) };
+    __m256i b3 { _mm256_load_si256(reinterpret_cast<const __m256i*>(&state[3][4])) };
+    for (std::size_t i { 0 }; i < rows; ++i) {
+      __m256i ra { _mm256_add_epi64(rotlAvx2(_mm256_add_epi64(a0, a3), 23), a0) };
+      __m256i rb { _mm256_add_epi64(rotlAvx2(_mm256_add_epi64(b0, b3), 23), b0) };
+      __m256i ta { _mm256_slli_epi64(a1, 17) };
+      __m256i tb { _mm256_slli_epi64(b1, 17) };
+      a2 = _mm256_xor_si256(a2, a0);
+      b2 = _mm256_xor_si256(b2, b0);
+      a3 = _mm256_xor_si256(a3, a1);
+      b3 = _mm256_xor_si256(b3, b1);
+      a1 = _mm256_xor_si256(a1, a2);
+      b1 = _mm256_xor_si256(b1, b2);
+      a0 = _mm256_xor_si256(a0, a3);
+      b0 = _mm256_xor_si256(b0, b3);
+      a2 = _mm256_xor_si256(a2, ta);
+      b2 = _mm256_xor_si256(b2, tb);
+      a3 = rotlAvx2(a3, 45);
+      b3 = rotlAvx2(b3, 45);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i * lanes), ra);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i * lanes + 4), rb);
+    }
+    _mm256_store_si256(reinterpret_cast<__m256i*>(&state[0][0]), a0);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(&state[1][0]), a1);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(&state[2][0]), a2);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(&state[3][0]), a3);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(&state[0][4]), b0);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(&state[1][4]), b1);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(&state[2][4]), b2);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(&state[3][4]), b3);
+  }
+#endif
+
+  std::uint64_t m_s[4];
+  // for fill(): state word w of lane j in m_lanes[w][j], so that a row of 4 lanes is one AVX2
+  // register; all zero (never a valid state) until the first fill():
+  alignas(32) std::uint64_t m_lanes[4][lanes] {};
+};
+
+class Pcg64 {
+public:
+  using result_type = std::uint64_t;
+  static constexpr std::size_t lanes { 4 };
+
+  explicit Pcg64(std::uint64_t seed = 0xcafef00dd15ea5e5ULL, std::uint64_t stream = 0) noexcept { this->seed(seed, stream); }
+
+  void seed(std::uint64_t seed, std::uint64_t stream = 0) noexcept {
+    std::uint64_t x { seed };
+    std::uint64_t hi { random_engines_detail::splitMix64(x) };
+    std::uint64_t lo { random_engines_detail::splitMix64(x) };
+    set_stream(stream);
+    m_state = ((u128 { hi } << 64) | lo) + m_inc;
+    m_state = m_state * multiplier + m_inc;
+  }
+  // one of 2^127 sequences; the position in the new sequence is kept:
+  void set_stream(std::uint64_t stream) noexcept {
+    std::uint64_t x { stream ^ 0xda3e39cb94b95bdbULL };
+    m_inc = (((u128 { random_engines_detail::splitMix64(x) } << 64) | random_engines_detail::splitMix64(x)) << 1) | 1;
+  }
+
+  static constexpr result_type min() noexcept { return 0; }
+  static constexpr result_type max() noexcept { return std::numeric_limits<result_type>::max(); }
+
+  result_type operator()() noexcept {
+    m_state = m_state * multiplier + m_inc;
+    return output(m_state);
+  }
+
+  void discard(unsigned long long n) noexcept { advance(n); }
+
+  // skips n values in O(log n) (Brown, "Random number generation with arbitrary strides"):
+  void advance(unsigned __int128 n) noexcept { m_state = advanced(m_state, n); }
+
+  void fill(result_type* out, std::size_t n) noexcept {
+    if (n < random_engines_detail::minBulk) {
+      for (std::size_t i { 0 }; i < n; ++i) {
+        out[i] = (*this)();
+      }
+      return;
+    }
+    // lanes 2^124 values apart, 16 of them before the period of 2^128 wraps; four variables
+    // rather than an array, so that the states stay in registers:
+    u128 s0 { m_state };
+    u128 s1 { advanced(s0, u128 { 1 } << 124) };
+    u128 s2 { advanced(s1, u128 { 1 } << 124) };
+    u128 s3 { advanced(s2, u128 { 1 } << 124) };
+    const u128 inc { m_inc };
+    std::size_t rows { n / lanes };
+    for (std::size_t i { 0 }; i < rows; ++i) {
+      s0 = s0 * multiplier + inc;
+      s1 = s1 * multiplier + inc;
+      s2 = s2 * multiplier + inc;
+      s3 = s3 * multiplier + inc;
+      out[i * lanes] = output(s0);
+      out[i * lanes + 1] = output(s1);
+      out[i * lanes + 2] = output(s2);
+      out[i * lanes + 3] = output(s3);
+    }
+    m_state = s0;
+    for (std::size_t i { rows * lanes }; i < n; ++i) {
+      out[i] = (*this)();
+    }
+  }
+
+  template<typename Container>
+  void fill(Container& c) noexcept {
+    fill(std::data(c), std::size(c));
+  }
+
+  friend bool operator==(const Pcg64& a, const Pcg64& b) noexcept { return a.m_state == b.m_state && a.m_inc == b.m_inc; }
+  friend bool operator!=(const Pcg64& a, const Pcg64& b) noexcept { return !(a == b); }
+
+private:
+  using u128 = unsigned __int128;
+  static constexpr u128 multiplier { (u128 { 0x2360ed051fc65da4ULL } << 64) | 0x4385df649fccf645ULL };
+
+  static std::uint64_t output(u128 state) noexcept {
+    return random_engines_detail::rotr(static_cast<std::uint64_t>(state >> 64) ^ static_cast<std::uint64_t>(state),
+                                       static_cast<unsigned>(state >> 122));
+  }
+
+  u128 advanced(u128 state, u128 n) const noexcept {
+    u128 accMult { 1 }, accPlus { 0 }, curMult { multiplier }, curPlus { m_inc };
+    for (; n > 0; n >>= 1) {
+      if (n & 1) {
+        accMult *= curMult;
+        accPlus = accPlus * curMult + curPlus;
+      }
+      curPlus = (curMult + 1) * curPlus;
+      curMult *= curMult;
+    }
+    return accMult * state + accPlus;
+  }
+
+  u128 m_state;
+  u128 m_inc;
+};
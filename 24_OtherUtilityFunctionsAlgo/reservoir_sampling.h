@@ -0,0 +1,314 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <iterator>
+#include <limits>
+#include <random>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*
+  Reservoir sampling
+  a uniform sample of k items from a stream whose length isn't known in advance, where
+  std::sample() needs a forward range with a known size (or calls the random number
+  generator for every element of an input range):
+  - ReservoirSampler<T> implements Algorithm L (Li, 1994): once the reservoir is full, the
+    number of items to skip until the next one is taken is drawn directly, so the generator
+    is used O(k log(n/k)) times instead of n times. push() costs one comparison for an
+    item that is skipped; toSkip() tells a reader how many items it may skip without
+    even creating them, and push(first, last) jumps over them on random access ranges
+  - WeightedReservoirSampler<T> draws k items without replacement with probabilities
+    proportional to their weights (Efraimidis/Spirakis A-ExpJ): each item gets the key
+    u^(1/w), the k largest keys are kept, and the total weight to skip is drawn directly
+  - merge() combines the samplers of two disjoint parts of a stream into a sample of the
+    whole stream with the same distribution, so each thread can sample its own part:
+    the number of items to take from each side is drawn as a hypergeometric variate
+    (the weighted samplers keep the k largest keys of both)
+  - parallelSample() does this for a random access range with several threads
+*/
+
+namespace reservoir_detail {
+
+// uniform in (0, 1), so that log() is finite:
+template<typename URBG>
+double openUnit(URBG& rng) {
+  double u;
+  do {
+    u = std::generate_canonical<double, std::numeric_limits<double>::digits>(rng);
+  } while (u <= 0.0 || u >= 1.0);
+  return u;
+}
+
+// uniform in [0, n):
+template<typename URBG>
+std::uint64_t below(URBG& rng, std::uint64_t n) {
+  return std::uniform_int_distribution<std::uint64_t> { 0, n - 1 }(rng);
+}
+
+}  // namespace reservoir_detail
+
+template<typename T, typename URBG = std::mt19937_64>
+class ReservoirSampler {
+public:
+  explicit ReservoirSampler(std::size_t k, URBG rng = URBG { std::random_device {}() }) : m_k { k }, m_rng { std::move(rng) } {
+    m_sample.reserve(k);
+  }
+
+  std::size_t capacity() const noexcept { return m_k; }
+  std::uint64_t seen() const noexcept { return m_seen; }
+  const std::vector<T>& sample() const noexcept { return m_sample; }
+  std::vector<T> release() noexcept { return std::move(m_sample); }
+
+  // items that will be skipped before the next one is taken (0 while the reservoir fills):
+  std::uint64_t toSkip() const noexcept { return m_seen < m_k ? 0 : m_next - m_seen - 1; }
+  // count n items that are not taken, n <= toSkip():
+  void skip(std::uint64_t n) noexcept { m_seen += n; }
+
+  template<typename U>
+  void push(U&& item) {
+    ++m_seen;
+    if (m_sample.size() < m_k) {
+      m_sample.emplace_back(std::forward<U>(item));
+      if (m_sample.size() == m_k) {
+        m_w = std::exp(std::log(reservoir_detail::openUnit(m_rng)) / static_cast<double>(m_k));
+        drawNext();
+      }
+    } else if (m_seen == m_next) {
+      m_sample[reservoir_detail::below(m_rng, m_k)] = std::forward<U>(item);
+      m_w *= std::exp(std::log(reservoir_detail::openUnit(m_rng)) / static_cast<double>(m_k));
+      drawNext();
+    }
+  }
+
+  // all items of [first, last); a random access range is only read where items are taken:
+  template<typename It>
+  void push(It first, It last) {
+    if constexpr (std::is_base_of_v<std::random_access_iterator_tag, typename std::iterator_traits<It>::iterator_category>) {
+      while (first != last) {
+        std::uint64_t gap { toSkip() };
+        if (static_cast<std::uint64_t>(last - first) <= gap) {
+          skip(static_cast<std::uint64_t>(last - first));
+          return;
+        }
+        first += static_cast<typename std::iterator_traits<It>::difference_type>(gap);
+        skip(gap);
+        push(*first);
+        ++first;
+      }
+    } else {
+      for (; first != last; ++first) {
+        push(*first);
+      }
+    }
+  }
+
+  // adds a sampler of another part of the stream (with the same k); afterwards this one holds
+  // a uniform sample of both parts, the other one is left unspecified:
+  void merge(ReservoirSampler& other) {
+    std::uint64_t restThis { m_seen }, restOther { other.m_seen };
+    std::size_t fromThis { 0 }, fromOther { 0 };
+    for (std::size_t i { 0 }; i < m_k && restThis + restOther > 0; ++i) {
+      if (reservoir_detail::below(m_rng, restThis + restOther) < restThis) {
+        --restThis;
+        ++fromThis;
+      } else {
+        --restOther;
+        ++fromOther;
+      }
+    }
+    // the reservoirs are uniform samples but not in random order; take random elements:
+    chooseFront(m_sample, fromThis);
+    other.chooseFront(other.m_sample, fromOther);
+    m_sample.resize(fromThis);
+    std::move(other.m_sample.begin(), other.m_sample.begin() + static_cast<std::ptrdiff_t>(fromOther), std::back_inserter(m_sample));
+    m_seen += other.m_seen;
+    if (m_sample.size() == m_k && m_k > 0) {
+      // w is the largest of the k smallest of seen() uniform keys, which is Beta(k, seen() - k + 1):
+      double x { std::gamma_distribution<double> { static_cast<double>(m_k) }(m_rng) };
+      double y { std::gamma_distribution<double> { static_cast<double>(m_seen - m_k + 1) }(m_rng) };
+      m_w = x / (x + y);
+      drawNext();
+    }
+  }
+
+private:
+  void drawNext() {
+    // the number of items until the next one whose key would enter the reservoir is geometric:
+    double skip { std::floor(std::log(reservoir_detail::openUnit(m_rng)) / std::log1p(-m_w)) };
+    m_next = skip >= static_cast<double>(std::numeric_limits<std::uint64_t>::max() - m_seen - 1)
+                 ? std::numeric_limits<std::uint64_t>::max()
+                 : m_seen + static_cast<std::uint64_t>(skip) + 1;
+  }
+
+  // a random subset of n elements moved to the front (partial Fisher-Yates shuffle):
+  void chooseFront(std::vector<T>& v, std::size_t n) {
+    for (std::size_t i { 0 }; i < n; ++i) {
+      std::swap(v[i], v[i + reservoir_detail::below(m_rng, v.size() - i)]);
+    }
+  }
+
+  std::size_t m_k;
+  URBG m_rng;
+  std::vector<T> m_sample;
+  std::uint64_t m_seen { 0 };
+  std::uint64_t m_next { 0 };           // number of the next item to take (1-based)
+  double m_w { 0 };
+};
+
+template<typename T, typename URBG = std::mt19937_64>
+class WeightedReservoirSampler {
+public:
+  explicit WeightedReservoirSampler(std::size_t k, URBG rng = URBG { std::random_device {}() })
+      : m_k { k }, m_rng { std::move(rng) } {
+    m_heap.reserve(k);
+  }
+
+  std::size_t capacity() const noexcept { return m_k; }
+  std::uint64_t seen() const noexcept { return m_seen; }
+
+  // items with a weight <= 0 are never taken:
+  template<typename U>
+  void push(U&& item, double weight) {
+    ++m_seen;
+    if (!(weight > 0) || m_k == 0) {
+      return;
+    }
+    if (m_heap.size() < m_k) {
+      insert(std::log(reservoir_detail::openUnit(m_rng)) / weight, std::forward<U>(item));
+      if (m_heap.size() == m_k) {
+        drawSkip();
+      }
+      return;
+    }
+    m_skip -= weight;
+    if (m_skip > 0) {
+      return;
+    }
+    // the key of this item is known to exceed the smallest one; draw it from (T^w, 1):
+    double t { std::exp(m_heap.front().first * weight) };
+    double u { t + (1 - t) * reservoir_detail::openUnit(m_rng) };
+    replaceMin(std::log(u) / weight, std::forward<U>(item));
+    drawSkip();
+  }
+
+  // the sampled items, the largest keys (most likely ones) first:
+  std::vector<T> sample() const {
+    auto sorted = m_heap;
+    std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+    std::vector<T> items;
+    items.reserve(sorted.size());
+    for (auto& [key, item] : sorted) {
+      items.push_back(std::move(item));
+    }
+    return items;
+  }
+
+  // adds a sampler of another part of the stream: the keys are independent, the k largest
+  // of both are the k largest of the whole stream:
+  void merge(WeightedReservoirSampler& other) {
+    for (auto& [key, item] : other.m_heap) {
+      if (m_heap.size() < m_k) {
+        insert(key, std::move(item));
+      } else if (key > m_heap.front().first) {
+        replaceMin(key, std::move(item));
+      }
+    }
+    m_seen += other.m_seen;
+    if (m_heap.size() == m_k && m_k > 0) {
+      drawSkip();
+    }
+  }
+
+private:
+  // min-heap of (log(key), item):
+  using Entry = std::pair<double, T>;
+  static bool greater(const Entry& a, const Entry& b) noexcept { return a.first > b.first; }
+
+  template<typename U>
+  void insert(double logKey, U&& item) {
+    m_heap.emplace_back(logKey, std::forward<U>(item));
+    std::push_heap(m_heap.begin(), m_heap.end(), greater);
+  }
+  template<typename U>
+  void replaceMin(double logKey, U&& item) {
+    std::pop_heap(m_heap.begin(), m_heap.end(), greater);
+    m_heap.back() = Entry { logKey, std::forward<U>(item) };
+    std::push_heap(m_heap.begin(), m_heap.end(), greater);
+  }
+
+  // the weight to skip until an item's key exceeds the smallest key T: log(r) / log(T):
+  void drawSkip() { m_skip = std::log(reservoir_detail::openUnit(m_rng)) / m_heap.front().first; }
+
+  std::size_t m_k;
+  URBG m_rng;
+  std::vector<Entry> m_heap;
+  std::uint64_t m_seen { 0 };
+  double m_skip { 0 };
+};
+
+// k lines of a stream; the lines that are skipped are not stored anywhere:
+template<typename URBG = std::mt19937_64>
+std::vector<std::string> sampleLines(std::istream& in, std::size_t k, URBG rng = URBG { std::random_device {}() }) {
+  ReservoirSampler<std::string, URBG> sampler { k, std::move(rng) };
+  std::string line;
+  for (;;) {
+    std::uint64_t skipped { 0 };
+    for (std::uint64_t n { sampler.toSkip() }; skipped < n; ++skipped) {
+      in.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+      if (in.eof()) {
+        sampler.skip(skipped + (in.gcount() > 0 ? 1 : 0));  // the last line may have no '\n'
+        return sampler.release();
+      }
+    }
+    sampler.skip(skipped);
+    if (!std::getline(in, line)) {
+      return sampler.release();
+    }
+    sampler.push(std::move(line));
+  }
+}
+
+// a uniform sample of k elements of [first, last), each of threads threads samples a part
+// with its own generator, the samples are merged; the generators are constructed from one
+// integer each, derived from seed, so that Xoshiro256pp and Pcg64 work as well as the
+// engines of <random>:
+template<typename It, typename URBG = std::mt19937_64>
+std::vector<typename std::iterator_traits<It>::value_type>
+parallelSample(It first, It last, std::size_t k, unsigned threads = std::max(1u, std::thread::hardware_concurrency()),
+               std::uint64_t seed = std::random_device {}()) {
+  using T = typename std::iterator_traits<It>::value_type;
+  threads = std::max(1u, threads);
+  auto n = last - first;
+  // seed_seq takes 32-bit values, so seed is passed in two halves:
+  std::seed_seq seq { static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32) };
+  std::vector<std::uint32_t> seeds(2 * std::size_t { threads });
+  seq.generate(seeds.begin(), seeds.end());
+  std::vector<ReservoirSampler<T, URBG>> samplers;
+  for (unsigned t { 0 }; t < threads; ++t) {
+    std::uint64_t workerSeed { (std::uint64_t { seeds[2 * t] } << 32) | seeds[2 * t + 1] };
+    samplers.emplace_back(k, URBG(static_cast<typename URBG::result_type>(workerSeed)));
+  }
+  std::vector<std::thread> pool;
+  for (unsigned t { 0 }; t < threads; ++t) {
+    It begin { first + n * t / threads }, end { first + n * (t + 1) / threads };
+    if (t + 1 == threads) {
+      samplers[t].push(begin, end);
+    } else {
+      pool.emplace_back([&sampler = samplers[t], begin, end] { sampler.push(begin, end); });
+    }
+  }
+  for (auto& t : pool) {
+    t.join();
+  }
+  for (unsigned t { 1 }; t < threads; ++t) {
+    samplers[0].merge(samplers[t]);
+  }
+  return samplers[0].release();
+}
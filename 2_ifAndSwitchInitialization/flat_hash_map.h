@@ -0,0 +1,483 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/********************************************
+* FlatHashMap<Key, T>
+* open addressing hash map in the style of the "swiss table":
+* - one control byte per slot (empty, deleted or the low 7 bits of the hash)
+* - slots are probed in groups of 16 control bytes compared at once (SSE2 if available)
+* - keys and values live in one flat array, no allocation per element
+* - with a transparent hash (default for std::string keys) find()/contains()/erase()
+*   accept std::string_view and const char* without creating a temporary std::string
+* insert()/try_emplace() return [pos, ok] as std::map does.
+* As for std::unordered_map, iterators and references are invalidated by rehashing.
+********************************************/
+
+// transparent hash for string keys: std::hash<std::string> and std::hash<std::string_view>
+// yield the same value for the same characters
+struct StringHash {
+    using is_transparent = void;
+    std::size_t operator()(std::string_view sv) const noexcept { return std::hash<std::string_view>{}(sv); }
+};
+
+template<typename Key>
+using DefaultFlatHash = std::conditional_t<std::is_same_v<Key, std::string>, StringHash, std::hash<Key>>;
+
+template<typename Key, typename T, typename Hash = DefaultFlatHash<Key>, typename KeyEqual = std::equal_to<>>
+class FlatHashMap
+{
+public:
+    using key_type = Key;
+    using mapped_type = T;
+    using value_type = std::pair<const Key, T>;
+    using size_type = std::size_t;
+
+private:
+    using ctrl_t = std::int8_t;
+    static constexpr ctrl_t kEmpty = -128;   // 0b10000000
+    static constexpr ctrl_t kDeleted = -2;   // 0b11111110
+    static constexpr size_type groupWidth = 16;
+
+    // a group of 16 control bytes, matched with one SSE2 compare where possible:
+    struct Group {
+        explicit Group(const ctrl_t* p) noexcept
+        {
+#ifdef __SSE2__
+            m_ctrl = _mm_load_si128(reinterpret_cast<const __m128i*>(p));
+#else
+            std::memcpy(m_ctrl, p, groupWidth);
+#endif
+        }
+
+        // bit i is set if control byte i equals h2:
+        std::uint32_t match(ctrl_t h2) const noexcept
+        {
+#ifdef __SSE2__
+            return static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), m_ctrl)));
+#else
+            std::uint32_t mask{0};
+            for(size_type i{0}; i < groupWidth; ++i)
+            {
+                mask |= static_cast<std::uint32_t>(m_ctrl[i] == h2) << i;
+            }
+            return mask;
+#endif
+        }
+
+        std::uint32_t matchEmpty() const noexcept { return match(kEmpty); }
+
+        // empty and deleted have the high bit set:
+        std::uint32_t matchEmptyOrDeleted() const noexcept
+        {
+#ifdef __SSE2__
+            return static_cast<std::uint32_t>(_mm_movemask_epi8(m_ctrl));
+#else
+            std::uint32_t mask{0};
+            for(size_type i{0}; i < groupWidth; ++i)
+            {
+                mask |= static_cast<std::uint32_t>(m_ctrl[i] < 0) << i;
+            }
+            return mask;
+#endif
+        }
+
+#ifdef __SSE2__
+        __m128i m_ctrl;
+#else
+        ctrl_t m_ctrl[groupWidth];
+#endif
+    };
+
+    template<typename K>
+    static constexpr bool isLookupKey = std::is_same_v<K, Key> || (std::is_convertible_v<const K&, std::string_view> && std::is_same_v<Key, std::string>);
+
+public:
+    template<bool IsConst>
+    class Iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = FlatHashMap::value_type;
+        using difference_type = std::ptrdiff_t;
+        using reference = std::conditional_t<IsConst, const value_type&, value_type&>;
+        using pointer = std::conditional_t<IsConst, const value_type*, value_type*>;
+
+        Iterator() = default;
+        Iterator(const ctrl_t* ctrl, const ctrl_t* ctrlEnd, pointer slot) noexcept : m_ctrl{ctrl}, m_ctrlEnd{ctrlEnd}, m_slot{slot} { skipEmpty(); }
+        // iterator converts to const_iterator:
+        template<bool C = IsConst, typename = std::enable_if_t<C>>
+        Iterator(const Iterator<false>& other) noexcept : m_ctrl{other.m_ctrl}, m_ctrlEnd{other.m_ctrlEnd}, m_slot{other.m_slot}{}
+
+        reference operator*() const noexcept { return *m_slot; }
+        pointer operator->() const noexcept { return m_slot; }
+
+        Iterator& operator++() noexcept
+        {
+            ++m_ctrl;
+            ++m_slot;
+            skipEmpty();
+            return *this;
+        }
+        Iterator operator++(int) noexcept
+        {
+            auto tmp = *this;
+            ++*this;
+            return tmp;
+        }
+
+        friend bool operator==(const Iterator& lhs, const Iterator& rhs) noexcept { return lhs.m_ctrl == rhs.m_ctrl; }
+        friend bool operator!=(const Iterator& lhs, const Iterator& rhs) noexcept { return lhs.m_ctrl != rhs.m_ctrl; }
+
+    private:
+        friend class FlatHashMap;
+        template<bool> friend class Iterator;
+
+        void skipEmpty() noexcept
+        {
+            while(m_ctrl != m_ctrlEnd && *m_ctrl < 0)
+            {
+                ++m_ctrl;
+                ++m_slot;
+            }
+        }
+
+        const ctrl_t* m_ctrl{nullptr};
+        const ctrl_t* m_ctrlEnd{nullptr};
+        pointer m_slot{nullptr};
+    };
+
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    FlatHashMap() = default;
+
+    FlatHashMap(std::initializer_list<value_type> il)
+    {
+        reserve(il.size());
+        for(const auto& v : il)
+        {
+            insert(v);
+        }
+    }
+
+    FlatHashMap(const FlatHashMap& other) : m_hash{other.m_hash}, m_eq{other.m_eq}
+    {
+        reserve(other.size());
+        for(const auto& v : other)
+        {
+            insert(v);
+        }
+    }
+
+    FlatHashMap(FlatHashMap&& other) noexcept { swap(other); }
+
+    FlatHashMap& operator=(FlatHashMap other) noexcept
+    {
+        swap(other);
+        return *this;
+    }
+
+    ~FlatHashMap() { destroy(); }
+
+    void swap(FlatHashMap& other) noexcept
+    {
+        using std::swap;
+        swap(m_ctrl, other.m_ctrl);
+        swap(m_slots, other.m_slots);
+        swap(m_capacity, other.m_capacity);
+        swap(m_size, other.m_size);
+        swap(m_growthLeft, other.m_growthLeft);
+        swap(m_hash, other.m_hash);
+        swap(m_eq, other.m_eq);
+    }
+
+    iterator begin() noexcept { return iterator{m_ctrl, m_ctrl + m_capacity, m_slots}; }
+    iterator end() noexcept { return iterator{m_ctrl + m_capacity, m_ctrl + m_capacity, m_slots + m_capacity}; }
+    const_iterator begin() const noexcept { return const_iterator{m_ctrl, m_ctrl + m_capacity, m_slots}; }
+    const_iterator end() const noexcept { return const_iterator{m_ctrl + m_capacity, m_ctrl + m_capacity, m_slots + m_capacity}; }
+
+    size_type size() const noexcept { return m_size; }
+    bool empty() const noexcept { return m_size == 0; }
+    size_type capacity() const noexcept { return m_capacity; }
+
+    void clear() noexcept
+    {
+        destroy();
+        m_ctrl = nullptr;
+        m_slots = nullptr;
+        m_capacity = m_size = m_growthLeft = 0;
+    }
+
+    void reserve(size_type n)
+    {
+        // keep the load factor below 7/8:
+        size_type needed = n + n / 7 + 1;
+        size_type cap = groupWidth;
+        while(cap < needed)
+        {
+            cap *= 2;
+        }
+        if(cap > m_capacity)
+        {
+            rehash(cap);
+        }
+    }
+
+    template<typename K, typename = std::enable_if_t<isLookupKey<K>>>
+    iterator find(const K& key) noexcept
+    {
+        auto idx = findIndex(asLookupKey(key));
+        return idx == npos ? end() : iteratorAt(idx);
+    }
+
+    template<typename K, typename = std::enable_if_t<isLookupKey<K>>>
+    const_iterator find(const K& key) const noexcept
+    {
+        auto idx = findIndex(asLookupKey(key));
+        return idx == npos ? end() : const_iterator{m_ctrl + idx, m_ctrl + m_capacity, m_slots + idx};
+    }
+
+    template<typename K, typename = std::enable_if_t<isLookupKey<K>>>
+    bool contains(const K& key) const noexcept { return findIndex(asLookupKey(key)) != npos; }
+
+    template<typename K, typename = std::enable_if_t<isLookupKey<K>>>
+    size_type count(const K& key) const noexcept { return contains(key) ? 1 : 0; }
+
+    std::pair<iterator, bool> insert(const value_type& v) { return try_emplace(v.first, v.second); }
+    std::pair<iterator, bool> insert(value_type&& v) { return try_emplace(std::move(const_cast<Key&>(v.first)), std::move(v.second)); }
+
+    // if the key is not there yet, construct the mapped value from args:
+    template<typename K, typename... Args>
+    std::pair<iterator, bool> try_emplace(K&& key, Args&&... args)
+    {
+        std::size_t h = hashOf(asLookupKey(key));
+        if(auto idx = findIndex(asLookupKey(key), h); idx != npos)
+        {
+            return { iteratorAt(idx), false };
+        }
+        auto idx = prepareInsert(h);
+        ::new(static_cast<void*>(m_slots + idx)) value_type(std::piecewise_construct, std::forward_as_tuple(std::forward<K>(key)), std::forward_as_tuple(std::forward<Args>(args)...));
+        setCtrl(idx, h2(h));
+        ++m_size;
+        return { iteratorAt(idx), true };
+    }
+
+    template<typename K>
+    T& operator[](K&& key)
+    {
+        return try_emplace(std::forward<K>(key)).first->second;
+    }
+
+    template<typename K, typename = std::enable_if_t<isLookupKey<K>>>
+    size_type erase(const K& key)
+    {
+        auto idx = findIndex(asLookupKey(key));
+        if(idx == npos)
+        {
+            return 0;
+        }
+        eraseAt(idx);
+        return 1;
+    }
+
+    iterator erase(iterator pos) { return erase(const_iterator{pos}); }
+
+    iterator erase(const_iterator pos)
+    {
+        auto idx = static_cast<size_type>(pos.m_ctrl - m_ctrl);
+        eraseAt(idx);
+        return iteratorAt(idx);
+    }
+
+private:
+    static constexpr size_type npos = static_cast<size_type>(-1);
+
+    template<typename K>
+    static decltype(auto) asLookupKey(const K& key) noexcept
+    {
+        if constexpr(std::is_same_v<Key, std::string> && std::is_convertible_v<const K&, std::string_view>) {
+            return std::string_view{key};
+        }
+        else {
+            return (key);
+        }
+    }
+
+    template<typename K>
+    std::size_t hashOf(const K& key) const noexcept
+    {
+        // std::hash is the identity for integers, so mix the bits before splitting into h1/h2:
+        std::uint64_t h = static_cast<std::uint64_t>(m_hash(key)) * 0x9E3779B97F4A7C15ull;
+        return static_cast<std::size_t>(h ^ (h >> 32));
+    }
+
+    static ctrl_t h2(std::size_t h) noexcept { return static_cast<ctrl_t>(h & 0x7F); }
+    size_type firstGroup(std::size_t h) const noexcept { return (h >> 7) & (m_capacity / groupWidth - 1); }
+
+    template<typename K>
+    size_type findIndex(const K& key) const noexcept
+    {
+        return m_capacity == 0 ? npos : findIndex(key, hashOf(key));
+    }
+
+    template<typename K>
+    size_type findIndex(const K& key, std::size_t h) const noexcept
+    {
+        if(m_capacity == 0)
+        {
+            return npos;
+        }
+        const size_type groupMask = m_capacity / groupWidth - 1;
+        size_type g = firstGroup(h);
+        // triangular probing over groups visits every group once:
+        for(size_type step{1};; ++step)
+        {
+            Group group{m_ctrl + g * groupWidth};
+            for(auto mask = group.match(h2(h)); mask != 0; mask &= mask - 1)
+            {
+                size_type idx = g * groupWidth + static_cast<size_type>(__builtin_ctz(mask));
+                if(m_eq(m_slots[idx].first, key))
+                {
+                    return idx;
+                }
+            }
+            if(group.matchEmpty() != 0 || step > groupMask)
+            {
+                return npos;
+            }
+            g = (g + step) & groupMask;
+        }
+    }
+
+    size_type findFreeSlot(std::size_t h) const noexcept
+    {
+        const size_type groupMask = m_capacity / groupWidth - 1;
+        size_type g = firstGroup(h);
+        for(size_type step{1};; ++step)
+        {
+            if(auto mask = Group{m_ctrl + g * groupWidth}.matchEmptyOrDeleted(); mask != 0)
+            {
+                return g * groupWidth + static_cast<size_type>(__builtin_ctz(mask));
+            }
+            g = (g + step) & groupMask;
+        }
+    }
+
+    size_type prepareInsert(std::size_t h)
+    {
+        if(m_growthLeft == 0)
+        {
+            // many tombstones: rehash in place size, otherwise grow:
+            rehash(m_size * 2 + m_size / 7 + 1 < m_capacity ? m_capacity : (m_capacity == 0 ? groupWidth : m_capacity * 2));
+        }
+        auto idx = findFreeSlot(h);
+        if(m_ctrl[idx] == kEmpty)
+        {
+            --m_growthLeft;
+        }
+        return idx;
+    }
+
+    void setCtrl(size_type idx, ctrl_t c) noexcept { m_ctrl[idx] = c; }
+
+    void eraseAt(size_type idx)
+    {
+        m_slots[idx].~value_type();
+        --m_size;
+        // a slot in a group that never was full can become empty again,
+        // otherwise it has to stay a tombstone so that probing goes on:
+        if(Group{m_ctrl + idx / groupWidth * groupWidth}.matchEmpty() != 0)
+        {
+            setCtrl(idx, kEmpty);
+            ++m_growthLeft;
+        }
+        else
+        {
+            setCtrl(idx, kDeleted);
+        }
+    }
+
+    iterator iteratorAt(size_type idx) noexcept { return iterator{m_ctrl + idx, m_ctrl + m_capacity, m_slots + idx}; }
+
+    void rehash(size_type newCapacity)
+    {
+        auto oldCtrl = m_ctrl;
+        auto oldSlots = m_slots;
+        auto oldCapacity = m_capacity;
+
+        m_ctrl = static_cast<ctrl_t*>(::operator new(newCapacity, std::align_val_t{groupWidth}));
+        try {
+            m_slots = static_cast<value_type*>(::operator new(newCapacity * sizeof(value_type), std::align_val_t{alignof(value_type)}));
+        }
+        catch(...) {
+            ::operator delete(m_ctrl, std::align_val_t{groupWidth});
+            m_ctrl = oldCtrl;
+            throw;
+        }
+        std::memset(m_ctrl, kEmpty, newCapacity);
+        m_capacity = newCapacity;
+        m_growthLeft = newCapacity - newCapacity / 8 - m_size;
+
+        for(size_type i{0}; i < oldCapacity; ++i)
+        {
+            if(oldCtrl[i] >= 0)
+            {
+                auto& old = oldSlots[i];
+                std::size_t h = hashOf(asLookupKey(old.first));
+                auto idx = findFreeSlot(h);
+                ::new(static_cast<void*>(m_slots + idx)) value_type(std::move(const_cast<Key&>(old.first)), std::move(old.second));
+                setCtrl(idx, h2(h));
+                old.~value_type();
+            }
+        }
+        if(oldCtrl)
+        {
+            ::operator delete(oldCtrl, std::align_val_t{groupWidth});
+            ::operator delete(oldSlots, std::align_val_t{alignof(value_type)});
+        }
+    }
+
+    void destroy() noexcept
+    {
+        if(!m_ctrl)
+        {
+            return;
+        }
+        if constexpr(!std::is_trivially_destructible_v<value_type>) {
+            for(size_type i{0}; i < m_capacity; ++i)
+            {
+                if(m_ctrl[i] >= 0)
+                {
+                    m_slots[i].~value_type();
+                }
+            }
+        }
+        ::operator delete(m_ctrl, std::align_val_t{groupWidth});
+        ::operator delete(m_slots, std::align_val_t{alignof(value_type)});
+    }
+
+    ctrl_t* m_ctrl{nullptr};
+    value_type* m_slots{nullptr};
+    size_type m_capacity{0};
+    size_type m_size{0};
+    size_type m_growthLeft{0};
+    Hash m_hash{};
+    KeyEqual m_eq{};
+};
@@ -1,6 +1,98 @@
 #include <iostream>
 #include <map>
+#include <unordered_map>
 #include <filesystem>
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "flat_hash_map.h"
+
+template <typename T>
+double diff(const T& t0, const T& t1)
+{
+    return std::chrono::duration<double,std::milli>(t1 - t0).count();
+}
+
+void using_flat_hash_map()
+{
+    // FlatHashMap keeps the interface used above, insert() returns [pos, ok]:
+    FlatHashMap<std::string, int> coll;
+    coll.insert({"new", 42});
+
+    if(auto [pos, ok] = coll.insert({"new", 42}); !ok)
+    {
+        const auto& [key, val] = *pos;
+        std::cout << "already there : " << key << "\n";
+    }
+
+    // but a lookup with a literal or a string_view doesn't create a temporary std::string:
+    if(auto pos = coll.find("new"); pos != coll.end())
+    {
+        std::cout << "found : " << pos->second << "\n";
+    }
+
+    // measure insert and lookup against the node based containers:
+    const int numElems{1'000'000};
+    std::vector<std::string> keys;
+    keys.reserve(numElems);
+    for(int i=0; i<numElems; ++i)
+    {
+        keys.push_back("key" + std::to_string(i * 7919L));
+    }
+    std::vector<std::string_view> views(keys.begin(), keys.end());
+
+    std::map<std::string, std::vector<double>> durs;
+    for(int i=0; i<5; ++i)
+    {
+        std::map<std::string, int> m;
+        std::unordered_map<std::string, int> um;
+        FlatHashMap<std::string, int> fm;
+        long sum{0};
+
+        auto t0 = std::chrono::steady_clock::now();
+        for(int j=0; j<numElems; ++j) { m.insert({keys[j], j}); }
+        auto t1 = std::chrono::steady_clock::now();
+        durs["std::map insert"].push_back(diff(t0, t1));
+
+        t0 = std::chrono::steady_clock::now();
+        for(int j=0; j<numElems; ++j) { um.insert({keys[j], j}); }
+        t1 = std::chrono::steady_clock::now();
+        durs["std::unordered_map insert"].push_back(diff(t0, t1));
+
+        t0 = std::chrono::steady_clock::now();
+        for(int j=0; j<numElems; ++j) { fm.insert({keys[j], j}); }
+        t1 = std::chrono::steady_clock::now();
+        durs["FlatHashMap insert"].push_back(diff(t0, t1));
+
+        // lookup by string_view (std::map and std::unordered_map need a temporary std::string):
+        t0 = std::chrono::steady_clock::now();
+        for(auto sv : views) { sum += m.find(std::string{sv})->second; }
+        t1 = std::chrono::steady_clock::now();
+        durs["std::map find"].push_back(diff(t0, t1));
+
+        t0 = std::chrono::steady_clock::now();
+        for(auto sv : views) { sum += um.find(std::string{sv})->second; }
+        t1 = std::chrono::steady_clock::now();
+        durs["std::unordered_map find"].push_back(diff(t0, t1));
+
+        t0 = std::chrono::steady_clock::now();
+        for(auto sv : views) { sum += fm.find(sv)->second; }
+        t1 = std::chrono::steady_clock::now();
+        durs["FlatHashMap find"].push_back(diff(t0, t1));
+
+        std::cout << "checksum: " << sum << '\n';
+    }
+
+    // print measurements:
+    for (const auto& [name, dvec] : durs) {
+        double avg = 0;
+        for (const auto& val : dvec) {
+            avg += val;
+        }
+        std::cout << name << " avg: " << avg / static_cast<double>(dvec.size()) << "ms\n";
+    }
+}
 
 int main()
 {
@@ -44,5 +136,7 @@ int main()
             break;
     } 
 
+    // using_flat_hash_map();
+
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,382 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+/********************************************
+* LifecycleCounted<T>
+* counts the constructions, copies, moves and destructions of T, instead of a print
+* statement in each special member:
+*     class Widget : public LifecycleCounted<Widget> { ... };
+* - the base class is empty; its special members record the event when T's run. T's own
+*   copy/move constructors and assignments must be defaulted or forward to the base
+*   (LifecycleCounted<Widget>(other)), otherwise a copy is counted as a construction
+* - counts() are the totals of the type; each thread has its own counters, so an event
+*   costs a load and a store, without a locked instruction or cache line sharing
+* - LifecycleScope<T> counts the events of the current thread while it exists, for a
+*   LifecycleSite<T> (a named, static counter set: LIFECYCLE_SITE(T) counts per call site,
+*   LifecycleSite<T>::forEach() visits them all) or on its own; scopes nest, an event
+*   counts in each enclosing scope
+* - count_lifecycle<T>(fn) returns what fn did on this thread, expect_no_copies<T>(fn)
+*   throws lifecycle_error if T was copied, for regression tests of hot code
+* Compiled out if LIFECYCLE_COUNTING is 0, which is the default with NDEBUG: the base has
+* trivial special members, counts are zero and expect_no_copies() only calls fn. The
+* setting must be the same in all translation units.
+********************************************/
+
+#ifndef LIFECYCLE_COUNTING
+#ifdef NDEBUG
+#define LIFECYCLE_COUNTING 0
+#else
+#define LIFECYCLE_COUNTING 1
+#endif
+#endif
+
+struct LifecycleCounts
+{
+    std::uint64_t constructions{0};      // by any other constructor
+    std::uint64_t copyConstructions{0};
+    std::uint64_t moveConstructions{0};
+    std::uint64_t copyAssignments{0};
+    std::uint64_t moveAssignments{0};
+    std::uint64_t destructions{0};
+
+    std::uint64_t copies() const noexcept { return copyConstructions + copyAssignments; }
+    std::uint64_t moves() const noexcept { return moveConstructions + moveAssignments; }
+    // objects created and not yet destroyed (negative if more were destroyed):
+    std::int64_t alive() const noexcept
+    {
+        return static_cast<std::int64_t>(constructions + copyConstructions + moveConstructions - destructions);
+    }
+
+    friend LifecycleCounts operator-(LifecycleCounts a, const LifecycleCounts& b) noexcept
+    {
+        a.constructions -= b.constructions;
+        a.copyConstructions -= b.copyConstructions;
+        a.moveConstructions -= b.moveConstructions;
+        a.copyAssignments -= b.copyAssignments;
+        a.moveAssignments -= b.moveAssignments;
+        a.destructions -= b.destructions;
+        return a;
+    }
+    friend bool operator==(const LifecycleCounts& a, const LifecycleCounts& b) noexcept
+    {
+        return a.constructions == b.constructions && a.copyConstructions == b.copyConstructions &&
+               a.moveConstructions == b.moveConstructions && a.copyAssignments == b.copyAssignments &&
+               a.moveAssignments == b.moveAssignments && a.destructions == b.destructions;
+    }
+    friend bool operator!=(const LifecycleCounts& a, const LifecycleCounts& b) noexcept { return !(a == b); }
+
+    friend std::ostream& operator<<(std::ostream& os, const LifecycleCounts& c)
+    {
+        return os << c.constructions << " constructed, " << c.copyConstructions << " copy constructed, "
+                  << c.moveConstructions << " move constructed, " << c.copyAssignments << " copy assigned, "
+                  << c.moveAssignments << " move assigned, " << c.destructions << " destroyed";
+    }
+};
+
+class lifecycle_error : public std::logic_error
+{
+public:
+    lifecycle_error(const std::string& what, const LifecycleCounts& counts) : std::logic_error{what}, m_counts{counts} {}
+
+    const LifecycleCounts& counts() const noexcept { return m_counts; }
+
+private:
+    LifecycleCounts m_counts;
+};
+
+#if LIFECYCLE_COUNTING
+
+namespace lifecycle_detail {
+
+enum Event { construction, copyConstruction, moveConstruction, copyAssignment, moveAssignment, destruction, numEvents };
+
+struct AtomicCounts
+{
+    std::atomic<std::uint64_t> n[numEvents]{};
+
+    void add(Event e) noexcept { n[e].fetch_add(1, std::memory_order_relaxed); }
+    void addTo(LifecycleCounts& c) const noexcept
+    {
+        c.constructions += n[construction].load(std::memory_order_relaxed);
+        c.copyConstructions += n[copyConstruction].load(std::memory_order_relaxed);
+        c.moveConstructions += n[moveConstruction].load(std::memory_order_relaxed);
+        c.copyAssignments += n[copyAssignment].load(std::memory_order_relaxed);
+        c.moveAssignments += n[moveAssignment].load(std::memory_order_relaxed);
+        c.destructions += n[destruction].load(std::memory_order_relaxed);
+    }
+    void reset() noexcept
+    {
+        for(auto& x : n) {
+            x.store(0, std::memory_order_relaxed);
+        }
+    }
+};
+
+// the counters of one thread for one type. A thread writes its own counters without atomic
+// read-modify-write; the nodes are never freed (the thread's counts stay in the totals) and
+// are reused by later threads:
+struct ThreadCounts
+{
+    AtomicCounts counts;
+    std::atomic<bool> inUse{true};
+    ThreadCounts* next{nullptr};
+
+    void bump(Event e) noexcept { counts.n[e].store(counts.n[e].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); }
+};
+
+// gives the node back when the thread ends:
+struct ThreadCountsReleaser
+{
+    ThreadCounts* node;
+    ~ThreadCountsReleaser() { node->inUse.store(false, std::memory_order_release); }
+};
+
+inline ThreadCounts* acquireThreadCounts(std::atomic<ThreadCounts*>& list)
+{
+    ThreadCounts* node = list.load(std::memory_order_acquire);
+    for(; node; node = node->next) {
+        bool expected = false;
+        if(node->inUse.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+            break;
+        }
+    }
+    if(!node) {
+        node = new ThreadCounts;
+        node->next = list.load(std::memory_order_relaxed);
+        while(!list.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {
+        }
+    }
+    return node;
+}
+
+// the scopes of a thread form a list from the innermost one outwards:
+struct ScopeLink
+{
+    AtomicCounts* counts;
+    ScopeLink* outer;
+};
+
+} // namespace lifecycle_detail
+
+template<typename T>
+class LifecycleScope;
+
+template<typename T>
+class LifecycleCounted
+{
+public:
+    static constexpr bool enabled = true;
+
+    static LifecycleCounts counts() noexcept
+    {
+        LifecycleCounts c;
+        for(auto* node = s_threads.load(std::memory_order_acquire); node; node = node->next) {
+            node->counts.addTo(c);
+        }
+        return c;
+    }
+    // not synchronized with objects being created or destroyed meanwhile:
+    static void reset() noexcept
+    {
+        for(auto* node = s_threads.load(std::memory_order_acquire); node; node = node->next) {
+            node->counts.reset();
+        }
+    }
+
+protected:
+    LifecycleCounted() noexcept { record(lifecycle_detail::construction); }
+    LifecycleCounted(const LifecycleCounted&) noexcept { record(lifecycle_detail::copyConstruction); }
+    LifecycleCounted(LifecycleCounted&&) noexcept { record(lifecycle_detail::moveConstruction); }
+    LifecycleCounted& operator=(const LifecycleCounted&) noexcept
+    {
+        record(lifecycle_detail::copyAssignment);
+        return *this;
+    }
+    LifecycleCounted& operator=(LifecycleCounted&&) noexcept
+    {
+        record(lifecycle_detail::moveAssignment);
+        return *this;
+    }
+    ~LifecycleCounted() { record(lifecycle_detail::destruction); }
+
+private:
+    friend class LifecycleScope<T>;
+
+    static void record(lifecycle_detail::Event e) noexcept
+    {
+        thread_local lifecycle_detail::ThreadCounts* mine{nullptr};
+        if(!mine) {
+            mine = lifecycle_detail::acquireThreadCounts(s_threads);
+            thread_local lifecycle_detail::ThreadCountsReleaser releaser{mine};
+        }
+        mine->bump(e);
+        for(auto* scope = s_innermost; scope; scope = scope->outer) {
+            scope->counts->add(e);
+        }
+    }
+
+    static inline std::atomic<lifecycle_detail::ThreadCounts*> s_threads{nullptr};
+    static inline thread_local lifecycle_detail::ScopeLink* s_innermost{nullptr};
+};
+
+// counters with a name, for a call site; a static object, it stays in the list of sites of T:
+template<typename T>
+class LifecycleSite
+{
+public:
+    explicit LifecycleSite(const char* name) noexcept : m_name{name}, m_next{s_first.load(std::memory_order_relaxed)}
+    {
+        while(!s_first.compare_exchange_weak(m_next, this, std::memory_order_release, std::memory_order_relaxed)) {
+        }
+    }
+    LifecycleSite(const LifecycleSite&) = delete;
+    LifecycleSite& operator=(const LifecycleSite&) = delete;
+
+    // f(site) for each site of T, the latest first:
+    template<typename F>
+    static void forEach(F&& f)
+    {
+        for(auto* site = s_first.load(std::memory_order_acquire); site; site = site->m_next) {
+            f(static_cast<const LifecycleSite&>(*site));
+        }
+    }
+
+    const char* name() const noexcept { return m_name; }
+    LifecycleCounts counts() const noexcept
+    {
+        LifecycleCounts c;
+        m_counts.addTo(c);
+        return c;
+    }
+    void reset() noexcept { m_counts.reset(); }
+
+private:
+    friend class LifecycleScope<T>;
+
+    const char* m_name;
+    LifecycleSite* m_next;
+    lifecycle_detail::AtomicCounts m_counts;
+
+    static inline std::atomic<LifecycleSite*> s_first{nullptr};
+};
+
+template<typename T>
+class LifecycleScope
+{
+public:
+    // counts into its own counters:
+    LifecycleScope() noexcept : LifecycleScope{m_own} {}
+    // counts into the site's counters:
+    explicit LifecycleScope(LifecycleSite<T>& site) noexcept : LifecycleScope{site.m_counts} {}
+    LifecycleScope(const LifecycleScope&) = delete;
+    LifecycleScope& operator=(const LifecycleScope&) = delete;
+    ~LifecycleScope() { LifecycleCounted<T>::s_innermost = m_link.outer; }
+
+    // the events of this scope (for a site: of all scopes of the site):
+    LifecycleCounts counts() const noexcept
+    {
+        LifecycleCounts c;
+        m_link.counts->addTo(c);
+        return c;
+    }
+
+private:
+    explicit LifecycleScope(lifecycle_detail::AtomicCounts& counts) noexcept : m_link{&counts, LifecycleCounted<T>::s_innermost}
+    {
+        LifecycleCounted<T>::s_innermost = &m_link;
+    }
+
+    lifecycle_detail::AtomicCounts m_own;
+    lifecycle_detail::ScopeLink m_link;
+};
+
+#define LIFECYCLE_CONCAT_IMPL(a, b) a##b
+#define LIFECYCLE_CONCAT(a, b) LIFECYCLE_CONCAT_IMPL(a, b)
+#define LIFECYCLE_STRINGIFY_IMPL(x) #x
+#define LIFECYCLE_STRINGIFY(x) LIFECYCLE_STRINGIFY_IMPL(x)
+
+// counts the events of T from here to the end of the enclosing block in a site named file:line:
+#define LIFECYCLE_SITE(T)                                                                                     \
+    static LifecycleSite<T> LIFECYCLE_CONCAT(lifecycleSite, __LINE__){__FILE__ ":" LIFECYCLE_STRINGIFY(__LINE__)}; \
+    LifecycleScope<T> LIFECYCLE_CONCAT(lifecycleScope, __LINE__){LIFECYCLE_CONCAT(lifecycleSite, __LINE__)}
+
+// the events of T while fn runs on this thread (not those of threads that fn starts):
+template<typename T, typename F>
+LifecycleCounts count_lifecycle(F&& fn)
+{
+    LifecycleScope<T> scope;
+    std::forward<F>(fn)();
+    return scope.counts();
+}
+
+#else // !LIFECYCLE_COUNTING
+
+template<typename T>
+class LifecycleCounted
+{
+public:
+    static constexpr bool enabled = false;
+
+    static LifecycleCounts counts() noexcept { return {}; }
+    static void reset() noexcept {}
+};
+
+template<typename T>
+class LifecycleSite
+{
+public:
+    explicit LifecycleSite(const char* name) noexcept : m_name{name} {}
+
+    template<typename F>
+    static void forEach(F&&)
+    {
+    }
+
+    const char* name() const noexcept { return m_name; }
+    LifecycleCounts counts() const noexcept { return {}; }
+    void reset() noexcept {}
+
+private:
+    const char* m_name;
+};
+
+template<typename T>
+class LifecycleScope
+{
+public:
+    LifecycleScope() noexcept = default;
+    explicit LifecycleScope(LifecycleSite<T>&) noexcept {}
+
+    LifecycleCounts counts() const noexcept { return {}; }
+};
+
+#define LIFECYCLE_SITE(T) static_cast<void>(0)
+
+template<typename T, typename F>
+LifecycleCounts count_lifecycle(F&& fn)
+{
+    std::forward<F>(fn)();
+    return {};
+}
+
+#endif // LIFECYCLE_COUNTING
+
+// calls fn and throws lifecycle_error if it copied a T on this thread; returns the counts:
+template<typename T, typename F>
+LifecycleCounts expect_no_copies(F&& fn)
+{
+    LifecycleCounts c = count_lifecycle<T>(std::forward<F>(fn));
+    if(c.copies() != 0) {
+        throw lifecycle_error{"expect_no_copies: " + std::to_string(c.copyConstructions) + " copy constructions and " +
+                                  std::to_string(c.copyAssignments) + " copy assignments",
+                              c};
+    }
+    return c;
+}
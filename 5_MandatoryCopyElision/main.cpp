@@ -1,4 +1,7 @@
 #include <iostream>
+#include <string>
+#include <vector>
+#include "lifecycle_counter.h"
 
 class Myclass{
 public:
@@ -63,6 +66,74 @@ CopyOnly ret() {
     return CopyOnly{}; // OK since C++17
 }
 
+// the same scenarios, counted instead of printed:
+class Counted : public LifecycleCounted<Counted>{
+public:
+    Counted() = default;
+    explicit Counted(std::string s) : name{std::move(s)} {}
+
+private:
+    std::string name;
+};
+
+void takeCounted(Counted /*param*/)
+{
+}
+
+Counted makeCounted(){
+    return Counted{}; // mandatory copy elision
+}
+
+Counted makeNamed(){
+    Counted c{"named"};
+    return c; // named return value: copy elision is allowed, not mandatory (moved otherwise)
+}
+
+void lifecycle_counting()
+{
+    std::cout << "lifecycle counting " << (LifecycleCounted<Counted>::enabled ? "enabled" : "compiled out") << '\n';
+
+    // temporaries initialize the parameter and the variable directly, this doesn't throw:
+    LifecycleCounts c = expect_no_copies<Counted>([] {
+        takeCounted(makeCounted());
+        Counted x = makeCounted();
+        Counted y = makeNamed();
+    });
+    std::cout << "temporaries: " << c << '\n';
+
+    // an lvalue argument is copied:
+    try {
+        expect_no_copies<Counted>([] {
+            Counted a;
+            takeCounted(a);
+        });
+    }
+    catch(const lifecycle_error& e) {
+        std::cout << e.what() << '\n';
+    }
+
+    // the moves of a growing vector, counted for this call site:
+    for(bool reserve : {false, true}) {
+        LifecycleCounts before = LifecycleCounted<Counted>::counts();
+        LifecycleScope<Counted> scope;
+        std::vector<Counted> coll;
+        if(reserve) {
+            coll.reserve(1000);
+        }
+        for(int i = 0; i < 1000; ++i) {
+            LIFECYCLE_SITE(Counted);
+            coll.emplace_back();
+        }
+        std::cout << (reserve ? "with reserve(): " : "without reserve(): ") << scope.counts().moves() << " moves ("
+                  << (LifecycleCounted<Counted>::counts() - before).moves() << " of all threads)\n";
+    }
+    LifecycleSite<Counted>::forEach([](const LifecycleSite<Counted>& site) {
+        std::cout << site.name() << ": " << site.counts() << '\n';
+    });
+}
+
+
+
 int main()
 {
     // Motivation for Mandatory Copy Elision for Temporaries
@@ -97,6 +168,9 @@ int main()
     */
 
 
+    std::cout << "-------\n";
+    lifecycle_counting();
+
     return 0;
 }
 